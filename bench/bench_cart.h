@@ -0,0 +1,47 @@
+// bench_cart.h
+// In-memory NROM cartridge for the benchmarks and checks that run a program of their own rather than a ROM file
+#pragma once
+
+#include "../src/Cartridge.h"
+#include "../src/Mapper.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// 'prg_banks' 16KB PRG banks (one is mirrored at $8000 and $C000, two fill $8000-$FFFF) and 8KB of CHR, with the
+// 'size' bytes of 'program' (if any) at the start of the last bank and the reset vector pointing there ($C000)
+static Cartridge* bench_cart(const uint8_t* program, size_t size, int prg_banks) {
+    Cartridge* cart = (Cartridge*)malloc(sizeof(Cartridge));
+    Vector* prg = (Vector*)malloc(sizeof(Vector));
+    Vector* chr = (Vector*)malloc(sizeof(Vector));
+    if (!cart || !prg || !chr) {
+        fprintf(stderr, "[BENCH] Error, Failed to allocate memory for the cartridge.\n");
+        exit(1);
+    }
+
+    prg->size = prg->capacity = prg_banks * 0x4000;
+    prg->items = (uint8_t*)calloc(prg->capacity, 1);
+    chr->size = chr->capacity = 0x2000;
+    chr->items = (uint8_t*)calloc(chr->capacity, 1);
+    if (!prg->items || !chr->items) {
+        fprintf(stderr, "[BENCH] Error, Failed to allocate memory for the cartridge.\n");
+        exit(1);
+    }
+    uint8_t* last_bank = prg->items + prg->capacity - 0x4000;
+    if (size > 0) {
+        memcpy(last_bank, program, size);
+    }
+    last_bank[0x3FFC] = 0x00;   // Reset vector -> $C000
+    last_bank[0x3FFD] = 0xC0;
+
+    cart->prg_memory = prg;
+    cart->chr_memory = chr;
+    cart->n_prg_banks = prg_banks;
+    cart->n_chr_banks = 1;
+    cart->mapper_id = 0;
+    cart->mirror = HORIZONTAL;
+    cart->mapper = mapper_create(prg_banks, 1, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+    mapper_load_0(cart->mapper);
+    return cart;
+}
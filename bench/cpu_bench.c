@@ -0,0 +1,234 @@
+// cpu_bench.c
+// CPU core throughput benchmark: nestest.nes in automation mode plus synthetic kernels (memcpy, multiply,
+// branch-heavy), each run for a fixed number of instructions with nothing but the CPU, RAM and PRG on the bus
+// (no PPU clocking, DMA or interrupts), reporting MIPS and ns per instruction
+// Results go to stdout and, as JSON for tracking regressions between builds, to the given file
+// Usage: bench_cpu [instructions] [results.json] [nestest.nes]   ('make bench-cpu' runs it)
+#include "../src/Bus.h"
+#include "../src/CPU.h"
+#include "../src/PPU.h"
+#include "../src/Cartridge.h"
+#include "bench_cart.h"
+#include <time.h>
+
+#define BENCH_INSTRUCTIONS  20000000LL
+#define BENCH_WARMUP        1000000LL
+#define NESTEST_PASS        8990        // Instructions in one automation mode pass, before its final RTS
+
+// Kernels are assembled at $C000 and loop forever, 'setup' puts their data in RAM first
+typedef struct Kernel {
+    const char* name;
+    const uint8_t* program;
+    size_t size;
+    void (*setup)(Bus* bus);
+} Kernel;
+
+// Copy a 256 byte page through (zp),Y pointers: $0200 -> $0300
+static const uint8_t memcpy_program[] = {
+    0xA0, 0x00,         // C000: LDY #$00
+    0xB1, 0x10,         // C002: LDA ($10),Y
+    0x91, 0x12,         // C004: STA ($12),Y
+    0xC8,               // C006: INY
+    0xD0, 0xF9,         // C007: BNE $C002
+    0x4C, 0x00, 0xC0,   // C009: JMP $C000
+};
+
+static void memcpy_setup(Bus* bus) {
+    for (int i = 0; i < 256; i++) {
+        bus->main_memory[0x0200 + i] = (uint8_t)(i * 7);
+    }
+    bus->main_memory[0x10] = 0x00;
+    bus->main_memory[0x11] = 0x02;
+    bus->main_memory[0x12] = 0x00;
+    bus->main_memory[0x13] = 0x03;
+}
+
+// 8x8 -> 16 bit shift-and-add multiply of $20 by $21 into $23:$22, squaring each value of $21 in turn
+static const uint8_t multiply_program[] = {
+    0xA9, 0x00,         // C000: LDA #$00
+    0xA2, 0x08,         // C002: LDX #$08
+    0x46, 0x20,         // C004: LSR $20
+    0x90, 0x03,         // C006: BCC $C00B
+    0x18,               // C008: CLC
+    0x65, 0x21,         // C009: ADC $21
+    0x6A,               // C00B: ROR A
+    0x66, 0x22,         // C00C: ROR $22
+    0xCA,               // C00E: DEX
+    0xD0, 0xF3,         // C00F: BNE $C004
+    0x85, 0x23,         // C011: STA $23
+    0xA5, 0x21,         // C013: LDA $21
+    0x85, 0x20,         // C015: STA $20
+    0xE6, 0x21,         // C017: INC $21
+    0x4C, 0x00, 0xC0,   // C019: JMP $C000
+};
+
+static void multiply_setup(Bus* bus) {
+    bus->main_memory[0x20] = 0x00;
+    bus->main_memory[0x21] = 0x00;
+}
+
+// Data dependent branches on the bits of X, taken and not taken in every combination
+static const uint8_t branch_program[] = {
+    0xA2, 0x00,         // C000: LDX #$00
+    0x8A,               // C002: TXA
+    0x29, 0x01,         // C003: AND #$01
+    0xF0, 0x02,         // C005: BEQ $C009
+    0xE6, 0x30,         // C007: INC $30
+    0x8A,               // C009: TXA
+    0x29, 0x02,         // C00A: AND #$02
+    0xD0, 0x02,         // C00C: BNE $C010
+    0xC6, 0x31,         // C00E: DEC $31
+    0xE0, 0x80,         // C010: CPX #$80
+    0x90, 0x02,         // C012: BCC $C016
+    0xE6, 0x32,         // C014: INC $32
+    0xE8,               // C016: INX
+    0xD0, 0xE9,         // C017: BNE $C002
+    0x4C, 0x00, 0xC0,   // C019: JMP $C000
+};
+
+static void no_setup(Bus* bus) {
+}
+
+static const Kernel kernels[] = {
+    { "memcpy", memcpy_program, sizeof(memcpy_program), memcpy_setup },
+    { "multiply", multiply_program, sizeof(multiply_program), multiply_setup },
+    { "branches", branch_program, sizeof(branch_program), no_setup },
+};
+
+typedef struct Result {
+    const char* name;
+    long long instructions;
+    long long cycles;
+    double seconds;
+    uint8_t check[2];       // Something the run leaves in RAM, so a broken core shows up in the numbers
+} Result;
+
+static Bus* bench_bus(Cartridge* cart) {
+    Bus* bus = init_bus();
+    bus_attach_cartridge(bus, cart);
+    bus->dma_transfer = false;
+    return bus;
+}
+
+static double elapsed(struct timespec* start, struct timespec* end) {
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static Result run_kernel(const Kernel* kernel, long long instructions) {
+    Bus* bus = bench_bus(bench_cart(kernel->program, kernel->size, 1));
+    kernel->setup(bus);
+    Cpu* cpu = init_cpu(bus);
+    cpu_reset(cpu, bus);
+
+    // Warm up caches and branch predictors before timing
+    for (long long i = 0; i < BENCH_WARMUP; i++) {
+        cpu_step(cpu);
+    }
+
+    Result result = { kernel->name, instructions, 0, 0.0, { 0, 0 } };
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (long long i = 0; i < instructions; i++) {
+        result.cycles += cpu_step(cpu);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    result.seconds = elapsed(&start, &end);
+    result.check[0] = bus->main_memory[0x0310];
+    result.check[1] = bus->main_memory[0x23];
+    return result;
+}
+
+// nestest.nes from $C000 (automation mode), restarted after each pass, its result codes land in $02/$03
+static Result run_nestest(const char* path, long long instructions) {
+    Cartridge* cart = init_cart(path);
+    Bus* bus = bench_bus(cart);
+    Ppu* ppu = init_ppu();     // Never clocked, only there in case the test touches its registers
+    bus->ppu = ppu;
+    ppu_attach_cartridge(ppu, cart);
+    ppu->interrupts = bus->interrupts;
+    Cpu* cpu = init_cpu(bus);
+
+    Result result = { "nestest", 0, 0, 0.0, { 0, 0 } };
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (result.instructions < instructions) {
+        cpu->PC = 0xC000;
+        cpu->SP = 0xFD;
+        cpu_set_status(cpu, 0x24);
+        for (int i = 0; i < NESTEST_PASS; i++) {
+            result.cycles += cpu_step(cpu);
+        }
+        result.instructions += NESTEST_PASS;
+        if (result.instructions == NESTEST_PASS) {
+            result.check[0] = bus->main_memory[0x02];
+            result.check[1] = bus->main_memory[0x03];
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    result.seconds = elapsed(&start, &end);
+    return result;
+}
+
+static void write_json(FILE* out, const Result* results, int count) {
+    fprintf(out, "{\n  \"benchmark\": \"cpu\",\n  \"build\": {");
+#ifdef CPU_LAZY_FLAGS
+    fprintf(out, "\"lazy_flags\": true, ");
+#else
+    fprintf(out, "\"lazy_flags\": false, ");
+#endif
+#ifdef CPU_BLOCK_CACHE
+    fprintf(out, "\"block_cache\": true, ");
+#else
+    fprintf(out, "\"block_cache\": false, ");
+#endif
+#ifdef CPU_COMPUTED_GOTO
+    fprintf(out, "\"computed_goto\": true, ");
+#else
+    fprintf(out, "\"computed_goto\": false, ");
+#endif
+#ifdef __VERSION__
+    fprintf(out, "\"compiler\": \"%s\"", __VERSION__);
+#else
+    fprintf(out, "\"compiler\": \"unknown\"");
+#endif
+    fprintf(out, "},\n  \"results\": [\n");
+    for (int i = 0; i < count; i++) {
+        const Result* r = &results[i];
+        fprintf(out, "    {\"name\": \"%s\", \"instructions\": %lld, \"cycles\": %lld, \"seconds\": %.6f, "
+                     "\"mips\": %.3f, \"ns_per_instruction\": %.3f, \"check\": \"%02X%02X\"}%s\n",
+                r->name, r->instructions, r->cycles, r->seconds,
+                r->instructions / r->seconds / 1e6, r->seconds * 1e9 / r->instructions,
+                r->check[0], r->check[1], (i + 1 < count) ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+int main(int argc, char** argv) {
+    long long instructions = (argc > 1) ? atoll(argv[1]) : BENCH_INSTRUCTIONS;
+    const char* json_path = (argc > 2) ? argv[2] : "build/bench_cpu.json";
+    const char* nestest_path = (argc > 3) ? argv[3] : "roms/nestest.nes";
+
+    int kernel_count = sizeof(kernels) / sizeof(kernels[0]);
+    Result results[1 + sizeof(kernels) / sizeof(kernels[0])];
+    results[0] = run_nestest(nestest_path, instructions);
+    for (int i = 0; i < kernel_count; i++) {
+        results[1 + i] = run_kernel(&kernels[i], instructions);
+    }
+
+    for (int i = 0; i < 1 + kernel_count; i++) {
+        const Result* r = &results[i];
+        printf("[BENCH] %-8s instructions=%lld 6502_cycles=%lld time=%.3fs ns/instr=%.2f MIPS=%.2f (check=%02X%02X)\n",
+               r->name, r->instructions, r->cycles, r->seconds, r->seconds * 1e9 / r->instructions,
+               r->instructions / r->seconds / 1e6, r->check[0], r->check[1]);
+    }
+
+    FILE* out = fopen(json_path, "w");
+    if (!out) {
+        fprintf(stderr, "[BENCH] Cannot open '%s' for the results\n", json_path);
+        return 1;
+    }
+    write_json(out, results, 1 + kernel_count);
+    fclose(out);
+    printf("[BENCH] Results written to '%s'\n", json_path);
+    return 0;
+}
@@ -0,0 +1,564 @@
+// cpu_conformance.c
+// Single-step conformance runner for the CPU against per-opcode JSON test vectors, in the format of the
+// SingleStepTests/ProcessorTests 'nes6502' set: one file per opcode ('00.json' ... 'ff.json'), each an array of
+//     {"name": ..., "initial": {"pc", "s", "a", "x", "y", "p", "ram": [[addr, value], ...]},
+//      "final": {...same...}, "cycles": [[addr, value, "read"/"write"], ...]}
+// Every vector is run as one 'cpu_step' (the same dispatch the emulator uses) on a bus that is flat memory
+// from $2000 up, and its registers, the RAM it lists and its cycle count are compared with the final state.
+// Opcodes are shared out between worker threads, one per core unless told otherwise, each with its own system.
+// NOTE: The core isn't cycle stepped, so only the length of the 'cycles' list is checked, not each bus access
+// Usage: cpu_conformance tests_dir [-j threads] [-a] [-v]   ('make cpu-conformance' runs it)
+//     -a  Also run opcodes 'opcode_table' doesn't implement (unlisted ones decode as a 1 byte NOP)
+//     -v  List every opcode, not just the failing ones
+#include "../src/Bus.h"
+#include "../src/CPU.h"
+#include "../src/Cartridge.h"
+#include "../src/Mapper.h"
+#include "bench_cart.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#define MAX_RAM_ENTRIES     64      // 'ram' pairs in one state
+#define FAILURE_LENGTH      256
+
+// Registers and memory before or after one instruction
+typedef struct State {
+    uint16_t pc;
+    uint8_t s, a, x, y, p;
+    int ram_count;
+    uint16_t ram_addr[MAX_RAM_ENTRIES];
+    uint8_t ram_value[MAX_RAM_ENTRIES];
+} State;
+
+typedef struct TestCase {
+    char name[32];
+    State initial;
+    State final;
+    int cycles;     // Entries in the 'cycles' list
+} TestCase;
+
+typedef struct OpcodeResult {
+    bool no_file;               // No vectors for this opcode
+    bool not_implemented;       // Skipped, 'opcode_table' doesn't implement it
+    bool malformed;             // The file stopped parsing part way
+    int tests;
+    int passed;
+    int failed;
+    int cycle_mismatches;       // Failures where the cycle count was (one of the things) wrong
+    int skipped;                // Vectors touching two RAM addresses that share a mirror
+    char first_failure[FAILURE_LENGTH];
+} OpcodeResult;
+
+typedef struct Runner {
+    const char* dir;
+    bool run_all;
+    atomic_int next_opcode;
+    OpcodeResult results[256];
+} Runner;
+
+// One system per worker: the real Bus, with a cartridge whose mapper claims everything from $2000 up as
+// PRG memory at the same offset, so the CPU sees 64KB of flat memory (bar the 2KB of mirrored system RAM)
+typedef struct System {
+    Cartridge* cart;
+    Bus* bus;
+    Cpu* cpu;
+} System;
+
+
+/*///////FLAT CARTRIDGE////////////////////////////////////////////////////////////////////////////////*/
+
+static bool flat_cpu_map(Mapper* mapper, uint16_t address, uint32_t* mapped_addr) {
+    if (address >= 0x2000) {
+        *mapped_addr = address;
+        return true;
+    }
+    return false;
+}
+
+static bool flat_cpu_claims(Mapper* mapper, uint16_t address) {
+    return address >= 0x2000;
+}
+
+static bool flat_ppu_map(Mapper* mapper, uint16_t address, uint32_t* mapped_addr) {
+    return false;
+}
+
+static System init_system() {
+    System s;
+    s.cart = bench_cart(NULL, 0, 4);  // 64KB of PRG, so every address the flat mapper hands out is in it
+    s.cart->mapper->mapper_cpu_read = flat_cpu_map;
+    s.cart->mapper->mapper_cpu_write = flat_cpu_map;
+    s.cart->mapper->mapper_cpu_claims = flat_cpu_claims;
+    s.cart->mapper->mapper_ppu_read = flat_ppu_map;
+    s.cart->mapper->mapper_ppu_write = flat_ppu_map;
+
+    s.bus = init_bus();
+    bus_attach_cartridge(s.bus, s.cart);
+    s.bus->dma_transfer = false;
+    s.cpu = init_cpu(s.bus);
+    return s;
+}
+
+static uint8_t* memory_at(System* s, uint16_t address) {
+    return (address <= 0x1FFF) ? &s->bus->main_memory[address & 0x07FF] : &s->cart->prg_memory->items[address];
+}
+
+
+/*///////JSON//////////////////////////////////////////////////////////////////////////////////////////*/
+
+// Just enough JSON for the vectors, anything unexpected sets 'error' and parsing stops
+typedef struct Parser {
+    const char* p;
+    const char* end;
+    bool error;
+} Parser;
+
+static void skip_space(Parser* in) {
+    while (in->p < in->end && (*in->p == ' ' || *in->p == '\n' || *in->p == '\r' || *in->p == '\t')) {
+        in->p++;
+    }
+}
+
+// Consume 'c' (after any whitespace) if it is next
+static bool accept(Parser* in, char c) {
+    skip_space(in);
+    if (in->p < in->end && *in->p == c) {
+        in->p++;
+        return true;
+    }
+    return false;
+}
+
+static void expect(Parser* in, char c) {
+    if (!accept(in, c)) {
+        in->error = true;
+    }
+}
+
+static long parse_number(Parser* in) {
+    skip_space(in);
+    bool negative = in->p < in->end && *in->p == '-';
+    if (negative) {
+        in->p++;
+    }
+    if (in->p >= in->end || *in->p < '0' || *in->p > '9') {
+        in->error = true;
+        return 0;
+    }
+    long value = 0;
+    while (in->p < in->end && *in->p >= '0' && *in->p <= '9') {
+        value = value * 10 + (*in->p++ - '0');
+    }
+    return negative ? -value : value;
+}
+
+// Read a string into 'out' (cut short if it doesn't fit, escapes kept as they are)
+static void parse_string(Parser* in, char* out, size_t size) {
+    if (!accept(in, '"')) {
+        in->error = true;
+        return;
+    }
+    size_t length = 0;
+    while (in->p < in->end && *in->p != '"') {
+        if (*in->p == '\\' && in->p + 1 < in->end) {
+            in->p++;
+        }
+        if (out && length + 1 < size) {
+            out[length++] = *in->p;
+        }
+        in->p++;
+    }
+    if (out && size) {
+        out[length] = '\0';
+    }
+    in->error |= !accept(in, '"');
+}
+
+static void skip_value(Parser* in) {
+    skip_space(in);
+    if (in->p >= in->end) {
+        in->error = true;
+    } else if (*in->p == '"') {
+        parse_string(in, NULL, 0);
+    } else if (*in->p == '[' || *in->p == '{') {
+        char close = (*in->p++ == '[') ? ']' : '}';
+        if (accept(in, close)) {
+            return;
+        }
+        do {
+            if (close == '}') {
+                parse_string(in, NULL, 0);
+                expect(in, ':');
+            }
+            skip_value(in);
+        } while (!in->error && accept(in, ','));
+        expect(in, close);
+    } else {
+        // Number, true, false or null
+        const char* start = in->p;
+        while (in->p < in->end && *in->p != ',' && *in->p != ']' && *in->p != '}' &&
+               *in->p != ' ' && *in->p != '\n' && *in->p != '\r' && *in->p != '\t') {
+            in->p++;
+        }
+        in->error |= (in->p == start);
+    }
+}
+
+static void parse_state(Parser* in, State* state) {
+    memset(state, 0, sizeof(State));
+    expect(in, '{');
+    do {
+        char key[8];
+        parse_string(in, key, sizeof(key));
+        expect(in, ':');
+        if (strcmp(key, "pc") == 0) {
+            state->pc = (uint16_t)parse_number(in);
+        } else if (strcmp(key, "s") == 0) {
+            state->s = (uint8_t)parse_number(in);
+        } else if (strcmp(key, "a") == 0) {
+            state->a = (uint8_t)parse_number(in);
+        } else if (strcmp(key, "x") == 0) {
+            state->x = (uint8_t)parse_number(in);
+        } else if (strcmp(key, "y") == 0) {
+            state->y = (uint8_t)parse_number(in);
+        } else if (strcmp(key, "p") == 0) {
+            state->p = (uint8_t)parse_number(in);
+        } else if (strcmp(key, "ram") == 0) {
+            expect(in, '[');
+            if (!accept(in, ']')) {
+                do {
+                    if (state->ram_count == MAX_RAM_ENTRIES) {
+                        in->error = true;
+                        return;
+                    }
+                    expect(in, '[');
+                    state->ram_addr[state->ram_count] = (uint16_t)parse_number(in);
+                    expect(in, ',');
+                    state->ram_value[state->ram_count] = (uint8_t)parse_number(in);
+                    expect(in, ']');
+                    state->ram_count++;
+                } while (!in->error && accept(in, ','));
+                expect(in, ']');
+            }
+        } else {
+            skip_value(in);
+        }
+    } while (!in->error && accept(in, ','));
+    expect(in, '}');
+}
+
+// Parse the next vector of the array, false at the end of it (or on an error)
+static bool parse_test(Parser* in, TestCase* test, bool first) {
+    if (first ? accept(in, ']') : !accept(in, ',')) {
+        return false;
+    }
+
+    memset(test->name, 0, sizeof(test->name));
+    test->cycles = 0;
+    expect(in, '{');
+    do {
+        char key[16];
+        parse_string(in, key, sizeof(key));
+        expect(in, ':');
+        if (strcmp(key, "name") == 0) {
+            parse_string(in, test->name, sizeof(test->name));
+        } else if (strcmp(key, "initial") == 0) {
+            parse_state(in, &test->initial);
+        } else if (strcmp(key, "final") == 0) {
+            parse_state(in, &test->final);
+        } else if (strcmp(key, "cycles") == 0) {
+            expect(in, '[');
+            if (!accept(in, ']')) {
+                do {
+                    skip_value(in);
+                    test->cycles++;
+                } while (!in->error && accept(in, ','));
+                expect(in, ']');
+            }
+        } else {
+            skip_value(in);
+        }
+    } while (!in->error && accept(in, ','));
+    expect(in, '}');
+    return !in->error;
+}
+
+static char* read_file(const char* path, size_t* size) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* data = (length > 0) ? (char*)malloc(length) : NULL;
+    if (!data || fread(data, 1, length, file) != (size_t)length) {
+        free(data);
+        fclose(file);
+        return NULL;
+    }
+    fclose(file);
+    *size = length;
+    return data;
+}
+
+
+/*///////RUNNING VECTORS///////////////////////////////////////////////////////////////////////////////*/
+
+// Opcodes not in CPU_OPCODES decode as a 1 byte, 2 cycle NOP, so those are the ones that aren't implemented
+static bool opcode_implemented(uint8_t opcode) {
+    Opcode c = opcode_table[opcode];
+    return opcode == 0xEA || c.instruction != NOP || c.addressing_mode != IMP;
+}
+
+// System RAM is mirrored, two different addresses of a vector that land on the same byte can't both hold their values
+static bool ram_mirror_clash(const TestCase* test) {
+    const State* states[2] = { &test->initial, &test->final };
+    uint16_t seen[2 * MAX_RAM_ENTRIES];
+    int count = 0;
+    for (int s = 0; s < 2; s++) {
+        for (int i = 0; i < states[s]->ram_count; i++) {
+            uint16_t address = states[s]->ram_addr[i];
+            if (address > 0x1FFF) {
+                continue;
+            }
+            for (int j = 0; j < count; j++) {
+                if (seen[j] != address && (seen[j] & 0x07FF) == (address & 0x07FF)) {
+                    return true;
+                }
+            }
+            seen[count++] = address;
+        }
+    }
+    return false;
+}
+
+// Append one difference to the failure description
+static void describe(char* failure, const char* format, unsigned int got, unsigned int expected) {
+    size_t length = strlen(failure);
+    if (length < FAILURE_LENGTH - 1) {
+        snprintf(failure + length, FAILURE_LENGTH - length, format, got, expected);
+    }
+}
+
+// Run one vector, returns false (with what differed in 'failure') if it doesn't end in the final state
+static bool run_test(System* s, const TestCase* test, char* failure, bool* cycles_wrong) {
+    Cpu* cpu = s->cpu;
+    for (int i = 0; i < test->initial.ram_count; i++) {
+        *memory_at(s, test->initial.ram_addr[i]) = test->initial.ram_value[i];
+    }
+    cpu->PC = test->initial.pc;
+    cpu->SP = test->initial.s;
+    cpu->A = test->initial.a;
+    cpu->X = test->initial.x;
+    cpu->Y = test->initial.y;
+    cpu_set_status(cpu, test->initial.p);
+
+    // Memory changed behind the CPU's back: drop decoded code, cached code pages and the PRG map
+    s->bus->cart_writes++;
+    if (cpu->block_cache) {
+        block_cache_flush(cpu->block_cache);
+    }
+    cpu_map_prg(cpu);
+
+    int cycles = cpu_step(cpu);
+
+    // B and bit 5 aren't really in P (they only exist in copies pushed to the stack, checked with the RAM)
+    const State* expected = &test->final;
+    uint8_t status = cpu_get_status(cpu);
+    snprintf(failure, FAILURE_LENGTH, "%s:", test->name);
+    bool passed = true;
+    if (cpu->PC != expected->pc) { describe(failure, " PC=%04X (expected %04X)", cpu->PC, expected->pc); passed = false; }
+    if (cpu->SP != expected->s) { describe(failure, " SP=%02X (expected %02X)", cpu->SP, expected->s); passed = false; }
+    if (cpu->A != expected->a) { describe(failure, " A=%02X (expected %02X)", cpu->A, expected->a); passed = false; }
+    if (cpu->X != expected->x) { describe(failure, " X=%02X (expected %02X)", cpu->X, expected->x); passed = false; }
+    if (cpu->Y != expected->y) { describe(failure, " Y=%02X (expected %02X)", cpu->Y, expected->y); passed = false; }
+    if ((status & 0xCF) != (expected->p & 0xCF)) {
+        describe(failure, " P=%02X (expected %02X)", status, expected->p);
+        passed = false;
+    }
+    for (int i = 0; i < expected->ram_count; i++) {
+        uint8_t value = *memory_at(s, expected->ram_addr[i]);
+        if (value != expected->ram_value[i]) {
+            describe(failure, " [%04X]", expected->ram_addr[i], 0);
+            describe(failure, "=%02X (expected %02X)", value, expected->ram_value[i]);
+            passed = false;
+        }
+    }
+    *cycles_wrong = (cycles != test->cycles);
+    if (*cycles_wrong) {
+        describe(failure, " cycles=%u (expected %u)", cycles, test->cycles);
+        passed = false;
+    }
+
+    // Leave memory clear for the next vector
+    for (int i = 0; i < test->initial.ram_count; i++) {
+        *memory_at(s, test->initial.ram_addr[i]) = 0;
+    }
+    for (int i = 0; i < expected->ram_count; i++) {
+        *memory_at(s, expected->ram_addr[i]) = 0;
+    }
+    return passed;
+}
+
+static void run_opcode(Runner* runner, System* s, uint8_t opcode) {
+    OpcodeResult* result = &runner->results[opcode];
+    if (!runner->run_all && !opcode_implemented(opcode)) {
+        result->not_implemented = true;
+        return;
+    }
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%02x.json", runner->dir, opcode);
+    size_t size = 0;
+    char* data = read_file(path, &size);
+    if (!data) {
+        result->no_file = true;
+        return;
+    }
+
+    Parser in = { data, data + size, false };
+    TestCase test;
+    char failure[FAILURE_LENGTH];
+    expect(&in, '[');
+    for (bool first = true; !in.error && parse_test(&in, &test, first); first = false) {
+        result->tests++;
+        if (ram_mirror_clash(&test)) {
+            result->skipped++;
+            continue;
+        }
+        bool cycles_wrong = false;
+        if (run_test(s, &test, failure, &cycles_wrong)) {
+            result->passed++;
+        } else {
+            if (result->failed++ == 0) {
+                memcpy(result->first_failure, failure, FAILURE_LENGTH);
+            }
+            result->cycle_mismatches += cycles_wrong;
+        }
+    }
+    result->malformed = in.error;
+    free(data);
+}
+
+static void* worker(void* arg) {
+    Runner* runner = (Runner*)arg;
+    System s = init_system();
+    int opcode;
+    while ((opcode = atomic_fetch_add(&runner->next_opcode, 1)) < 256) {
+        run_opcode(runner, &s, (uint8_t)opcode);
+    }
+    return NULL;
+}
+
+static int core_count() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0) ? (int)count : 1;
+#endif
+}
+
+
+int main(int argc, char** argv) {
+    static Runner runner;
+    int threads = core_count();
+    bool verbose = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-a") == 0) {
+            runner.run_all = true;
+        } else if (strcmp(argv[i], "-v") == 0) {
+            verbose = true;
+        } else if (!runner.dir && argv[i][0] != '-') {
+            runner.dir = argv[i];
+        } else {
+            runner.dir = NULL;
+            break;
+        }
+    }
+    if (!runner.dir || threads < 1) {
+        fprintf(stderr, "Usage: %s tests_dir [-j threads] [-a] [-v]\n", argv[0]);
+        return 2;
+    }
+    atomic_init(&runner.next_opcode, 0);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_t* pool = (pthread_t*)malloc(threads * sizeof(pthread_t));
+    if (!pool) {
+        fprintf(stderr, "[CONFORMANCE] Error, Failed to allocate memory for the thread pool.\n");
+        exit(1);
+    }
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&pool[i], NULL, worker, &runner) != 0) {
+            fprintf(stderr, "[CONFORMANCE] Error, Failed to start worker thread %d.\n", i);
+            exit(1);
+        }
+    }
+    for (int i = 0; i < threads; i++) {
+        pthread_join(pool[i], NULL);
+    }
+    free(pool);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    // Per opcode report, then the totals
+    int opcodes_passed = 0, opcodes_failed = 0, not_implemented = 0, no_file = 0;
+    long long tests = 0, passed = 0, failed = 0, skipped = 0;
+    for (int op = 0; op < 256; op++) {
+        const OpcodeResult* r = &runner.results[op];
+        Opcode c = opcode_table[op];
+        if (r->not_implemented) {
+            not_implemented++;
+            continue;
+        }
+        if (r->no_file) {
+            no_file++;
+            if (verbose) {
+                printf("[CONFORMANCE] %02X %-6s %s  no vectors\n", op, InstructionStrings[c.instruction], AddressModeStrings[c.addressing_mode]);
+            }
+            continue;
+        }
+        bool ok = (r->failed == 0 && !r->malformed);
+        ok ? opcodes_passed++ : opcodes_failed++;
+        tests += r->tests;
+        passed += r->passed;
+        failed += r->failed;
+        skipped += r->skipped;
+        if (!ok || verbose) {
+            printf("[CONFORMANCE] %02X %-6s %s  %s %d/%d passed", op, InstructionStrings[c.instruction],
+                   AddressModeStrings[c.addressing_mode], ok ? "OK  " : "FAIL", r->passed, r->tests - r->skipped);
+            if (r->cycle_mismatches) {
+                printf(", %d wrong cycle counts", r->cycle_mismatches);
+            }
+            if (r->skipped) {
+                printf(", %d skipped (RAM mirrors)", r->skipped);
+            }
+            printf("%s\n", r->malformed ? ", file stopped parsing part way" : "");
+            if (r->failed) {
+                printf("[CONFORMANCE]     first failure %s\n", r->first_failure);
+            }
+        }
+    }
+
+    printf("[CONFORMANCE] %d opcodes passed, %d failed, %d not implemented (skipped), %d without vectors\n",
+           opcodes_passed, opcodes_failed, not_implemented, no_file);
+    printf("[CONFORMANCE] %lld vectors: %lld passed, %lld failed, %lld skipped, in %.2fs on %d threads\n",
+           tests, passed, failed, skipped, seconds, threads);
+    if (opcodes_passed + opcodes_failed == 0) {
+        fprintf(stderr, "[CONFORMANCE] No vectors found in '%s'\n", runner.dir);
+        return 2;
+    }
+    return (opcodes_failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,82 @@
+// cpu_flags_bench.c
+// Micro-benchmark for the CPU's flag handling (lazy vs eager N/Z/C/V)
+// Runs a flag-heavy ALU loop from a tiny in-memory NROM cartridge and reports host time per instruction
+// Built twice by 'make bench-flags', once as-is (lazy flags) and once with -DCPU_NO_LAZY_FLAGS (eager)
+#include "../src/Bus.h"
+#include "../src/CPU.h"
+#include "../src/Cartridge.h"
+#include "bench_cart.h"
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#else
+#define HAVE_TSC 0
+#endif
+
+#define BENCH_INSTRUCTIONS 50000000LL
+
+// Loop at $C000, every instruction here writes some of N/Z/C/V and almost none of them are read
+static const uint8_t bench_program[] = {
+    0xA2, 0x00,         // C000: LDX #$00
+    0xA9, 0x37,         // C002: LDA #$37
+    0x69, 0x5A,         // C004: ADC #$5A
+    0x29, 0xF0,         // C006: AND #$F0
+    0x09, 0x0F,         // C008: ORA #$0F
+    0x49, 0xAA,         // C00A: EOR #$AA
+    0xC9, 0x40,         // C00C: CMP #$40
+    0x0A,               // C00E: ASL A
+    0x2A,               // C00F: ROL A
+    0x4A,               // C010: LSR A
+    0xE9, 0x11,         // C011: SBC #$11
+    0x85, 0x10,         // C013: STA $10
+    0xA5, 0x10,         // C015: LDA $10
+    0xE8,               // C017: INX
+    0xD0, 0xE8,         // C018: BNE $C002
+    0x4C, 0x00, 0xC0,   // C01A: JMP $C000
+};
+
+int main(void) {
+    Bus* bus = init_bus();
+    bus_attach_cartridge(bus, bench_cart(bench_program, sizeof(bench_program), 1));
+    bus->dma_transfer = false;
+    Cpu* cpu = init_cpu(bus);
+    cpu_reset(cpu, bus);
+
+    // Warm up caches and branch predictors before timing
+    for (int i = 0; i < 1000000; i++) {
+        cpu_step(cpu);
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+#if HAVE_TSC
+    uint64_t tsc_start = __rdtsc();
+#endif
+
+    long long cycles = 0;
+    for (long long i = 0; i < BENCH_INSTRUCTIONS; i++) {
+        cycles += cpu_step(cpu);
+    }
+
+#if HAVE_TSC
+    uint64_t tsc_end = __rdtsc();
+#endif
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+#ifdef CPU_LAZY_FLAGS
+    const char* mode = "lazy";
+#else
+    const char* mode = "eager";
+#endif
+
+    printf("[BENCH] flags=%-5s instructions=%lld 6502_cycles=%lld time=%.3fs ns/instr=%.2f MIPS=%.2f",
+           mode, BENCH_INSTRUCTIONS, cycles, seconds, seconds * 1e9 / BENCH_INSTRUCTIONS, BENCH_INSTRUCTIONS / seconds / 1e6);
+#if HAVE_TSC
+    printf(" tsc/instr=%.2f", (double)(tsc_end - tsc_start) / BENCH_INSTRUCTIONS);
+#endif
+    printf(" (A=%02X STATUS=%02X)\n", cpu->A, cpu_get_status(cpu));
+    return 0;
+}
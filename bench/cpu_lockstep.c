@@ -0,0 +1,90 @@
+// cpu_lockstep.c
+// Lockstep check of the CPU's shortcuts (idle loop skipping, bulk OAM DMA, and the JIT when built with -DCPU_JIT)
+// against the plain interpreter
+// Runs each ROM given on the command line twice side by side, one system taking the shortcuts and one
+// stepping one instruction (and DMA cycle) at a time, and compares CPU registers, RAM, OAM and PPU position every time the
+// fast system reaches the end of an instruction/block/skip
+// Usage: cpu_lockstep frames rom.nes [rom.nes ...]   ('make idle-check'/'make jit-check' run it over roms/tests)
+#include "../src/System.h"
+
+// Exits if the emulator can't run the ROM, or was built without the shortcuts
+static System* lockstep_system(const char* path) {
+    System* s = init_system(path);
+    if (!s) {
+        exit(2);
+    }
+    if (!s->cpu->idle_loop) {
+        fprintf(stderr, "[LOCKSTEP] Built with -DCPU_NO_IDLE_SKIP\n");
+        exit(2);
+    }
+    return s;
+}
+
+static bool same_state(System* a, System* b) {
+    return a->nes_cycles_passed == b->nes_cycles_passed &&
+           a->cpu->A == b->cpu->A && a->cpu->X == b->cpu->X && a->cpu->Y == b->cpu->Y &&
+           a->cpu->SP == b->cpu->SP && a->cpu->PC == b->cpu->PC &&
+           cpu_get_status(a->cpu) == cpu_get_status(b->cpu) &&
+           a->cpu->cycle_count == b->cpu->cycle_count &&
+           a->ppu->scanline == b->ppu->scanline && a->ppu->cycle == b->ppu->cycle &&
+           memcmp(a->bus->main_memory, b->bus->main_memory, sizeof(a->bus->main_memory)) == 0 &&
+           memcmp(a->ppu->oam, b->ppu->oam, sizeof(a->ppu->oam)) == 0;
+}
+
+static void print_state(const char* name, System* s) {
+    fprintf(stderr, "  %-6s cycles=%lld PC=%04X A=%02X X=%02X Y=%02X SP=%02X P=%02X ppu=%d,%d\n", name,
+            s->nes_cycles_passed, s->cpu->PC, s->cpu->A, s->cpu->X, s->cpu->Y, s->cpu->SP,
+            cpu_get_status(s->cpu), s->ppu->scanline, s->ppu->cycle);
+}
+
+static bool run_rom(const char* path, int frames) {
+    System* fast = lockstep_system(path);
+    System* ref = lockstep_system(path);
+#ifdef CPU_JIT
+    if (!fast->cpu->jit) {
+        fprintf(stderr, "[LOCKSTEP] No executable memory for the JIT\n");
+        return false;
+    }
+#endif
+
+    while (fast->ppu->frames_completed < frames) {
+        system_clock(fast, true);
+        while (ref->nes_cycles_passed < fast->nes_cycles_passed) {
+            system_clock(ref, false);
+        }
+        if (!same_state(fast, ref)) {
+            fprintf(stderr, "[LOCKSTEP] %s: diverged in frame %d\n", path, fast->ppu->frames_completed);
+            print_state("fast", fast);
+            print_state("interp", ref);
+            return false;
+        }
+    }
+
+    IdleLoop* idle = fast->cpu->idle_loop;
+    fprintf(stderr, "[LOCKSTEP] %s: %d frames match (idle cycles skipped=%lld in %lld skips)\n",
+            path, frames, idle->cycles_skipped, idle->skips);
+#ifdef CPU_JIT
+    Jit* j = fast->cpu->jit;
+    fprintf(stderr, "[LOCKSTEP]   blocks compiled=%lld rejected=%lld run natively=%lld\n",
+            j->blocks_compiled, j->blocks_rejected, j->blocks_run);
+#endif
+    free_system(fast);
+    free_system(ref);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s frames rom.nes [rom.nes ...]\n", argv[0]);
+        return 2;
+    }
+
+    int frames = atoi(argv[1]);
+    int failed = 0;
+    for (int i = 2; i < argc; i++) {
+        if (!run_rom(argv[i], frames)) {
+            failed++;
+        }
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,111 @@
+// ppu_render_check.c
+// Frame hash check of the scanline renderer against the dot renderer
+// Runs each ROM given on the command line twice side by side, one PPU rendering whole scanlines where it can and one
+// rendering every dot, with the same buttons injected on both (Start/A pressed now and then so games get past their
+// title screens). Compares CPU registers, PPU position and status (once the scanline renderer has caught up) after
+// every instruction, and a hash of the framebuffer at the end of every frame
+// Usage: ppu_render_check frames rom.nes [rom.nes ...]   ('make render-check' runs it over roms)
+#include "../src/System.h"
+#include "../src/Input.h"
+
+#ifndef PPU_SCANLINE_RENDER
+#error "Built with -DPPU_NO_SCANLINE_RENDER, there is only the dot renderer to check"
+#endif
+
+static bool same_state(System* a, System* b) {
+    return a->nes_cycles_passed == b->nes_cycles_passed &&
+           a->cpu->A == b->cpu->A && a->cpu->X == b->cpu->X && a->cpu->Y == b->cpu->Y &&
+           a->cpu->SP == b->cpu->SP && a->cpu->PC == b->cpu->PC &&
+           cpu_get_status(a->cpu) == cpu_get_status(b->cpu) &&
+           a->ppu->scanline == b->ppu->scanline && a->ppu->cycle == b->ppu->cycle &&
+           (a->ppu->line_pending || a->ppu->registers.status.reg == b->ppu->registers.status.reg);
+}
+
+// FNV-1a of the framebuffer, leaving out scanline 'skip'
+static uint64_t frame_hash(Ppu* ppu, int skip) {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (int y = 0; y < PPU_SCREEN_HEIGHT; y++) {
+        const uint8_t* bytes = (const uint8_t*)&ppu->framebuffer[y * PPU_SCREEN_WIDTH];
+        for (size_t i = 0; i < PPU_SCREEN_WIDTH * sizeof(uint32_t) && y != skip; i++) {
+            hash = (hash ^ bytes[i]) * 0x100000001B3ULL;
+        }
+    }
+    return hash;
+}
+
+static void print_state(const char* name, System* s) {
+    fprintf(stderr, "  %-8s cycles=%lld PC=%04X A=%02X X=%02X Y=%02X SP=%02X P=%02X ppu=%d,%d status=%02X\n", name,
+            s->nes_cycles_passed, s->cpu->PC, s->cpu->A, s->cpu->X, s->cpu->Y, s->cpu->SP,
+            cpu_get_status(s->cpu), s->ppu->scanline, s->ppu->cycle, s->ppu->registers.status.reg);
+}
+
+static bool run_rom(const char* path, int frames) {
+    System* line = init_system(path);
+    if (!line) {
+        fprintf(stderr, "[RENDER] %s: skipped (mapper not implemented)\n", path);
+        return true;
+    }
+    System* dot = init_system(path);
+    dot->ppu->scanline_render = false;
+
+    int frame = 0;
+    while (frame < frames) {
+        system_clock(line, true);
+        while (dot->nes_cycles_passed < line->nes_cycles_passed) {
+            system_clock(dot, true);
+        }
+        if (!same_state(line, dot)) {
+            fprintf(stderr, "[RENDER] %s: diverged in frame %d\n", path, frame);
+            print_state("scanline", line);
+            print_state("dot", dot);
+            return false;
+        }
+
+        if (line->ppu->frame_done) {
+            line->ppu->frame_done = false;
+            dot->ppu->frame_done = false;
+            // A frame can end part way through a long step (OAM DMA), by when the dot renderer may have drawn some of
+            // a scanline of the next frame that the scanline renderer is still holding back
+            int skip = line->ppu->line_pending ? line->ppu->scanline : -1;
+            if (frame_hash(line->ppu, skip) != frame_hash(dot->ppu, skip)) {
+                int pixel = 0;
+                while (line->ppu->framebuffer[pixel] == dot->ppu->framebuffer[pixel] || pixel / PPU_SCREEN_WIDTH == skip) {
+                    pixel++;
+                }
+                fprintf(stderr, "[RENDER] %s: frame %d differs, first at x=%d y=%d (%08X, dot renderer %08X)\n",
+                        path, frame, pixel % PPU_SCREEN_WIDTH, pixel / PPU_SCREEN_WIDTH,
+                        line->ppu->framebuffer[pixel], dot->ppu->framebuffer[pixel]);
+                return false;
+            }
+
+            // Same buttons on both, for the frame after this one
+            frame++;
+            uint8_t buttons = ((frame / 30) % 2) ? INPUT_START : (((frame / 7) % 3 == 0) ? INPUT_A : 0x00);
+            input_inject(line->bus->input, 0, buttons, frame);
+            input_inject(dot->bus->input, 0, buttons, frame);
+        }
+    }
+
+    Ppu* ppu = line->ppu;
+    fprintf(stderr, "[RENDER] %s: %d frames match (scanlines rendered in one pass=%lld, caught up part way=%lld)\n",
+            path, frames, ppu->lines_rendered, ppu->lines_caught_up);
+    free_system(line);
+    free_system(dot);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s frames rom.nes [rom.nes ...]\n", argv[0]);
+        return 2;
+    }
+
+    int frames = atoi(argv[1]);
+    int failed = 0;
+    for (int i = 2; i < argc; i++) {
+        if (!run_rom(argv[i], frames)) {
+            failed++;
+        }
+    }
+    return failed ? 1 : 0;
+}
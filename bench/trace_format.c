@@ -0,0 +1,46 @@
+// trace_format.c
+// Formats a binary instruction trace (the 'trace.bin' a -DCPU_TRACE build streams on F11) as nestest.log
+// style lines, e.g. to diff against nestest.log or another emulator's trace
+// Usage: trace_format trace.bin [first_record [count]] > trace.log   ('make trace-format' builds it)
+#include "../src/Trace.h"
+#include "../src/CPU.h"
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s trace.bin [first_record [count]]\n", argv[0]);
+        return 1;
+    }
+    long long first = (argc > 2) ? atoll(argv[2]) : 0;
+    long long count = (argc > 3) ? atoll(argv[3]) : -1;
+
+    FILE* in = fopen(argv[1], "rb");
+    if (!in) {
+        fprintf(stderr, "Cannot open '%s'\n", argv[1]);
+        return 1;
+    }
+    char magic[8];
+    uint32_t record_size;
+    if (fread(magic, 1, 8, in) != 8 || memcmp(magic, TRACE_FILE_MAGIC, 8) != 0 ||
+        fread(&record_size, sizeof(record_size), 1, in) != 1 || record_size != sizeof(TraceRecord)) {
+        fprintf(stderr, "'%s' is not a trace file from this build\n", argv[1]);
+        fclose(in);
+        return 1;
+    }
+    if (first > 0 && fseek(in, (long)(first * sizeof(TraceRecord)), SEEK_CUR) != 0) {
+        fprintf(stderr, "'%s' has fewer than %lld records\n", argv[1], first);
+        fclose(in);
+        return 1;
+    }
+
+    TraceRecord records[1024];
+    char line[128];
+    size_t n;
+    while (count != 0 && (n = fread(records, sizeof(TraceRecord), 1024, in)) > 0) {
+        for (size_t i = 0; i < n && count != 0; i++, count--) {
+            trace_format(&records[i], line, sizeof(line));
+            puts(line);
+        }
+    }
+    fclose(in);
+    return 0;
+}
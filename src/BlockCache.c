@@ -0,0 +1,159 @@
+// BlockCache.c
+// Nintendo Entertainment System CPU Decoded Block Cache Implementation
+#include "BlockCache.h"
+#include "Bus.h"
+#include "CPU.h"
+#include "Cartridge.h"
+#include "Jit.h"
+
+
+BlockCache* init_block_cache() {
+    BlockCache* cache = (BlockCache*)malloc(sizeof(BlockCache));
+    if (!cache) {
+        fprintf(stderr, "[BLOCKCACHE] Error, Failed to allocate memory for the block cache.\n");
+        exit(1);
+    }
+    memset(cache, 0, sizeof(BlockCache));
+    cache->windows_dirty = true;
+
+    printf("[BLOCKCACHE] Block cache initialised!\n");
+    return cache;
+}
+
+// Drop everything (new cartridge, reset)
+void block_cache_flush(BlockCache* cache) {
+    block_cache_invalidate_prg(cache);
+    block_cache_invalidate_ram(cache);
+}
+
+void block_cache_invalidate_prg(BlockCache* cache) {
+    cache->generation[BLOCK_SOURCE_PRG]++;
+    cache->windows_dirty = true;
+    cache->next = NULL;
+}
+
+void block_cache_invalidate_ram(BlockCache* cache) {
+    cache->generation[BLOCK_SOURCE_RAM]++;
+    memset(cache->ram_code, 0, sizeof(cache->ram_code));
+    cache->next = NULL;
+}
+
+// Ask the mapper where each 8KB window of $8000-$FFFF currently points in PRG memory
+static void refresh_prg_windows(BlockCache* cache, Bus* bus) {
+    for (int i = 0; i < 4; i++) {
+        uint32_t mapped_addr = 0;
+        Mapper* mapper = bus->cart->mapper;
+        if (mapper->mapper_cpu_read(mapper, 0x8000 + (i * 0x2000), &mapped_addr)) {
+            cache->prg_window[i] = mapped_addr;
+        } else {
+            cache->prg_window[i] = UINT32_MAX;
+        }
+    }
+    cache->windows_dirty = false;
+}
+
+// Instructions that (may) move PC somewhere other than the next instruction end a block
+static bool ends_block(Instruction instruction) {
+    switch (instruction) {
+        case JMP: case JSR: case RTS: case RTI: case BRK:
+        case BCC: case BCS: case BEQ: case BMI: case BNE: case BPL: case BVC: case BVS:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Decode straight-line code from 'pc' up to the end of 'limit' (exclusive)
+static void decode_block(BlockCache* cache, Bus* bus, Block* block, uint16_t pc, BlockSource source, uint32_t bank, uint32_t limit) {
+    block->pc = pc;
+    block->source = source;
+    block->bank = bank;
+    block->generation = cache->generation[source];
+#ifdef CPU_JIT
+    block->jit_state = JIT_NONE;
+    block->hits = 0;
+    block->native = NULL;
+#endif
+
+    uint32_t addr = pc;
+    uint8_t count = 0;
+    while (count < BLOCK_MAX_OPS) {
+        uint8_t opcode = bus_read(bus, addr);
+        Opcode c = opcode_table[opcode];
+
+        // Never let an instruction's bytes run past the window its block is keyed on
+        if (addr + c.bytes > limit) {
+            break;
+        }
+
+        uint16_t operand = 0;
+        if (c.bytes == 2) {
+            operand = bus_read(bus, addr + 1);
+        } else if (c.bytes == 3) {
+            operand = bus_read(bus, addr + 1) | (bus_read(bus, addr + 2) << 8);
+        }
+        uint16_t next_pc = addr + c.bytes;
+        if (c.addressing_mode == REL) {
+            operand = next_pc + (int8_t)operand;
+        }
+
+        DecodedOp* op = &block->ops[count++];
+        op->handler = decoded_handlers[opcode];
+        op->pc = addr;
+        op->next_pc = next_pc;
+        op->operand = operand;
+
+        if (source == BLOCK_SOURCE_RAM) {
+            for (uint32_t a = addr; a < addr + c.bytes; a++) {
+                cache->ram_code[(a & 0x07FF) >> 8] = true;
+            }
+        }
+
+        addr += c.bytes;
+        if (ends_block(c.instruction)) {
+            break;
+        }
+    }
+
+    block->count = count;
+    block->ops[count].pc = BLOCK_END;
+}
+
+Block* block_cache_block(BlockCache* cache, Bus* bus, uint16_t pc) {
+    BlockSource source;
+    uint32_t bank;
+    uint32_t limit;
+    if (pc < 0x2000) {
+        source = BLOCK_SOURCE_RAM;
+        bank = 0;
+        limit = 0x2000;
+    } else if (pc >= 0x8000) {
+        if (cache->windows_dirty) {
+            refresh_prg_windows(cache, bus);
+        }
+        source = BLOCK_SOURCE_PRG;
+        bank = cache->prg_window[(pc >> 13) & 0x03];
+        limit = (pc | 0x1FFF) + 1;
+        if (bank == UINT32_MAX) {
+            return NULL;
+        }
+    } else {
+        // PPU/APU/IO registers and cartridge RAM, not worth caching
+        return NULL;
+    }
+
+    Block* block = &cache->blocks[(pc ^ (pc >> 11)) & (BLOCK_CACHE_SIZE - 1)];
+    if (block->count == 0 || block->pc != pc || block->source != source || block->bank != bank ||
+        block->generation != cache->generation[source]) {
+        decode_block(cache, bus, block, pc, source, bank, limit);
+        if (block->count == 0) {
+            return NULL;
+        }
+    }
+    return block;
+}
+
+const DecodedOp* block_cache_lookup(BlockCache* cache, Bus* bus, uint16_t pc) {
+    Block* block = block_cache_block(cache, bus, pc);
+    return block ? &block->ops[0] : NULL;
+}
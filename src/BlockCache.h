@@ -0,0 +1,84 @@
+// BlockCache.h
+// Nintendo Entertainment System CPU Decoded Block Cache (Header File)
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Forward declarations to avoid circular dependencies
+typedef struct Cpu Cpu;
+typedef struct Bus Bus;
+
+/*///////BLOCK CACHE///////////////////////////////////////////////////////////////////////////////////
+
+Straight-line 6502 code is decoded once into 'blocks' of 'DecodedOp's, each holding the handler for its
+opcode and its operand bytes already read (branch targets already computed). The CPU then runs a block
+one instruction at a time without going through the bus/cartridge/mapper to fetch any instruction bytes.
+
+    Blocks end at any jump, call, return, branch or BRK, or at the end of an 8KB window.
+    Blocks are keyed by their start PC and where the code came from:
+        PRG  - $8000-$FFFF, tagged with the PRG offset the PC's 8KB window is mapped to (the active bank)
+        RAM  - $0000-$1FFF (code copied into system RAM)
+    Code anywhere else ($2000-$7FFF) is never cached and runs through the normal opcode fetch.
+
+    Any write the cartridge accepts (mapper registers, or PRG memory itself) drops every PRG block and
+    re-reads the bank mapping, and any write to a RAM page holding decoded code drops every RAM block.
+
+///////////////////////////////////////////////////////////////////////////////////////////////////*/
+
+#define BLOCK_CACHE_SIZE    2048    // Blocks, direct-mapped by start PC
+#define BLOCK_MAX_OPS       8       // Instructions per block
+#define BLOCK_END           0x10000 // 'pc' of the entry after a block's last op (never matches a real PC)
+
+typedef enum BlockSource {
+    BLOCK_SOURCE_PRG,
+    BLOCK_SOURCE_RAM,
+    BLOCK_SOURCE_COUNT
+} BlockSource;
+
+// Decoded instruction handler (operand already fetched, PC already past the instruction)
+typedef void (*DecodedHandler)(Cpu* cpu, uint16_t operand);
+
+typedef struct DecodedOp {
+    DecodedHandler handler;
+    uint32_t pc;        // Address of the opcode (BLOCK_END past the last op of a block)
+    uint16_t next_pc;   // Address of the following instruction
+    uint16_t operand;   // See 'fetch_operand' in CPU.c
+} DecodedOp;
+
+typedef struct Block {
+    uint16_t pc;            // Start address
+    uint8_t source;         // BlockSource
+    uint8_t count;          // Decoded ops, 0 if the slot is empty
+    uint32_t bank;          // PRG offset of the start PC's 8KB window (0 for RAM)
+    uint32_t generation;    // Valid while equal to the cache's generation for 'source'
+#ifdef CPU_JIT
+    uint8_t jit_state;      // JIT_NONE/JIT_COMPILED/JIT_REJECTED (see Jit.h)
+    uint8_t max_cycles;     // Most CPU cycles the compiled block can take
+    uint16_t hits;          // Entries since it was decoded
+    void (*native)(Cpu* cpu);
+#endif
+    DecodedOp ops[BLOCK_MAX_OPS + 1];
+} Block;
+
+typedef struct BlockCache {
+    const DecodedOp* next;                      // Next op if execution carries straight on, else NULL
+    uint32_t generation[BLOCK_SOURCE_COUNT];    // Bumped to drop every block from a source
+    uint32_t prg_window[4];                     // PRG offset for $8000/$A000/$C000/$E000 (UINT32_MAX if unmapped)
+    bool windows_dirty;                         // Re-read 'prg_window' from the mapper before the next lookup
+    uint8_t ram_code[8];                        // 256-byte RAM pages with decoded code in them
+
+    Block blocks[BLOCK_CACHE_SIZE];
+} BlockCache;
+
+// Function to initialise the block cache
+BlockCache* init_block_cache();
+
+// Functions to find (decoding if needed) the block starting at 'pc', NULL if code at 'pc' can't be cached
+Block* block_cache_block(BlockCache* cache, Bus* bus, uint16_t pc);
+const DecodedOp* block_cache_lookup(BlockCache* cache, Bus* bus, uint16_t pc);
+
+// Functions to drop decoded code when what it was decoded from may have changed
+void block_cache_flush(BlockCache* cache);
+void block_cache_invalidate_prg(BlockCache* cache);
+void block_cache_invalidate_ram(BlockCache* cache);
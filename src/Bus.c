@@ -4,6 +4,9 @@
 #include "Bus.h"
 #include "PPU.h"
 #include "Cartridge.h"
+#include "BlockCache.h"
+#include "Interrupts.h"
+#include "Input.h"
 
 
 Bus* init_bus() {
@@ -21,6 +24,11 @@ Bus* init_bus() {
     // Initialize PPU and Cartridge pointer to NULL
     bus->ppu = NULL;
     bus->cart = NULL;
+    bus->block_cache = NULL;
+    bus->interrupts = init_interrupts();
+    bus->input = init_input();
+    memset(bus->controller_state, 0, sizeof(bus->controller_state));
+    bus->cart_writes = 0;
 
     bus->dma_page = 0x00;
 	bus->dma_addr = 0x00;
@@ -28,70 +36,251 @@ Bus* init_bus() {
     bus->dma_dummy = true;
 	bus->dma_transfer = true;
 
+    // No cartridge yet, just RAM and the registers
+    bus_attach_cartridge(bus, NULL);
+
     return bus;
 }
 
-// Bus write (Write data to an in-range address on the bus, 'writes' the data to the 'address')
-void bus_write(Bus* bus, uint16_t address, uint8_t data) {
-    if (cartridge_cpu_write(bus->cart, address, data)) {
-        // This allows the Cartridge the opportunity to write to the CPU/Main memory if it wants...
+void free_bus(Bus* bus) {
+    free(bus->interrupts);
+    free(bus->input);
+    free(bus);
+}
+
+// PAGE HANDLERS (everything but RAM and directly mapped PRG)
 
-    } else if (address >= 0x0000 && address <= 0x1FFF) {
-        // MAIN MEMORY (Mirrored every 0x0800 bytes)
-        bus->main_memory[address & 0x07FF] = data;
+// PPU Registers (Mirrored every 8 bytes)
+static uint8_t read_ppu(Bus* bus, uint16_t address) {
+    return cpu_ppu_read(bus->ppu, address & 0x0007);
+}
+
+static void write_ppu(Bus* bus, uint16_t address, uint8_t data) {
+    cpu_ppu_write(bus->ppu, address & 0x0007, data);
+}
 
-    } else if (address >= 0x2000 && address <= 0x3FFF) {
-        // PPU Registers (Mirrored every 8 bytes)
-        cpu_ppu_write(bus->ppu, address & 0x0007, data);
+// APU/IO registers (0x4000 - 0x401F), the rest of the page is expansion ROM
+static uint8_t read_io(Bus* bus, uint16_t address) {
+    uint8_t data = 0x00;
+    if (address >= 0x4016 && address <= 0x4017) {
+        // Controller(s)
+        data = (bus->controller_state[address & 0x0001] & 0x80) > 0;
+        bus->controller_state[address & 0x0001] <<= 1;
+
+    } else if (address >= 0x4020) {
+        // Expansion ROM (Not implemented)
+        printf("[BUS] Expansion ROM not implemented.\n");
+    }
+    return data;
+}
 
-    } else if (address == 0x4014) {
+static void write_io(Bus* bus, uint16_t address, uint8_t data) {
+    if (address == 0x4014) {
         bus->dma_page = data;
 		bus->dma_addr = 0x00;
 		bus->dma_transfer = true;
 
-    } else if (address >= 0x4016 && address <= 0x4017) {
-        // Controller(s)
-        bus->controller_state[address & 0x0001] = bus->controller[address & 0x0001];
+    } else if (address == 0x4016) {
+        // Controller strobe, latches both ports ($4017 writes belong to the APU)
+        long long dot = bus->ppu ? bus->ppu->dot_count : 0;
+        bus->controller_state[0] = input_latch(bus->input, 0, dot);
+        bus->controller_state[1] = input_latch(bus->input, 1, dot);
 
-    } else if (address >= 0x4020 && address <= 0x5FFF) {
+    } else if (address >= 0x4020) {
         // Expansion ROM (Not implemented)
         printf("[BUS] Expansion ROM not implemented.\n");
+    }
+}
+
+// Expansion ROM (Not implemented)
+static uint8_t read_expansion(Bus* bus, uint16_t address) {
+    printf("[BUS] Expansion ROM not implemented.\n");
+    return 0x00;
+}
+
+static void write_expansion(Bus* bus, uint16_t address, uint8_t data) {
+    printf("[BUS] Expansion ROM not implemented.\n");
+}
+
+// Undefined addresses, reads give 0 and writes are ignored
+static uint8_t read_open(Bus* bus, uint16_t address) {
+    return 0x00;
+}
 
-    } else {
-        // Write to undefined address, ignore
-        //printf("[BUS] Detected write to undefined address on bus: 0x%04X\n", address);
+static void write_open(Bus* bus, uint16_t address, uint8_t data) {
+}
+
+// What a page (0x2000 and up) is when the cartridge doesn't want the access
+static BusReadHandler system_read_handler(uint16_t address) {
+    if (address <= 0x3FFF) {
+        return read_ppu;
+    } else if (address <= 0x40FF) {
+        return read_io;
+    } else if (address <= 0x5FFF) {
+        return read_expansion;
     }
+    return read_open;
 }
 
-// Bus read (Read data from an in-range address on the bus, returns the data)
-uint8_t bus_read(Bus* bus, uint16_t address) {
+static BusWriteHandler system_write_handler(uint16_t address) {
+    if (address <= 0x3FFF) {
+        return write_ppu;
+    } else if (address <= 0x40FF) {
+        return write_io;
+    } else if (address <= 0x5FFF) {
+        return write_expansion;
+    }
+    return write_open;
+}
+
+// Pages the cartridge claims (some of): it gets the first say, as it always has
+static uint8_t read_cartridge(Bus* bus, uint16_t address) {
+    // This allows the Cartridge the opportunity to read from the CPU/Main memory if it wants...
     uint8_t data = 0x00;
     if (cartridge_cpu_read(bus->cart, address, &data)) {
-        // This allows the Cartridge the opportunity to read from the CPU/Main memory if it wants...
-        // We then return the read data after the if/else checks.
+        return data;
+    }
+    return system_read_handler(address)(bus, address);
+}
 
-    } else if (address >= 0x0000 && address <= 0x1FFF) {
-        // MAIN MEMORY (Mirrored every 0x0800 bytes)
-        return bus->main_memory[address & 0x07FF];
+static void map_prg(Bus* bus);
 
-    } else if (address >= 0x2000 && address <= 0x3FFF) {
-        // PPU Registers (Mirrored every 8 bytes)
-        return cpu_ppu_read(bus->ppu, address & 0x0007);
+static void write_cartridge(Bus* bus, uint16_t address, uint8_t data) {
+    if (cartridge_cpu_write(bus->cart, address, data)) {
+        // This allows the Cartridge the opportunity to write to the CPU/Main memory if it wants...
+        // Either a mapper register (bank switch) or PRG memory itself has changed, so decoded PRG code is stale
+        bus->cart_writes++;
+        if (bus->block_cache) {
+            block_cache_invalidate_prg(bus->block_cache);
+        }
+        map_prg(bus);
+        if (bus->ppu) {
+            ppu_map_memory(bus->ppu);
+        }
+        return;
+    }
+    system_write_handler(address)(bus, address, data);
+}
 
-    } else if (address >= 0x4016 && address <= 0x4017) {
-        // Controller(s)
-        data = (bus->controller_state[address & 0x0001] & 0x80) > 0;
-        bus->controller_state[address & 0x0001] <<= 1;
+// PAGE TABLES
 
-    } else if (address >= 0x4020 && address <= 0x5FFF) {
-        // Expansion ROM (Not implemented)
-        printf("[BUS] Expansion ROM not implemented.\n");
+// Does the mapper take any access (read or write) in this page? Only asked when a cartridge is attached
+static bool cartridge_claims_page(Cartridge* cart, uint16_t page) {
+    Mapper* mapper = cart->mapper;
+    if (!mapper->mapper_cpu_claims) {
+        return false;
+    }
+    for (uint32_t address = page << 8; address < ((page + 1) << 8); address++) {
+        if (mapper->mapper_cpu_claims(mapper, address)) {
+            return true;
+        }
+    }
+    return false;
+}
 
-    } else {
-        // Read from undefined address, ignore
-        //printf("[BUS] Detected attempted read from undefined address on bus: 0x%04X\n", address);
+// Look up the PRG memory behind 0x6000 - 0xFFFF again (whole 8KB windows, or page by page if a window is split)
+static void map_prg(Bus* bus) {
+    for (uint32_t window = 0x6000; window <= 0xE000; window += 0x2000) {
+        const uint8_t* bank = cartridge_cpu_bank(bus->cart, window);
+        for (uint32_t page = window >> 8; page < (window + 0x2000) >> 8; page++) {
+            if (bus->read_handler[page] != read_cartridge) {
+                continue;
+            }
+            bus->read_page[page] = bank ? bank + ((page << 8) - window) : cartridge_cpu_page(bus->cart, page << 8);
+        }
     }
+}
 
-    // Return any fetched data, whether it be important or not, if not already returned.
-    return data;
+void bus_attach_cartridge(Bus* bus, Cartridge* cart) {
+    bus->cart = cart;
+    bus->cart_writes++;
+    if (bus->block_cache) {
+        block_cache_flush(bus->block_cache);
+    }
+
+    for (uint32_t page = 0; page < BUS_PAGES; page++) {
+        uint16_t address = page << 8;
+        if (address <= 0x1FFF) {
+            // MAIN MEMORY (Mirrored every 0x0800 bytes)
+            bus->read_page[page] = &bus->main_memory[address & 0x0700];
+            bus->write_page[page] = &bus->main_memory[address & 0x0700];
+            bus->read_handler[page] = read_open;
+            bus->write_handler[page] = write_open;
+        } else if (cart && cartridge_claims_page(cart, page)) {
+            bus->read_page[page] = NULL;
+            bus->write_page[page] = NULL;
+            bus->read_handler[page] = read_cartridge;
+            bus->write_handler[page] = write_cartridge;
+        } else {
+            bus->read_page[page] = NULL;
+            bus->write_page[page] = NULL;
+            bus->read_handler[page] = system_read_handler(address);
+            bus->write_handler[page] = system_write_handler(address);
+        }
+    }
+    if (cart) {
+        map_prg(bus);
+    }
+}
+
+// Bus write (Write data to an in-range address on the bus, 'writes' the data to the 'address')
+void bus_write(Bus* bus, uint16_t address, uint8_t data) {
+    uint8_t* page = bus->write_page[address >> 8];
+    if (page) {
+        // MAIN MEMORY (the only memory written directly)
+        page[address & 0x00FF] = data;
+        if (bus->block_cache && bus->block_cache->ram_code[(address & 0x07FF) >> 8]) {
+            block_cache_invalidate_ram(bus->block_cache);
+        }
+        return;
+    }
+    bus->write_handler[address >> 8](bus, address, data);
+}
+
+// Bus read (Read data from an in-range address on the bus, returns the data)
+uint8_t bus_read(Bus* bus, uint16_t address) {
+    const uint8_t* page = bus->read_page[address >> 8];
+    if (page) {
+        return page[address & 0x00FF];
+    }
+    return bus->read_handler[address >> 8](bus, address);
+}
+
+// OAM DMA from memory: the PPU still runs dot by dot, but the copy only has to be brought up to date before the
+// dots that read OAM (sprite evaluation), as nothing else can look at it or change the source while the CPU waits
+int bus_oam_dma(Bus* bus, bool odd_cycle) {
+    const uint8_t* source = bus->read_page[bus->dma_page];
+    if (!source) {
+        return 0;
+    }
+
+    // Wait cycles, then a read and a write per byte: byte k is written after the first dot of CPU cycle
+    // 'wait + 2k + 1' of the transfer
+    Ppu* ppu = bus->ppu;
+    int wait = odd_cycle ? 2 : 1;
+    int cycles = wait + 512;
+    int copied = 0;
+    for (int dot = 1; dot <= 3 * (cycles - 1); dot++) {
+        if (ppu->cycle == 257 && ppu->scanline >= 0) {
+            int written = ((dot - 1) / 3) - wait - 1;
+            written = (written < 0) ? 0 : (written / 2) + 1;
+            memcpy(&ppu->p_oam[copied], &source[copied], written - copied);
+            copied = written;
+            ppu->oam_dirty = true;
+        }
+        ppu_clock(ppu);
+    }
+    memcpy(&ppu->p_oam[copied], &source[copied], 256 - copied);
+    ppu->oam_dirty = true;
+
+    bus->dma_data = source[0xFF];
+    bus->dma_addr = 0x00;
+    bus->dma_dummy = true;
+    bus->dma_transfer = false;
+    return cycles;
+}
+
+// Direct pointer to a page of code (the same memory 'bus_read' reads from)
+const uint8_t* bus_code_page(Bus* bus, uint16_t address) {
+    return bus->read_page[address >> 8];
 }
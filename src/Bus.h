@@ -12,37 +12,85 @@
 // Forward declaration to avoid circular dependencies
 typedef struct Ppu Ppu;
 typedef struct Cartridge Cartridge;
+typedef struct BlockCache BlockCache;
+typedef struct Interrupts Interrupts;
+typedef struct Input Input;
 
 /*///////BUS STRUCTURE/////////////////////////////////////////////////////////////////////////////////
 
 BUS - 0x0000 - 0xFFFF
     RAM RANGE - 0x0000 - 0x1FFF
                 Mirrored: 0x000 - 0x07FF | 0x800 - 0x0FFF | 0x1000 - 0x17FF | 0x1800 - 0x1FFF
+                Always system RAM, the cartridge only gets a say from 0x4020 up
+                (so the CPU reads/writes zero page and the stack, 0x0000 - 0x01FF, straight from 'main_memory')
     ROM RANGE - 0x4020 - 0xFFFF
 
+PAGE TABLES - One entry per 256-byte page, for reads and for writes, so an access is a single lookup
+    Read  - The memory behind the page (RAM, or PRG the mapper maps the whole page to contiguously),
+            otherwise a handler (PPU registers, I/O, expansion, or the cartridge first and then those)
+    Write - Only system RAM is written directly, everything else goes to a handler
+    Which pages the cartridge claims at all is worked out once when it is attached ('bus_attach_cartridge'),
+    the memory behind 0x6000 - 0xFFFF is looked up again whenever the cartridge accepts a write (bank switch)
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////*/
 
+#define BUS_RAM_SIZE 0x0800     // System RAM, mirrored up to 0x1FFF
+#define BUS_PAGES    0x100      // 256-byte pages in the page tables
+
+typedef struct Bus Bus;
+
+// Page table handlers, for pages without memory behind them
+typedef uint8_t (*BusReadHandler)(Bus* bus, uint16_t address);
+typedef void (*BusWriteHandler)(Bus* bus, uint16_t address, uint8_t data);
+
 // Define the Bus structure
-typedef struct Bus {
-    uint8_t main_memory[2048];            // System RAM ('CPU memory')
+struct Bus {
+    uint8_t main_memory[BUS_RAM_SIZE];    // System RAM ('CPU memory')
     Ppu* ppu;                             // Reference to PPU
     Cartridge* cart;                      // Reference to Cartridge
+    BlockCache* block_cache;              // Reference to the CPU's decoded code, invalidated by writes (may be NULL)
+    Interrupts* interrupts;               // NMI/IRQ lines into the CPU (see Interrupts.h)
+    Input* input;                         // What is held on the controller ports (see Input.h)
+    uint32_t cart_writes;                 // Writes the cartridge has accepted (bank switches/PRG writes), see 'bus_code_page'
+
+    // Page tables (see above), indexed by 'address >> 8'
+    const uint8_t* read_page[BUS_PAGES];        // Memory behind the page, NULL: 'read_handler'
+    BusReadHandler read_handler[BUS_PAGES];
+    uint8_t* write_page[BUS_PAGES];             // System RAM behind the page, NULL: 'write_handler'
+    BusWriteHandler write_handler[BUS_PAGES];
 
-    uint8_t controller[2];
-    uint8_t controller_state[2];
+    uint8_t controller_state[2];          // Controller shift registers, loaded from 'input' by a $4016 strobe
 
     uint8_t dma_page;
 	uint8_t dma_addr;
 	uint8_t dma_data;
     bool dma_dummy;
     bool dma_transfer;
-} Bus;
+};
 
 // Function to initialize the bus
 Bus* init_bus();
 
+// Function to free the bus (and its interrupt lines and controller input, the cartridge and block cache aren't its own)
+void free_bus(Bus* bus);
+
+// Function to plug a cartridge into the bus (NULL to take it out), rebuilding the page tables
+void bus_attach_cartridge(Bus* bus, Cartridge* cart);
+
 // Function to write data to the main bus
 void bus_write(Bus* bus, uint16_t address, uint8_t data);
 
 // Function to read data from the main bus
 uint8_t bus_read(Bus* bus, uint16_t address);
+
+// Function to run a whole OAM DMA transfer ($4014) in one go, if its source page is plain memory ('read_page')
+// Call on the transfer's first CPU cycle, just after that cycle's first PPU dot ('odd_cycle': the cycle is odd, so
+// the CPU waits two cycles rather than one before the copy starts). Clocks the PPU up to and including the first dot
+// of the transfer's last CPU cycle and returns the CPU cycles the transfer takes (513/514), or 0 if the source page
+// has side effects and the transfer has to be stepped a cycle at a time instead
+int bus_oam_dma(Bus* bus, bool odd_cycle);
+
+// Function to get the memory behind the 256-byte page holding 'address' for instruction fetches,
+// NULL if reads there have to go through 'bus_read' (registers, unmapped or split pages)
+// NOTE: Only valid until 'cart_writes' changes
+const uint8_t* bus_code_page(Bus* bus, uint16_t address);
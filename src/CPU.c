@@ -8,472 +8,529 @@
 
 #include "CPU.h"
 #include "Bus.h"
+#include "Cartridge.h"
 #include <stdlib.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
 
+// Handlers below are written once per instruction, taking the addressing mode as a parameter.
+// Forcing them inline into each per-opcode handler lets the compiler fold the mode away entirely.
+#if defined(__GNUC__) || defined(__clang__)
+#define CPU_INLINE static inline __attribute__((always_inline))
+#else
+#define CPU_INLINE static inline
+#endif
+
+
+// Opcode list, one entry per defined opcode: X(opcode, instruction, addressing mode, cycles, page-cross penalty)
+// This is the only place opcodes are described, it is expanded below into 'opcode_table' and into the
+// per-opcode handlers used by the dispatcher. Instruction lengths come from CPU_ADDRESSING_MODES.
+// Opcodes not listed here behave as a 1 byte, 2 cycle NOP with IMP addressing.
+#define CPU_OPCODES(X) \
+    /* Load/Store Operations */ \
+    X(0xA9, LDA,   IMM, 2, 0) \
+    X(0xA5, LDA,   ZP0, 3, 0) \
+    X(0xAD, LDA,   ABS, 4, 0) \
+    X(0xB5, LDA,   ZPX, 4, 0) \
+    X(0xBD, LDA,   ABX, 4, 1) \
+    X(0xB9, LDA,   ABY, 4, 1) \
+    X(0xA1, LDA,   IZX, 6, 0) \
+    X(0xB1, LDA,   IZY, 5, 0) \
+ \
+    X(0xA2, LDX,   IMM, 2, 0) \
+    X(0xA6, LDX,   ZP0, 3, 0) \
+    X(0xAE, LDX,   ABS, 4, 0) \
+    X(0xB6, LDX,   ZPY, 4, 0) \
+    X(0xBE, LDX,   ABY, 4, 1) \
+ \
+    X(0xA0, LDY,   IMM, 2, 0) \
+    X(0xA4, LDY,   ZP0, 3, 0) \
+    X(0xAC, LDY,   ABS, 4, 0) \
+    X(0xB4, LDY,   ZPX, 4, 0) \
+    X(0xBC, LDY,   ABX, 4, 1) \
+ \
+    X(0x85, STA,   ZP0, 3, 0) \
+    X(0x8D, STA,   ABS, 4, 0) \
+    X(0x95, STA,   ZPX, 4, 0) \
+    X(0x9D, STA,   ABX, 5, 0) \
+    X(0x99, STA,   ABY, 5, 0) \
+    X(0x81, STA,   IZX, 6, 0) \
+    X(0x91, STA,   IZY, 6, 0) \
+ \
+    X(0x86, STX,   ZP0, 3, 0) \
+    X(0x8E, STX,   ABS, 4, 0) \
+    X(0x96, STX,   ZPY, 4, 0) \
+ \
+    X(0x84, STY,   ZP0, 3, 0) \
+    X(0x8C, STY,   ABS, 4, 0) \
+    X(0x94, STY,   ZPX, 4, 0) \
+ \
+    /* Register Transfers */ \
+    X(0xAA, TAX,   IMP, 2, 0) \
+    X(0xA8, TAY,   IMP, 2, 0) \
+    X(0x8A, TXA,   IMP, 2, 0) \
+    X(0x98, TYA,   IMP, 2, 0) \
+ \
+    /* Stack Operations */ \
+    X(0xBA, TSX,   IMP, 2, 0) \
+    X(0x9A, TXS,   IMP, 2, 0) \
+    X(0x48, PHA,   IMP, 3, 0) \
+    X(0x08, PHP,   IMP, 3, 0) \
+    X(0x68, PLA,   IMP, 4, 0) \
+    X(0x28, PLP,   IMP, 4, 0) \
+ \
+    /* Logical Instructions */ \
+    X(0x29, AND,   IMM, 2, 0) \
+    X(0x25, AND,   ZP0, 3, 0) \
+    X(0x2D, AND,   ABS, 4, 0) \
+    X(0x35, AND,   ZPX, 4, 0) \
+    X(0x3D, AND,   ABX, 4, 1) \
+    X(0x39, AND,   ABY, 4, 1) \
+    X(0x21, AND,   IZX, 6, 0) \
+    X(0x31, AND,   IZY, 5, 0) \
+ \
+    X(0x49, EOR,   IMM, 2, 0) \
+    X(0x45, EOR,   ZP0, 3, 0) \
+    X(0x4D, EOR,   ABS, 4, 0) \
+    X(0x55, EOR,   ZPX, 4, 0) \
+    X(0x5D, EOR,   ABX, 4, 1) \
+    X(0x59, EOR,   ABY, 4, 1) \
+    X(0x41, EOR,   IZX, 6, 0) \
+    X(0x51, EOR,   IZY, 5, 0) \
+ \
+    X(0x09, ORA,   IMM, 2, 0) \
+    X(0x05, ORA,   ZP0, 3, 0) \
+    X(0x0D, ORA,   ABS, 4, 0) \
+    X(0x15, ORA,   ZPX, 4, 0) \
+    X(0x1D, ORA,   ABX, 4, 1) \
+    X(0x19, ORA,   ABY, 4, 1) \
+    X(0x01, ORA,   IZX, 6, 0) \
+    X(0x11, ORA,   IZY, 5, 0) \
+ \
+    X(0x24, BIT,   ZP0, 3, 0) \
+    X(0x2C, BIT,   ABS, 4, 0) \
+ \
+    /* Arithmetic Instructions */ \
+    X(0x69, ADC,   IMM, 2, 0) \
+    X(0x65, ADC,   ZP0, 3, 0) \
+    X(0x6D, ADC,   ABS, 4, 0) \
+    X(0x75, ADC,   ZPX, 4, 0) \
+    X(0x7D, ADC,   ABX, 4, 1) \
+    X(0x79, ADC,   ABY, 4, 1) \
+    X(0x61, ADC,   IZX, 6, 0) \
+    X(0x71, ADC,   IZY, 5, 0) \
+ \
+    X(0xE9, SBC,   IMM, 2, 0) \
+    X(0xE5, SBC,   ZP0, 3, 0) \
+    X(0xED, SBC,   ABS, 4, 0) \
+    X(0xF5, SBC,   ZPX, 4, 0) \
+    X(0xFD, SBC,   ABX, 4, 1) \
+    X(0xF9, SBC,   ABY, 4, 1) \
+    X(0xE1, SBC,   IZX, 6, 0) \
+    X(0xF1, SBC,   IZY, 5, 0) \
+ \
+    X(0xC9, CMP,   IMM, 2, 0) \
+    X(0xC5, CMP,   ZP0, 3, 0) \
+    X(0xCD, CMP,   ABS, 4, 0) \
+    X(0xD5, CMP,   ZPX, 4, 0) \
+    X(0xDD, CMP,   ABX, 4, 1) \
+    X(0xD9, CMP,   ABY, 4, 1) \
+    X(0xC1, CMP,   IZX, 6, 0) \
+    X(0xD1, CMP,   IZY, 5, 0) \
+ \
+    X(0xE0, CPX,   IMM, 2, 0) \
+    X(0xE4, CPX,   ZP0, 3, 0) \
+    X(0xEC, CPX,   ABS, 4, 0) \
+ \
+    X(0xC0, CPY,   IMM, 2, 0) \
+    X(0xC4, CPY,   ZP0, 3, 0) \
+    X(0xCC, CPY,   ABS, 4, 0) \
+ \
+    /* Increments & Decrements */ \
+    X(0xE6, INC,   ZP0, 5, 0) \
+    X(0xEE, INC,   ABS, 6, 0) \
+    X(0xF6, INC,   ZPX, 6, 0) \
+    X(0xFE, INC,   ABX, 7, 1) \
+ \
+    X(0xE8, INX,   IMP, 2, 0) \
+    X(0xC8, INY,   IMP, 2, 0) \
+ \
+    X(0xC6, DEC,   ZP0, 5, 0) \
+    X(0xCE, DEC,   ABS, 6, 0) \
+    X(0xD6, DEC,   ZPX, 6, 0) \
+    X(0xDE, DEC,   ABX, 7, 1) \
+ \
+    X(0xCA, DEX,   IMP, 2, 0) \
+    X(0x88, DEY,   IMP, 2, 0) \
+ \
+    /* Shifts */ \
+    X(0x0A, ASL,   ACC, 2, 0) \
+    X(0x06, ASL,   ZP0, 5, 0) \
+    X(0x0E, ASL,   ABS, 6, 0) \
+    X(0x16, ASL,   ZPX, 6, 0) \
+    X(0x1E, ASL,   ABX, 7, 0) \
+ \
+    X(0x4A, LSR,   ACC, 2, 0) \
+    X(0x46, LSR,   ZP0, 5, 0) \
+    X(0x4E, LSR,   ABS, 6, 0) \
+    X(0x56, LSR,   ZPX, 6, 0) \
+    X(0x5E, LSR,   ABX, 7, 0) \
+ \
+    X(0x2A, ROL,   ACC, 2, 0) \
+    X(0x26, ROL,   ZP0, 5, 0) \
+    X(0x2E, ROL,   ABS, 6, 0) \
+    X(0x36, ROL,   ZPX, 6, 0) \
+    X(0x3E, ROL,   ABX, 7, 0) \
+ \
+    X(0x6A, ROR,   ACC, 2, 0) \
+    X(0x66, ROR,   ZP0, 5, 0) \
+    X(0x6E, ROR,   ABS, 6, 0) \
+    X(0x76, ROR,   ZPX, 6, 0) \
+    X(0x7E, ROR,   ABX, 7, 0) \
+ \
+    /* Jumps & Calls */ \
+    X(0x4C, JMP,   ABS, 3, 0) \
+    X(0x6C, JMP,   IND, 5, 0) /* Note: 6502 JMP indirect bug not handled here */ \
+    X(0x20, JSR,   ABS, 6, 0) \
+    X(0x60, RTS,   IMP, 6, 0) \
+ \
+    /* Branches */ \
+    X(0x90, BCC,   REL, 2, 0) \
+    X(0xB0, BCS,   REL, 2, 0) \
+    X(0xF0, BEQ,   REL, 2, 0) \
+    X(0x30, BMI,   REL, 2, 0) \
+    X(0xD0, BNE,   REL, 2, 0) \
+    X(0x10, BPL,   REL, 2, 0) \
+    X(0x50, BVC,   REL, 2, 0) \
+    X(0x70, BVS,   REL, 2, 0) \
+ \
+    /* Status Flag Changes */ \
+    X(0x18, CLC,   IMP, 2, 0) \
+    X(0xD8, CLD,   IMP, 2, 0) \
+    X(0x58, CLI,   IMP, 2, 0) \
+    X(0xB8, CLV,   IMP, 2, 0) \
+    X(0x38, SEC,   IMP, 2, 0) \
+    X(0xF8, SED,   IMP, 2, 0) \
+    X(0x78, SEI,   IMP, 2, 0) \
+ \
+    /* System Functions */ \
+    X(0x00, BRK,   IMP, 7, 0) \
+    X(0xEA, NOP,   IMP, 2, 0) \
+    X(0x40, RTI,   IMP, 6, 0) \
+ \
+    /* LAX (Load A and X simultaneously) */ \
+    X(0xA7, LAX,   ZP0, 3, 0) \
+    X(0xB7, LAX,   ZPY, 4, 0) \
+    X(0xAF, LAX,   ABS, 4, 0) \
+    X(0xBF, LAX,   ABY, 4, 0) \
+    X(0xA3, LAX,   IZX, 6, 0) \
+    X(0xB3, LAX,   IZY, 5, 0) \
+ \
+    /* SAX (Store A & X) */ \
+    X(0x87, SAX,   ZP0, 3, 0) \
+    X(0x97, SAX,   ZPY, 4, 0) \
+    X(0x8F, SAX,   ABS, 4, 0) \
+    X(0x83, SAX,   IZX, 6, 0) \
+ \
+    /* DCP (DEC + CMP) */ \
+    X(0xC7, DCP,   ZP0, 5, 0) \
+    X(0xD7, DCP,   ZPX, 6, 0) \
+    X(0xCF, DCP,   ABS, 6, 0) \
+    X(0xDF, DCP,   ABX, 7, 0) \
+    X(0xDB, DCP,   ABY, 7, 0) \
+    X(0xC3, DCP,   IZX, 8, 0) \
+    X(0xD3, DCP,   IZY, 8, 0) \
+ \
+    /* ISB (INC + SBC) */ \
+    X(0xE7, ISB,   ZP0, 5, 0) \
+    X(0xF7, ISB,   ZPX, 6, 0) \
+    X(0xEF, ISB,   ABS, 6, 0) \
+    X(0xFF, ISB,   ABX, 7, 0) \
+    X(0xFB, ISB,   ABY, 7, 0) \
+    X(0xE3, ISB,   IZX, 8, 0) \
+    X(0xF3, ISB,   IZY, 8, 0) \
+ \
+    /* SLO (ASL + ORA) */ \
+    X(0x07, SLO,   ZP0, 5, 0) \
+    X(0x17, SLO,   ZPX, 6, 0) \
+    X(0x0F, SLO,   ABS, 6, 0) \
+    X(0x1F, SLO,   ABX, 7, 0) \
+    X(0x1B, SLO,   ABY, 7, 0) \
+    X(0x03, SLO,   IZX, 8, 0) \
+    X(0x13, SLO,   IZY, 8, 0) \
+ \
+    /* RLA (ROL + AND) */ \
+    X(0x27, RLA,   ZP0, 5, 0) \
+    X(0x37, RLA,   ZPX, 6, 0) \
+    X(0x2F, RLA,   ABS, 6, 0) \
+    X(0x3F, RLA,   ABX, 7, 0) \
+    X(0x3B, RLA,   ABY, 7, 0) \
+    X(0x23, RLA,   IZX, 8, 0) \
+    X(0x33, RLA,   IZY, 8, 0) \
+ \
+    /* SRE (LSR + EOR) */ \
+    X(0x47, SRE,   ZP0, 5, 0) \
+    X(0x57, SRE,   ZPX, 6, 0) \
+    X(0x4F, SRE,   ABS, 6, 0) \
+    X(0x5F, SRE,   ABX, 7, 0) \
+    X(0x5B, SRE,   ABY, 7, 0) \
+    X(0x43, SRE,   IZX, 8, 0) \
+    X(0x53, SRE,   IZY, 8, 0) \
+ \
+    /* RRA (ROR + ADC) */ \
+    X(0x67, RRA,   ZP0, 5, 0) \
+    X(0x77, RRA,   ZPX, 6, 0) \
+    X(0x6F, RRA,   ABS, 6, 0) \
+    X(0x7F, RRA,   ABX, 7, 0) \
+    X(0x7B, RRA,   ABY, 7, 0) \
+    X(0x63, RRA,   IZX, 8, 0) \
+    X(0x73, RRA,   IZY, 8, 0) \
+ \
+    /* SBC (0xEB) - alternate immediate SBC */ \
+    X(0xEB, SBC_EB, IMM, 2, 0)
+
+// Operand bytes for each addressing mode as constants (IMM_OPERAND_BYTES, ZP0_OPERAND_BYTES, ...)
+enum {
+#define X(name, operand_bytes) name##_OPERAND_BYTES = operand_bytes,
+    CPU_ADDRESSING_MODES(X)
+#undef X
+};
 
 // Define the opcode_table
 const Opcode opcode_table[256] = {
     // Initialize all 256 opcodes
     // For simplicity, initialize unspecified opcodes as NOP with IMP addressing
-    [0 ... 255] = {NOP, IMP, 1, 2},
+    [0 ... 255] = {NOP, IMP, 1, 2, false},
 
     // Define specific opcodes as per the 6502 instruction set
-    // Load/Store Operations
-    [0xA9] = {LDA, IMM, 2, 2},
-    [0xA5] = {LDA, ZP0, 2, 3},
-    [0xAD] = {LDA, ABS, 3, 4},
-    [0xB5] = {LDA, ZPX, 2, 4},
-    [0xBD] = {LDA, ABX, 3, 4},
-    [0xB9] = {LDA, ABY, 3, 4},
-    [0xA1] = {LDA, IZX, 2, 6},
-    [0xB1] = {LDA, IZY, 2, 5},
-
-    [0xA2] = {LDX, IMM, 2, 2},
-    [0xA6] = {LDX, ZP0, 2, 3},
-    [0xAE] = {LDX, ABS, 3, 4},
-    [0xB6] = {LDX, ZPY, 2, 4},
-    [0xBE] = {LDX, ABY, 3, 4},
-
-    [0xA0] = {LDY, IMM, 2, 2},
-    [0xA4] = {LDY, ZP0, 2, 3},
-    [0xAC] = {LDY, ABS, 3, 4},
-    [0xB4] = {LDY, ZPX, 2, 4},
-    [0xBC] = {LDY, ABX, 3, 4},
-
-    [0x85] = {STA, ZP0, 2, 3},
-    [0x8D] = {STA, ABS, 3, 4},
-    [0x95] = {STA, ZPX, 2, 4},
-    [0x9D] = {STA, ABX, 3, 5},
-    [0x99] = {STA, ABY, 3, 5},
-    [0x81] = {STA, IZX, 2, 6},
-    [0x91] = {STA, IZY, 2, 6},
-
-    [0x86] = {STX, ZP0, 2, 3},
-    [0x8E] = {STX, ABS, 3, 4},
-    [0x96] = {STX, ZPY, 2, 4},
-
-    [0x84] = {STY, ZP0, 2, 3},
-    [0x8C] = {STY, ABS, 3, 4},
-    [0x94] = {STY, ZPX, 2, 4},
-
-    // Register Transfers
-    [0xAA] = {TAX, IMP, 1, 2},
-    [0xA8] = {TAY, IMP, 1, 2},
-    [0x8A] = {TXA, IMP, 1, 2},
-    [0x98] = {TYA, IMP, 1, 2},
-
-    // Stack Operations
-    [0xBA] = {TSX, IMP, 1, 2},
-    [0x9A] = {TXS, IMP, 1, 2},
-    [0x48] = {PHA, IMP, 1, 3},
-    [0x08] = {PHP, IMP, 1, 3},
-    [0x68] = {PLA, IMP, 1, 4},
-    [0x28] = {PLP, IMP, 1, 4},
-
-    // Logical Instructions
-    [0x29] = {AND, IMM, 2, 2},
-    [0x25] = {AND, ZP0, 2, 3},
-    [0x2D] = {AND, ABS, 3, 4},
-    [0x35] = {AND, ZPX, 2, 4},
-    [0x3D] = {AND, ABX, 3, 4},
-    [0x39] = {AND, ABY, 3, 4},
-    [0x21] = {AND, IZX, 2, 6},
-    [0x31] = {AND, IZY, 2, 5},
-
-    [0x49] = {EOR, IMM, 2, 2},
-    [0x45] = {EOR, ZP0, 2, 3},
-    [0x4D] = {EOR, ABS, 3, 4},
-    [0x55] = {EOR, ZPX, 2, 4},
-    [0x5D] = {EOR, ABX, 3, 4},
-    [0x59] = {EOR, ABY, 3, 4},
-    [0x41] = {EOR, IZX, 2, 6},
-    [0x51] = {EOR, IZY, 2, 5},
-
-    [0x09] = {ORA, IMM, 2, 2},
-    [0x05] = {ORA, ZP0, 2, 3},
-    [0x0D] = {ORA, ABS, 3, 4},
-    [0x15] = {ORA, ZPX, 2, 4},
-    [0x1D] = {ORA, ABX, 3, 4},
-    [0x19] = {ORA, ABY, 3, 4},
-    [0x01] = {ORA, IZX, 2, 6},
-    [0x11] = {ORA, IZY, 2, 5},
-
-    [0x24] = {BIT, ZP0, 2, 3},
-    [0x2C] = {BIT, ABS, 3, 4},
-
-    // Arithmetic Instructions
-    [0x69] = {ADC, IMM, 2, 2},
-    [0x65] = {ADC, ZP0, 2, 3},
-    [0x6D] = {ADC, ABS, 3, 4},
-    [0x75] = {ADC, ZPX, 2, 4},
-    [0x7D] = {ADC, ABX, 3, 4},
-    [0x79] = {ADC, ABY, 3, 4},
-    [0x61] = {ADC, IZX, 2, 6},
-    [0x71] = {ADC, IZY, 2, 5},
-
-    [0xE9] = {SBC, IMM, 2, 2},
-    [0xE5] = {SBC, ZP0, 2, 3},
-    [0xED] = {SBC, ABS, 3, 4},
-    [0xF5] = {SBC, ZPX, 2, 4},
-    [0xFD] = {SBC, ABX, 3, 4},
-    [0xF9] = {SBC, ABY, 3, 4},
-    [0xE1] = {SBC, IZX, 2, 6},
-    [0xF1] = {SBC, IZY, 2, 5},
-
-    [0xC9] = {CMP, IMM, 2, 2},
-    [0xC5] = {CMP, ZP0, 2, 3},
-    [0xCD] = {CMP, ABS, 3, 4},
-    [0xD5] = {CMP, ZPX, 2, 4},
-    [0xDD] = {CMP, ABX, 3, 4},
-    [0xD9] = {CMP, ABY, 3, 4},
-    [0xC1] = {CMP, IZX, 2, 6},
-    [0xD1] = {CMP, IZY, 2, 5},
-
-    [0xE0] = {CPX, IMM, 2, 2},
-    [0xE4] = {CPX, ZP0, 2, 3},
-    [0xEC] = {CPX, ABS, 3, 4},
-
-    [0xC0] = {CPY, IMM, 2, 2},
-    [0xC4] = {CPY, ZP0, 2, 3},
-    [0xCC] = {CPY, ABS, 3, 4},
-
-    // Increments & Decrements
-    [0xE6] = {INC, ZP0, 2, 5},
-    [0xEE] = {INC, ABS, 3, 6},
-    [0xF6] = {INC, ZPX, 2, 6},
-    [0xFE] = {INC, ABX, 3, 7},
-
-    [0xE8] = {INX, IMP, 1, 2},
-    [0xC8] = {INY, IMP, 1, 2},
-
-    [0xC6] = {DEC, ZP0, 2, 5},
-    [0xCE] = {DEC, ABS, 3, 6},
-    [0xD6] = {DEC, ZPX, 2, 6},
-    [0xDE] = {DEC, ABX, 3, 7},
-
-    [0xCA] = {DEX, IMP, 1, 2},
-    [0x88] = {DEY, IMP, 1, 2},
-
-    // Shifts
-    [0x0A] = {ASL, ACC, 1, 2},
-    [0x06] = {ASL, ZP0, 2, 5},
-    [0x0E] = {ASL, ABS, 3, 6},
-    [0x16] = {ASL, ZPX, 2, 6},
-    [0x1E] = {ASL, ABX, 3, 7},
-
-    [0x4A] = {LSR, ACC, 1, 2},
-    [0x46] = {LSR, ZP0, 2, 5},
-    [0x4E] = {LSR, ABS, 3, 6},
-    [0x56] = {LSR, ZPX, 2, 6},
-    [0x5E] = {LSR, ABX, 3, 7},
-
-    [0x2A] = {ROL, ACC, 1, 2},
-    [0x26] = {ROL, ZP0, 2, 5},
-    [0x2E] = {ROL, ABS, 3, 6},
-    [0x36] = {ROL, ZPX, 2, 6},
-    [0x3E] = {ROL, ABX, 3, 7},
-
-    [0x6A] = {ROR, ACC, 1, 2},
-    [0x66] = {ROR, ZP0, 2, 5},
-    [0x6E] = {ROR, ABS, 3, 6},
-    [0x76] = {ROR, ZPX, 2, 6},
-    [0x7E] = {ROR, ABX, 3, 7},
-
-    // Jumps & Calls
-    [0x4C] = {JMP, ABS, 3, 3},
-    [0x6C] = {JMP, IND, 3, 5}, // Note: 6502 JMP indirect bug not handled here
-    [0x20] = {JSR, ABS, 3, 6},
-    [0x60] = {RTS, IMP, 1, 6},
-
-    // Branches
-    [0x90] = {BCC, REL, 2, 2},
-    [0xB0] = {BCS, REL, 2, 2},
-    [0xF0] = {BEQ, REL, 2, 2},
-    [0x30] = {BMI, REL, 2, 2},
-    [0xD0] = {BNE, REL, 2, 2},
-    [0x10] = {BPL, REL, 2, 2},
-    [0x50] = {BVC, REL, 2, 2},
-    [0x70] = {BVS, REL, 2, 2},
-
-    // Status Flag Changes
-    [0x18] = {CLC, IMP, 1, 2},
-    [0xD8] = {CLD, IMP, 1, 2},
-    [0x58] = {CLI, IMP, 1, 2},
-    [0xB8] = {CLV, IMP, 1, 2},
-    [0x38] = {SEC, IMP, 1, 2},
-    [0xF8] = {SED, IMP, 1, 2},
-    [0x78] = {SEI, IMP, 1, 2},
-
-    // System Functions
-    [0x00] = {BRK, IMP, 1, 7},
-    [0xEA] = {NOP, IMP, 1, 2},
-    [0x40] = {RTI, IMP, 1, 6},
-
-    // LAX (Load A and X simultaneously)
-    [0xA7] = { LAX, ZP0, 2, 3 },
-    [0xB7] = { LAX, ZPY, 2, 4 },
-    [0xAF] = { LAX, ABS, 3, 4 },
-    [0xBF] = { LAX, ABY, 3, 4 },  
-    [0xA3] = { LAX, IZX, 2, 6 },
-    [0xB3] = { LAX, IZY, 2, 5 },
-
-    // SAX (Store A & X)
-    [0x87] = { SAX, ZP0, 2, 3 },
-    [0x97] = { SAX, ZPY, 2, 4 },
-    [0x8F] = { SAX, ABS, 3, 4 },
-    [0x83] = { SAX, IZX, 2, 6 },
-
-    // DCP (DEC + CMP)
-    [0xC7] = { DCP, ZP0, 2, 5 },
-    [0xD7] = { DCP, ZPX, 2, 6 },
-    [0xCF] = { DCP, ABS, 3, 6 },
-    [0xDF] = { DCP, ABX, 3, 7 },
-    [0xDB] = { DCP, ABY, 3, 7 },
-    [0xC3] = { DCP, IZX, 2, 8 },
-    [0xD3] = { DCP, IZY, 2, 8 },
-
-    // ISB (INC + SBC)
-    [0xE7] = { ISB, ZP0, 2, 5 },
-    [0xF7] = { ISB, ZPX, 2, 6 },
-    [0xEF] = { ISB, ABS, 3, 6 },
-    [0xFF] = { ISB, ABX, 3, 7 },
-    [0xFB] = { ISB, ABY, 3, 7 },
-    [0xE3] = { ISB, IZX, 2, 8 },
-    [0xF3] = { ISB, IZY, 2, 8 },
-
-    // SLO (ASL + ORA)
-    [0x07] = { SLO, ZP0, 2, 5 },
-    [0x17] = { SLO, ZPX, 2, 6 },
-    [0x0F] = { SLO, ABS, 3, 6 },
-    [0x1F] = { SLO, ABX, 3, 7 },
-    [0x1B] = { SLO, ABY, 3, 7 },
-    [0x03] = { SLO, IZX, 2, 8 },
-    [0x13] = { SLO, IZY, 2, 8 },
-
-    // RLA (ROL + AND)
-    [0x27] = { RLA, ZP0, 2, 5 },
-    [0x37] = { RLA, ZPX, 2, 6 },
-    [0x2F] = { RLA, ABS, 3, 6 },
-    [0x3F] = { RLA, ABX, 3, 7 },
-    [0x3B] = { RLA, ABY, 3, 7 },
-    [0x23] = { RLA, IZX, 2, 8 },
-    [0x33] = { RLA, IZY, 2, 8 },
-
-    // SRE (LSR + EOR)
-    [0x47] = { SRE, ZP0, 2, 5 },
-    [0x57] = { SRE, ZPX, 2, 6 },
-    [0x4F] = { SRE, ABS, 3, 6 },
-    [0x5F] = { SRE, ABX, 3, 7 },
-    [0x5B] = { SRE, ABY, 3, 7 },
-    [0x43] = { SRE, IZX, 2, 8 },
-    [0x53] = { SRE, IZY, 2, 8 },
-
-    // RRA (ROR + ADC)
-    [0x67] = { RRA, ZP0, 2, 5 },
-    [0x77] = { RRA, ZPX, 2, 6 },
-    [0x6F] = { RRA, ABS, 3, 6 },
-    [0x7F] = { RRA, ABX, 3, 7 },
-    [0x7B] = { RRA, ABY, 3, 7 },
-    [0x63] = { RRA, IZX, 2, 8 },
-    [0x73] = { RRA, IZY, 2, 8 },
-
-    // SBC (0xEB) - alternate immediate SBC
-    [0xEB] = { SBC_EB, IMM, 2, 2 },
+#define X(op, instr, mode, cycles, page_penalty) [op] = {instr, mode, 1 + mode##_OPERAND_BYTES, cycles, page_penalty},
+    CPU_OPCODES(X)
+#undef X
 };
 
 // Define mapped 'Instruction' string names
-const char *InstructionStrings[65] = {
-    "LDA",
-    "LDX",
-    "LDY",
-    "STA",
-    "STX",
-    "STY",
-    "TAX",
-    "TAY",
-    "TXA",
-    "TYA",
-    "TSX",
-    "TXS",
-    "PHA",
-    "PHP",
-    "PLA",
-    "PLP",
-    "AND",
-    "EOR",
-    "ORA",
-    "BIT",
-    "ADC",
-    "SBC",
-    "CMP",
-    "CPX",
-    "CPY",
-    "INC",
-    "INX",
-    "INY",
-    "DEC",
-    "DEX",
-    "DEY",
-    "ASL",
-    "LSR",
-    "ROL",
-    "ROR",
-    "JMP",
-    "JSR",
-    "RTS",
-    "BCC",
-    "BCS",
-    "BEQ",
-    "BMI",
-    "BNE",
-    "BPL",
-    "BVC",
-    "BVS",
-    "CLC",
-    "CLD",
-    "CLI",
-    "CLV",
-    "SEC",
-    "SED",
-    "SEI",
-    "BRK",
-    "NOP",
-    "RTI",
-
-    // Illegal opcodes, rarely but sometimes used for NES processing (like 5 games lol)
-    "LAX",
-    "SAX",
-    "DCP",
-    "ISB",
-    "SLO",
-    "RLA",
-    "SRE",
-    "RRA",
-    "SBC_EB"
+const char *InstructionStrings[INSTRUCTION_COUNT] = {
+#define X(name) #name,
+    CPU_INSTRUCTIONS(X)
+#undef X
 };
 
 // Define mapped 'Addressing Modes' string names
-const char *AddressModeStrings[13] = {
-    "IMM",
-    "ZP0",
-    "ABS",
-    "ZPX",
-    "ZPY",
-    "ABX",
-    "ABY",
-    "IZX",
-    "IZY",
-    "ACC",
-    "IMP",
-    "REL",
-    "IND"
+const char *AddressModeStrings[ADDRESSING_MODE_COUNT] = {
+#define X(name, operand_bytes) #name,
+    CPU_ADDRESSING_MODES(X)
+#undef X
 };
 
 
+// Check for page-crossing
+static inline bool page_crossed(uint16_t old_addr, uint16_t new_addr) {
+    return ((old_addr & 0xFF00) != (new_addr & 0xFF00));
+}
+
 // Helper Functions Implementations
-uint8_t fetch_operand(Cpu* cpu, AddressingMode mode, uint16_t* address) {
-    uint8_t value = 0;
+// Read the next instruction byte at PC (a load from the current code page, only asking the bus when PC moves page)
+CPU_INLINE uint8_t fetch_byte(Cpu* cpu) {
+    uint16_t address = cpu->PC++;
+    if ((address >> 8) != cpu->code_page_number || cpu->code_page_cart_writes != cpu->bus->cart_writes) {
+        cpu->code_page = bus_code_page(cpu->bus, address);
+        cpu->code_page_number = address >> 8;
+        cpu->code_page_cart_writes = cpu->bus->cart_writes;
+    }
+    return cpu->code_page ? cpu->code_page[address & 0x00FF] : bus_read(cpu->bus, address);
+}
+
+// Everything an instruction touches has to share a cache line
+_Static_assert(offsetof(Cpu, prg_map) + sizeof(((Cpu*)0)->prg_map) <= CPU_CACHE_LINE,
+               "The CPU's hot state has outgrown its cache line");
+
+// Zero page and the stack ($0000-$01FF) are always system RAM (see Bus.h), so they skip the bus
+// The 8-bit address/stack pointer means these can't reach anything else
+_Static_assert(BUS_RAM_SIZE >= 0x0200, "Zero page and the stack have to be in system RAM");
+
+CPU_INLINE uint8_t zero_page_read(Cpu* cpu, uint8_t address) {
+    return cpu->ram[address];
+}
+
+CPU_INLINE void ram_write(Cpu* cpu, uint16_t address, uint8_t value) {
+    cpu->ram[address] = value;
+    // Same as 'bus_write', code decoded from this page is stale now
+    if (cpu->bus->block_cache && cpu->bus->block_cache->ram_code[address >> 8]) {
+        block_cache_invalidate_ram(cpu->bus->block_cache);
+    }
+}
+
+CPU_INLINE void zero_page_write(Cpu* cpu, uint8_t address, uint8_t value) {
+    ram_write(cpu, address, value);
+}
+
+CPU_INLINE uint8_t stack_read(Cpu* cpu, uint8_t sp) {
+    return cpu->ram[0x0100 + sp];
+}
+
+// Read anywhere, RAM and mapped PRG straight from the memory map, everything else through the bus
+CPU_INLINE uint8_t read_memory(Cpu* cpu, uint16_t address) {
+    if (address >= 0x8000) {
+        const uint8_t* bank = cpu->prg_map[(address >> 13) & 0x03];
+        if (bank) {
+            return bank[address & 0x1FFF];
+        }
+    } else if (address <= 0x1FFF) {
+        return cpu->ram[address & 0x07FF];
+    }
+    return bus_read(cpu->bus, address);
+}
+
+// Write anywhere through the bus, if the cartridge took it (bank switch) the PRG map has to be looked up again
+CPU_INLINE void write_memory(Cpu* cpu, uint16_t address, uint8_t value) {
+    uint32_t cart_writes = cpu->bus->cart_writes;
+    bus_write(cpu->bus, address, value);
+    if (cpu->bus->cart_writes != cart_writes) {
+        cpu_map_prg(cpu);
+    }
+}
+
+CPU_INLINE void stack_write(Cpu* cpu, uint8_t sp, uint8_t value) {
+    ram_write(cpu, 0x0100 + sp, value);
+}
+
+// Read an instruction's operand bytes after the opcode (the part of decoding that only depends on the code itself).
+// IMM yields the immediate value, REL yields the branch target, everything else the raw 8/16-bit operand.
+CPU_INLINE uint16_t fetch_operand(Cpu* cpu, AddressingMode mode) {
+    uint16_t operand = 0;
     switch (mode) {
-        case IMM: // checked
-            value = bus_read(cpu->bus, cpu->PC++);
+        case IMM:
+        case ZP0:
+        case ZPX:
+        case ZPY:
+        case IZX:
+        case IZY:
+            operand = fetch_byte(cpu);
             break;
-        case ZP0: // checked
-            *address = (bus_read(cpu->bus, cpu->PC++) & 0x00FF);
-            value = bus_read(cpu->bus, *address);
+        case ABS:
+        case ABX:
+        case ABY:
+        case IND:
+            {
+                uint16_t lo = fetch_byte(cpu);
+                uint16_t hi = fetch_byte(cpu);
+                operand = (hi << 8) | lo;
+            }
             break;
-        case ZPX: // checked
-            *address = (bus_read(cpu->bus, cpu->PC++) + cpu->X) & 0x00FF;
-            value = bus_read(cpu->bus, *address);
+        case REL:
+            {
+                // Branch target, the branch handlers decide whether to take it
+                int8_t offset = (int8_t)fetch_byte(cpu);
+                operand = cpu->PC + offset;
+            }
             break;
-        case ZPY: // checked
-            *address = (bus_read(cpu->bus, cpu->PC++) + cpu->Y) & 0x00FF;
-            value = bus_read(cpu->bus, *address);
+        case ACC: // No operand to fetch
+        case IMP: // No operand to fetch
+        default:
             break;
-        case ABS: // checked
-            *address = bus_read(cpu->bus, cpu->PC++) | (bus_read(cpu->bus, cpu->PC++) << 8);
-            value = bus_read(cpu->bus, *address);
+    }
+    return operand;
+}
+
+// Resolve the effective address for an addressing mode from its operand (see 'fetch_operand').
+// IMM resolves to the immediate value itself (see 'read_operand'), ACC and IMP resolve to nothing.
+// Indexed modes add the page-cross cycle here when the opcode has one ('page_penalty').
+CPU_INLINE uint16_t resolve_address(Cpu* cpu, AddressingMode mode, bool page_penalty, uint16_t operand) {
+    uint16_t address = 0;
+    switch (mode) {
+        case IMM:
+        case ZP0:
+        case ABS:
+        case IND:
+        case REL:
+            address = operand;
             break;
-        // case ABX:
-        //     *address = (bus_read(cpu->bus, cpu->PC++) | (bus_read(cpu->bus, cpu->PC++) << 8));
-        //     *address += cpu->X;
-        //     *address &= 0xFFFF;  // Ensure address wraps at 16-bit boundary
-        //     value = bus_read(cpu->bus, *address);
-        //     break;
-
-        // case ABY:
-        //     *address = (bus_read(cpu->bus, cpu->PC++) | (bus_read(cpu->bus, cpu->PC++) << 8) + cpu->Y);
-        //     *address += cpu->Y;
-        //     *address &= 0xFFFF;  // Ensure address wraps at 16-bit boundary
-        //     value = bus_read(cpu->bus, *address);
-        //     break;
-        case ABX: // checked
-            *address = (bus_read(cpu->bus, cpu->PC++) | (bus_read(cpu->bus, cpu->PC++) << 8)) + cpu->X;
-            value = bus_read(cpu->bus, *address);
+        case ZPX:
+            address = (operand + cpu->X) & 0x00FF;
             break;
-        case ABY: // checked
-            *address = (bus_read(cpu->bus, cpu->PC++) | (bus_read(cpu->bus, cpu->PC++) << 8)) + cpu->Y;
-            value = bus_read(cpu->bus, *address);
+        case ZPY:
+            address = (operand + cpu->Y) & 0x00FF;
             break;
-        case IZX: // checked
-            {
-                uint16_t t = bus_read(cpu->bus, cpu->PC++);
-                uint16_t lo = bus_read(cpu->bus, (uint16_t)(t + (uint16_t)cpu->X) & 0x00FF);
-                uint16_t hi = bus_read(cpu->bus, (uint16_t)(t + (uint16_t)cpu->X + 1) & 0x00FF);
-                *address = (hi << 8) | lo;
-                value = bus_read(cpu->bus, *address);
-                break;
+        case ABX:
+        case ABY:
+            address = operand + (mode == ABX ? cpu->X : cpu->Y);
+            if (page_penalty && page_crossed(operand, address)) {
+                cpu->cycles_left += 1;
             }
-        case IZY: // checked
+            break;
+        case IZX:
             {
-                uint16_t t = bus_read(cpu->bus, cpu->PC++);
-                uint16_t lo = bus_read(cpu->bus, t & 0x00FF);
-                uint16_t hi = bus_read(cpu->bus, (t + 1) & 0x00FF);
-                *address = ((hi << 8) | lo) + cpu->Y;
-                value = bus_read(cpu->bus, *address);
-                break;
+                uint16_t lo = zero_page_read(cpu, operand + cpu->X);
+                uint16_t hi = zero_page_read(cpu, operand + cpu->X + 1);
+                address = (hi << 8) | lo;
             }
-        case REL: // checked
+            break;
+        case IZY:
             {
-                int8_t offset = (int8_t)bus_read(cpu->bus, cpu->PC++);
-                if (offset & 0x80) {      // 0x80 = 128. Here we check the 7th bit
-                    offset |= 0xFF00;
+                uint16_t lo = zero_page_read(cpu, operand);
+                uint16_t hi = zero_page_read(cpu, operand + 1);
+                uint16_t base = (hi << 8) | lo;
+                address = base + cpu->Y;
+                if (page_penalty && page_crossed(base, address)) {
+                    cpu->cycles_left += 1;
                 }
-                // Note: Branch instructions handle the PC update
-                // Here, we return the target address, but actual branching is handled in the handler
-                *address = cpu->PC + offset;
             }
             break;
-        case ACC: // checked
-            // No operand to fetch
-            break;
-        case IMP: // checked
-            // No operand to fetch
-            break;
+        case ACC: // No operand
+        case IMP: // No operand
         default:
-            // Handle unsupported addressing modes
             break;
     }
-    return value;
+    return address;
+}
+
+// Zero page modes always resolve into zero page (the mode is known at compile time in each opcode's handler)
+CPU_INLINE bool zero_page_mode(AddressingMode mode) {
+    return mode == ZP0 || mode == ZPX || mode == ZPY;
+}
+
+// Read the value an instruction operates on, immediates are already in hand so skip the bus
+CPU_INLINE uint8_t read_operand(Cpu* cpu, AddressingMode mode, uint16_t address) {
+    if (mode == IMM) {
+        return (uint8_t)address;
+    }
+    return zero_page_mode(mode) ? zero_page_read(cpu, address) : read_memory(cpu, address);
 }
 
+// Write an instruction's result back to memory
+CPU_INLINE void write_operand(Cpu* cpu, AddressingMode mode, uint16_t address, uint8_t value) {
+    if (zero_page_mode(mode)) {
+        zero_page_write(cpu, address, value);
+    } else {
+        write_memory(cpu, address, value);
+    }
+}
+
+// With lazy flags, N/Z/C/V setters only record their input, 'cpu_get_status' builds the real bits
 void set_carry_flag(Cpu* cpu, bool set) {
+#ifdef CPU_LAZY_FLAGS
+    cpu->flag_c = set;
+#else
     if (set) {
         cpu->STATUS |= FLAG_CARRY;
     } else {
         cpu->STATUS &= ~FLAG_CARRY;
     }
+#endif
 }
 
 void set_zero_flag(Cpu* cpu, bool set) {
+#ifdef CPU_LAZY_FLAGS
+    cpu->flag_z = !set;
+#else
     if (set) {
         cpu->STATUS |= FLAG_ZERO;
     } else {
         cpu->STATUS &= ~FLAG_ZERO;
     }
+#endif
 }
 
 void set_interrupt_flag(Cpu* cpu, bool set) {
@@ -493,19 +550,27 @@ void set_decimal_flag(Cpu* cpu, bool set) {
 }
 
 void set_negative_flag(Cpu* cpu, uint8_t value) {
+#ifdef CPU_LAZY_FLAGS
+    cpu->flag_n = value;
+#else
     if (value & 0x80) {
         cpu->STATUS |= FLAG_NEGATIVE;
     } else {
         cpu->STATUS &= ~FLAG_NEGATIVE;
     }
+#endif
 }
 
 void set_overflow_flag(Cpu* cpu, bool set) {
+#ifdef CPU_LAZY_FLAGS
+    cpu->flag_v = set;
+#else
     if (set) {
         cpu->STATUS |= FLAG_OVERFLOW;
     } else {
         cpu->STATUS &= ~FLAG_OVERFLOW;
     }
+#endif
 }
 
 void set_break_flag(Cpu* cpu, bool set) {
@@ -524,20 +589,81 @@ void set_unused_flag(Cpu* cpu, bool set) {
     }
 }
 
+// Zero and Negative from the same result byte, the common case for loads, transfers and ALU ops
+CPU_INLINE void set_nz_flags(Cpu* cpu, uint8_t value) {
+#ifdef CPU_LAZY_FLAGS
+    cpu->flag_z = value;
+    cpu->flag_n = value;
+#else
+    set_zero_flag(cpu, value == 0x00);
+    set_negative_flag(cpu, value & 0x80);
+#endif
+}
+
+// Read a single flag, only the one asked for is evaluated (the switch folds away for constant flags)
+CPU_INLINE bool get_flag(Cpu* cpu, uint8_t flag) {
+#ifdef CPU_LAZY_FLAGS
+    switch (flag) {
+        case FLAG_CARRY:    return cpu->flag_c != 0;
+        case FLAG_ZERO:     return cpu->flag_z == 0;
+        case FLAG_OVERFLOW: return cpu->flag_v != 0;
+        case FLAG_NEGATIVE: return (cpu->flag_n & 0x80) != 0;
+        default:            return (cpu->STATUS & flag) != 0;
+    }
+#else
+    return (cpu->STATUS & flag) != 0;
+#endif
+}
+
+uint8_t cpu_get_status(Cpu* cpu) {
+#ifdef CPU_LAZY_FLAGS
+    return (cpu->STATUS & ~(FLAG_CARRY | FLAG_ZERO | FLAG_OVERFLOW | FLAG_NEGATIVE))
+         | (cpu->flag_c ? FLAG_CARRY : 0)
+         | (cpu->flag_z ? 0 : FLAG_ZERO)
+         | (cpu->flag_v ? FLAG_OVERFLOW : 0)
+         | (cpu->flag_n & FLAG_NEGATIVE);
+#else
+    return cpu->STATUS;
+#endif
+}
+
+void cpu_set_status(Cpu* cpu, uint8_t status) {
+    cpu->STATUS = status;
+#ifdef CPU_LAZY_FLAGS
+    cpu->flag_c = status & FLAG_CARRY;
+    cpu->flag_z = !(status & FLAG_ZERO);
+    cpu->flag_v = status & FLAG_OVERFLOW;
+    cpu->flag_n = status & FLAG_NEGATIVE;
+#endif
+}
+
 // Stack Operations
 void push_stack(Cpu* cpu, uint8_t value) {
-    bus_write(cpu->bus, 0x0100 + cpu->SP, value);
+    stack_write(cpu, cpu->SP, value);
     cpu->SP--;
 }
 
 uint8_t pull_stack(Cpu* cpu) {
     cpu->SP++;
-    return bus_read(cpu->bus, 0x0100 + cpu->SP);
+    return stack_read(cpu, cpu->SP);
+}
+
+// CLI/SEI/PLP change I after the interrupt poll, so keep the old I for the boundary straight after them
+// ('cycles_left' already includes this instruction, and everything before it in a compiled block)
+CPU_INLINE void delay_interrupt_flag(Cpu* cpu) {
+    cpu->delayed_i_cycle = cpu->cycle_count + cpu->cycles_left;
+    cpu->delayed_i = cpu->STATUS & FLAG_INTERRUPT_DISABLE;
 }
 
 // CPU Initialization and helper functions
 Cpu* init_cpu(Bus* bus) {
-    Cpu* cpu = (Cpu*)malloc(sizeof(Cpu));
+    // Aligned so the hot state at the start is one cache line, not split over two
+    size_t size = (sizeof(Cpu) + CPU_CACHE_LINE - 1) & ~(size_t)(CPU_CACHE_LINE - 1);
+#ifdef _WIN32
+    Cpu* cpu = (Cpu*)_aligned_malloc(size, CPU_CACHE_LINE);
+#else
+    Cpu* cpu = (Cpu*)aligned_alloc(CPU_CACHE_LINE, size);
+#endif
     if (!cpu) {
         fprintf(stderr, "[CPU] Error, Failed to allocate memory for the CPU.\n");
         exit(1);
@@ -550,42 +676,83 @@ Cpu* init_cpu(Bus* bus) {
     cpu->Y = 0;
     cpu->SP = 0xFD; // Typical reset value
     cpu->PC = 0x0000;
-    cpu->STATUS = 0;
+    cpu_set_status(cpu, 0);
     cpu->bus = bus;
+    cpu->ram = bus->main_memory;
+    cpu_map_prg(cpu);
     cpu->running = true;
     cpu->cycle_count = 0;
     cpu->cycles_left = 0;
+    cpu->code_page = NULL;
+    cpu->code_page_number = CODE_PAGE_NONE;
+    cpu->code_page_cart_writes = 0;
+    cpu->poll_dot = 0;
+    cpu->delayed_i_cycle = -1;
+    cpu->delayed_i = 0;
+
+#ifdef CPU_BLOCK_CACHE
+    cpu->block_cache = init_block_cache();
+    bus->block_cache = cpu->block_cache;
+#else
+    cpu->block_cache = NULL;
+#endif
+#ifdef CPU_IDLE_SKIP
+    cpu->idle_loop = init_idle_loop();
+#else
+    cpu->idle_loop = NULL;
+#endif
+#ifdef CPU_JIT
+    cpu->jit = init_jit();
+#endif
+#ifdef CPU_TRACE
+    cpu->trace = init_trace();
+#endif
 
     printf("[CPU] CPU Initialised!\n");
     return cpu;
 }
 
+void free_cpu(Cpu* cpu) {
+    free(cpu->block_cache);
+    free(cpu->idle_loop);
+#ifdef CPU_TRACE
+    free(cpu->trace);
+#endif
+#ifdef CPU_JIT
+    free_jit(cpu->jit);
+#endif
+#ifdef _WIN32
+    _aligned_free(cpu);
+#else
+    free(cpu);
+#endif
+}
+
+void cpu_map_prg(Cpu* cpu) {
+    for (int i = 0; i < 4; i++) {
+        cpu->prg_map[i] = cpu->bus->cart ? cartridge_cpu_bank(cpu->bus->cart, 0x8000 + (i * 0x2000)) : NULL;
+    }
+}
+
 // Print the state of the CPU (registers)
 void print_cpu(Cpu* cpu) {
+    uint8_t status = cpu_get_status(cpu);
     printf("|  A:%02x |  X:%02x |  Y:%02x |  SP:%04x |  PC:%04x |\n", cpu->A, cpu->X, cpu->Y, cpu->SP, cpu->PC);
-    printf("| C:%01x | Z:%01x | I:%01x | D:%01x | B:%01x | - | O:%01x | N:%01x |\n", (cpu->STATUS >> 0) & 1,
-                                                                                     (cpu->STATUS >> 1) & 1,
-                                                                                     (cpu->STATUS >> 2) & 1,
-                                                                                     (cpu->STATUS >> 3) & 1,
-                                                                                     (cpu->STATUS >> 4) & 1,
-                                                                                     (cpu->STATUS >> 6) & 1,
-                                                                                     (cpu->STATUS >> 7) & 1);
+    printf("| C:%01x | Z:%01x | I:%01x | D:%01x | B:%01x | - | O:%01x | N:%01x |\n", (status >> 0) & 1,
+                                                                                     (status >> 1) & 1,
+                                                                                     (status >> 2) & 1,
+                                                                                     (status >> 3) & 1,
+                                                                                     (status >> 4) & 1,
+                                                                                     (status >> 6) & 1,
+                                                                                     (status >> 7) & 1);
     printf("\n");
 }
 
 // Print the current instruction being executed
 void print_instruction(Cpu* cpu, Opcode c, uint8_t n) {
     // PC ADDR | INSTRUCTION | VALUE? (value of PC + 1) | ADDRESSING MODE
-    if (strcmp(InstructionStrings[c.instruction], "BCC") == 0 || 
-        strcmp(InstructionStrings[c.instruction], "BCS") == 0 || 
-        strcmp(InstructionStrings[c.instruction], "BEQ") == 0 || 
-        strcmp(InstructionStrings[c.instruction], "BMI") == 0 || 
-        strcmp(InstructionStrings[c.instruction], "BNE") == 0 || 
-        strcmp(InstructionStrings[c.instruction], "BPL") == 0 || 
-        strcmp(InstructionStrings[c.instruction], "BVC") == 0 || 
-        strcmp(InstructionStrings[c.instruction], "BVS") == 0 || 
-        strcmp(InstructionStrings[c.instruction], "JMP") == 0 || 
-        strcmp(InstructionStrings[c.instruction], "JSR") == 0) {
+    // Branches (the only relative instructions) and jumps print their value as an address
+    if (c.addressing_mode == REL || c.instruction == JMP || c.instruction == JSR) {
         printf("$%04x:  %s  #$%04x  {%s}\n", cpu->PC, 
                                             InstructionStrings[c.instruction], 
                                             n,
@@ -598,246 +765,6 @@ void print_instruction(Cpu* cpu, Opcode c, uint8_t n) {
     }
 }
 
-// Check for page-crossing
-static inline bool page_crossed(uint16_t old_addr, uint16_t new_addr) {
-    return ((old_addr & 0xFF00) != (new_addr & 0xFF00));
-}
-
-// Main CPU Clock function
-void cpu_clock(Cpu* cpu, bool run_debug, int frame_num) {
-    if (cpu->cycles_left == 0) {
-        uint8_t opcode = bus_read(cpu->bus, cpu->PC++);
-        Opcode current_opcode = opcode_table[opcode];
-        
-        // This was to print the next instruction during runtime, but we dont use by default
-        // uint8_t next_opcode = bus_read(cpu->bus, cpu->PC++);
-        // cpu->PC--;  // We increment the PC to read the next opcode, so we need to go back (I hate this...)
-
-        // printf("Instruction: %s\n", InstructionStrings[current_opcode.instruction]);
-        // printf("PC: %d\n", cpu->PC);
-        //for (volatile int i = 0; i < 50000000; i++);
-        
-        // Debug statement to test with nestest.nes 'golden log' before we had PPU bgs and therefore GUI
-        //printf("PC: %02X |  %s  |  A:%02x |  X:%02x |  Y:%02x |  SP:%04x | %d\n", cpu->PC-1, InstructionStrings[current_opcode.instruction], cpu->A, cpu->X, cpu->Y, cpu->SP, cpu->cycle_count);
-
-        // NOTE: cpu->cycles_left is decremented within the instruction handlers, happy days!
-        switch (current_opcode.instruction) {
-            case LDA:
-                handle_LDA(cpu, opcode);
-                break;
-            case LDX:
-                handle_LDX(cpu, opcode);
-                break;
-            case LDY:
-                handle_LDY(cpu, opcode);
-                break;
-            case STA:
-                handle_STA(cpu, opcode);
-                break;
-            case STX:
-                handle_STX(cpu, opcode);
-                break;
-            case STY:
-                handle_STY(cpu, opcode);
-                break;
-            case TAX:
-                handle_TAX(cpu, opcode);
-                break;
-            case TAY:
-                handle_TAY(cpu, opcode);
-                break;
-            case TXA:
-                handle_TXA(cpu, opcode);
-                break;
-            case TYA:
-                handle_TYA(cpu, opcode);
-                break;
-            case TSX:
-                handle_TSX(cpu, opcode);
-                break;
-            case TXS:
-                handle_TXS(cpu, opcode);
-                break;
-            case PHA:
-                handle_PHA(cpu, opcode);
-                break;
-            case PHP:
-                handle_PHP(cpu, opcode);
-                break;
-            case PLA:
-                handle_PLA(cpu, opcode);
-                break;
-            case PLP:
-                handle_PLP(cpu, opcode);
-                break;
-            case AND:
-                handle_AND(cpu, opcode);
-                break;
-            case EOR:
-                handle_EOR(cpu, opcode);
-                break;
-            case ORA:
-                handle_ORA(cpu, opcode);
-                break;
-            case BIT:
-                handle_BIT(cpu, opcode);
-                break;
-            case ADC:
-                handle_ADC(cpu, opcode);
-                break;
-            case SBC:
-                handle_SBC(cpu, opcode);
-                break;
-            case CMP:
-                handle_CMP(cpu, opcode);
-                break;
-            case CPX:
-                handle_CPX(cpu, opcode);
-                break;
-            case CPY:
-                handle_CPY(cpu, opcode);
-                break;
-            case INC:
-                handle_INC(cpu, opcode);
-                break;
-            case INX:
-                handle_INX(cpu, opcode);
-                break;
-            case INY:
-                handle_INY(cpu, opcode);
-                break;
-            case DEC:
-                handle_DEC(cpu, opcode);
-                break;
-            case DEX:
-                handle_DEX(cpu, opcode);
-                break;
-            case DEY:
-                handle_DEY(cpu, opcode);
-                break;
-            case ASL:
-                handle_ASL(cpu, opcode);
-                break;
-            case LSR:
-                handle_LSR(cpu, opcode);
-                break;
-            case ROL:
-                handle_ROL(cpu, opcode);
-                break;
-            case ROR:
-                handle_ROR(cpu, opcode);
-                break;
-            case JMP:
-                handle_JMP(cpu, opcode);
-                break;
-            case JSR:
-                handle_JSR(cpu, opcode);
-                break;
-            case RTS:
-                handle_RTS(cpu, opcode);
-                break;
-            case BCC:
-                handle_BCC(cpu, opcode);
-                break;
-            case BCS:
-                handle_BCS(cpu, opcode);
-                break;
-            case BEQ:
-                handle_BEQ(cpu, opcode);
-                break;
-            case BMI:
-                handle_BMI(cpu, opcode);
-                break;
-            case BNE:
-                handle_BNE(cpu, opcode);
-                break;
-            case BPL:
-                handle_BPL(cpu, opcode);
-                break;
-            case BVC:
-                handle_BVC(cpu, opcode);
-                break;
-            case BVS:
-                handle_BVS(cpu, opcode);
-                break;
-            case CLC:
-                handle_CLC(cpu, opcode);
-                break;
-            case CLD:
-                handle_CLD(cpu, opcode);
-                break;
-            case CLI:
-                handle_CLI(cpu, opcode);
-                break;
-            case CLV:
-                handle_CLV(cpu, opcode);
-                break;
-            case SEC:
-                handle_SEC(cpu, opcode);
-                break;
-            case SED:
-                handle_SED(cpu, opcode);
-                break;
-            case SEI:
-                handle_SEI(cpu, opcode);
-                break;
-            case BRK:
-                handle_BRK(cpu, opcode);
-                break;
-            case NOP:
-                handle_NOP(cpu, opcode);
-                break;
-            case RTI:
-                handle_RTI(cpu, opcode);
-                break;
-            case LAX:
-                handle_LAX(cpu, opcode);
-                break;
-            case SAX:
-                handle_SAX(cpu, opcode);
-                break;
-            case DCP:
-                handle_DCP(cpu, opcode);
-                break;
-            case ISB:
-                handle_ISB(cpu, opcode);
-                break;
-            case SLO:
-                handle_SLO(cpu, opcode);
-                break;
-            case RLA:
-                handle_RLA(cpu, opcode);
-                break;
-            case SRE:
-                handle_SRE(cpu, opcode);
-                break;
-            case RRA:
-                handle_RRA(cpu, opcode);
-                break;
-            case SBC_EB:
-                handle_SBC_EB(cpu, opcode);
-                break;
-            default:
-                // Handle illegal or undefined opcode(s)
-                printf("[CPU] Error, Encountered illegal or undefined opcode: 0x%02X at PC: 0x%04X\n", opcode, cpu->PC - 1);
-                cpu->running = false;
-                break;
-        }
-        
-        // if (run_debug) {
-        //     printf("[CPU] Instruction %d: \n", frame_num);
-        //     printf("Current Opcode: %02x\n", opcode);
-        //     printf("\n");
-        //     print_instruction(cpu, current_opcode, next_opcode);
-        //     printf("\n");
-        //     print_cpu(cpu);
-        // }
-    }
-    // Attempt to make the CPU somewhat cycle accurate (cycles_left is modified within instructions)
-    cpu->cycle_count++;
-    cpu->cycles_left--;
-}
-
 // CPU Reset Function
 void cpu_reset(Cpu* cpu, Bus* bus) {
 	uint16_t lo = bus_read(bus, 0xFFFC + 0);
@@ -849,387 +776,187 @@ void cpu_reset(Cpu* cpu, Bus* bus) {
 	cpu->X = 0x00;
 	cpu->Y = 0x00;
 	cpu->SP = 0xFD;
-	cpu->STATUS = 0x00 | FLAG_UNUSED;
+	cpu_set_status(cpu, 0x00 | FLAG_UNUSED);
 
     cpu->cycle_count = 0;
 	cpu->cycles_left = 8;
-}
-
-// CPU Interrupt Request Function
-void cpu_irq(Cpu* cpu, Bus* bus) {
-    if (cpu->STATUS & FLAG_INTERRUPT_DISABLE == 0){
-		bus_write(bus, (0x0100) + (cpu->SP--), (cpu->PC >> 8) & 0x00FF);
-		bus_write(bus, (0x0100) + (cpu->SP--), cpu->PC & 0x00FF);
-
-        set_break_flag(cpu, false);
-		set_unused_flag(cpu, true);
-		set_interrupt_flag(cpu, true);
-		bus_write(bus, (0x0100) + (cpu->SP--), cpu->STATUS);
 
-		uint16_t lo = bus_read(bus, 0xFFFE + 0);
-		uint16_t hi = bus_read(bus, 0xFFFE + 1);
-		cpu->PC = (hi << 8) | lo;
-
-		cpu->cycles_left = 7;
-	}
+    // The cartridge may have been swapped, nothing decoded or mapped before the reset can be trusted
+    cpu->code_page_number = CODE_PAGE_NONE;
+    cpu_map_prg(cpu);
+    cpu->delayed_i_cycle = -1;
+    if (cpu->block_cache) {
+        block_cache_flush(cpu->block_cache);
+    }
+    if (cpu->idle_loop) {
+        idle_loop_forget(cpu->idle_loop);
+    }
 }
 
-// CPU Non-Maskable Interrupt Function
-void cpu_nmi(Cpu* cpu, Bus* bus) {
-    bus_write(bus, (0x0100) + (cpu->SP--), (cpu->PC >> 8) & 0x00FF);
-	bus_write(bus, (0x0100) + (cpu->SP--), cpu->PC & 0x00FF);
+// Push PC and STATUS (B clear) and jump through 'vector', the part of IRQ and NMI that is the same (7 cycles)
+static int take_interrupt(Cpu* cpu, Bus* bus, uint16_t vector) {
+    // Whatever loop the CPU was in, the handler can change what it was waiting on
+    if (cpu->idle_loop) {
+        idle_loop_forget(cpu->idle_loop);
+    }
+
+    push_stack(cpu, (cpu->PC >> 8) & 0x00FF);
+    push_stack(cpu, cpu->PC & 0x00FF);
 
     set_break_flag(cpu, false);
     set_unused_flag(cpu, true);
     set_interrupt_flag(cpu, true);
-	bus_write(bus, (0x0100) + (cpu->SP--), cpu->STATUS);
+    push_stack(cpu, cpu_get_status(cpu));
 
-	uint16_t lo = bus_read(bus, 0xFFFA + 0);
-	uint16_t hi = bus_read(bus, 0xFFFA + 1);
-	cpu->PC = (hi << 8) | lo;
+    uint16_t lo = bus_read(bus, vector + 0);
+    uint16_t hi = bus_read(bus, vector + 1);
+    cpu->PC = (hi << 8) | lo;
 
-	cpu->cycles_left = 8;
+    cpu->cycles_left = 7;
+    cpu->cycle_count += 7;
+    return 7;
 }
 
-
-// The fully implemented '6502' 56 'Official' Instruction Set
-// No extra 'un-official' opcodes have been implemented as of yet...
-void handle_LDA(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
-
-    uint16_t address = 0;
-    AddressingMode mode = opcode_table[opcode].addressing_mode;
-    uint8_t value = fetch_operand(cpu, mode, &address);
-
-    cpu->A = value;
-
-    set_zero_flag(cpu, cpu->A == 0x00);
-    set_negative_flag(cpu, cpu->A & 0x80);
-
-    // Check page crossing
-    if (mode == ABX) {
-        uint16_t base = address - cpu->X;
-        if (page_crossed(base, address)) {
-            cpu->cycles_left += 1;
-        }
-    } else if (mode == ABY) {
-        uint16_t base = address - cpu->Y;
-        if (page_crossed(base, address)) {
-            cpu->cycles_left += 1;
-        }
+// CPU Interrupt Request Function (returns the cycles taken, 0 if the interrupt was masked)
+int cpu_irq(Cpu* cpu, Bus* bus) {
+    if ((cpu->STATUS & FLAG_INTERRUPT_DISABLE) == 0) {
+        return take_interrupt(cpu, bus, 0xFFFE);
     }
+    return 0;
 }
 
-void handle_LDX(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
-
-    uint16_t address = 0;
-    AddressingMode mode = opcode_table[opcode].addressing_mode;
-    uint8_t value = fetch_operand(cpu, mode, &address);
-
-    cpu->X = value;
-
-    set_zero_flag(cpu, cpu->X == 0x00);
-    set_negative_flag(cpu, cpu->X & 0x80);
-
-    // Check page crossing
-    if (mode == ABY) {
-        uint16_t base = address - cpu->Y;
-        if (page_crossed(base, address)) {
-            cpu->cycles_left += 1;
-        }
-    }
+// CPU Non-Maskable Interrupt Function (returns the cycles taken)
+int cpu_nmi(Cpu* cpu, Bus* bus) {
+    return take_interrupt(cpu, bus, 0xFFFA);
 }
 
-void handle_LDY(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
-
-    uint16_t address = 0;
-    AddressingMode mode = opcode_table[opcode].addressing_mode;
-    uint8_t value = fetch_operand(cpu, mode, &address);
-
-    cpu->Y = value;
-
-    set_zero_flag(cpu, cpu->Y == 0x00);
-    set_negative_flag(cpu, cpu->Y & 0x80);
+int cpu_interrupt(Cpu* cpu) {
+    Interrupts* lines = cpu->bus->interrupts;
 
-    // Check page crossing
-    if (mode == ABX) {
-        uint16_t base = address - cpu->X;
-        if (page_crossed(base, address)) {
-            cpu->cycles_left += 1;
+    // Only what was already there when the last instruction polled (the start of its last cycle)
+    if (lines->nmi && lines->nmi_time < cpu->poll_dot) {
+        lines->nmi = false;
+        return cpu_nmi(cpu, cpu->bus);
+    }
+    if (lines->irq && lines->irq_time < cpu->poll_dot) {
+        // Straight after CLI/SEI/PLP the poll still saw the old I
+        uint8_t masked = (cpu->cycle_count == cpu->delayed_i_cycle) ? cpu->delayed_i
+                                                                      : (cpu->STATUS & FLAG_INTERRUPT_DISABLE);
+        if (!masked) {
+            return take_interrupt(cpu, cpu->bus, 0xFFFE);
         }
     }
+    return 0;
 }
 
-void handle_STA(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles; 
-    uint16_t address = 0;
-    AddressingMode mode = opcode_table[opcode].addressing_mode;
 
-    // Address calculation
-    switch(mode) {
-        case ZP0:
-            address = bus_read(cpu->bus, cpu->PC++);
-            break;
-        case ZPX:
-            {
-                uint8_t zp = bus_read(cpu->bus, cpu->PC++);
-                address = (zp + cpu->X) & 0xFF;
-            }
-            break;
-        case ZPY:
-            {
-                uint8_t zp = bus_read(cpu->bus, cpu->PC++);
-                address = (zp + cpu->Y) & 0xFF;
-            }
-            break;
-        case ABS:
-            address = bus_read(cpu->bus, cpu->PC++) | (bus_read(cpu->bus, cpu->PC++) << 8);
-            break;
-        case ABX:
-            {
-                uint16_t base = bus_read(cpu->bus, cpu->PC++) | (bus_read(cpu->bus, cpu->PC++) << 8);
-                address = base + cpu->X;
-                // STA does NOT add a cycle for crossing in standard 6502 behavior
-            }
-            break;
-        case ABY:
-            {
-                uint16_t base = bus_read(cpu->bus, cpu->PC++) | (bus_read(cpu->bus, cpu->PC++) << 8);
-                address = base + cpu->Y;
-                // STA does NOT add a cycle for crossing
-            }
-            break;
-        case IZX:
-            {
-                uint8_t zp = bus_read(cpu->bus, cpu->PC++);
-                uint16_t ptr = (zp + cpu->X) & 0xFF;
-                address = bus_read(cpu->bus, ptr) | (bus_read(cpu->bus, (ptr + 1) & 0xFF) << 8);
-            }
-            break;
-        case IZY:
-            {
-                uint8_t zp = bus_read(cpu->bus, cpu->PC++);
-                uint16_t base = bus_read(cpu->bus, zp) | (bus_read(cpu->bus, (zp + 1) & 0xFF) << 8);
-                address = base + cpu->Y;
-                // STA (IZY) does not add cycle for crossing
-            }
-            break;
-        default:
-            printf("STA encountered with unsupported addressing mode: %d\n", mode);
-            cpu->running = false;
-            return;
-    }
+// The fully implemented '6502' 56 'Official' Instruction Set
+// Each handler gets the effective address already resolved by 'resolve_address' for its opcode
+// No extra 'un-official' opcodes have been implemented as of yet...
+CPU_INLINE void handle_LDA(Cpu* cpu, AddressingMode mode, uint16_t address) {
+    cpu->A = read_operand(cpu, mode, address);
 
-    bus_write(cpu->bus, address, cpu->A);
+    set_nz_flags(cpu, cpu->A);
 }
 
-void handle_STX(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles; 
-    uint16_t address = 0;
-    AddressingMode mode = opcode_table[opcode].addressing_mode;
-
-    switch(mode) {
-        case ZP0:
-            address = bus_read(cpu->bus, cpu->PC++);
-            break;
-        case ZPY:
-            {
-                uint8_t zp = bus_read(cpu->bus, cpu->PC++);
-                address = (zp + cpu->Y) & 0xFF;
-            }
-            break;
-        case ABS:
-            address = bus_read(cpu->bus, cpu->PC++) | (bus_read(cpu->bus, cpu->PC++) << 8);
-            break;
-        default:
-            printf("STX encountered with unsupported addressing mode: %d\n", mode);
-            cpu->running = false;
-            return;
-    }
+CPU_INLINE void handle_LDX(Cpu* cpu, AddressingMode mode, uint16_t address) {
+    cpu->X = read_operand(cpu, mode, address);
 
-    bus_write(cpu->bus, address, cpu->X);
+    set_nz_flags(cpu, cpu->X);
 }
 
-void handle_STY(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
+CPU_INLINE void handle_LDY(Cpu* cpu, AddressingMode mode, uint16_t address) {
+    cpu->Y = read_operand(cpu, mode, address);
 
-    uint16_t address = 0;
-    AddressingMode mode = opcode_table[opcode].addressing_mode;
+    set_nz_flags(cpu, cpu->Y);
+}
 
-    switch(mode) {
-        case ZP0:
-            address = bus_read(cpu->bus, cpu->PC++);
-            break;
-        case ZPX:
-            {
-                uint8_t zp = bus_read(cpu->bus, cpu->PC++);
-                address = (zp + cpu->X) & 0xFF;
-            }
-            break;
-        case ABS:
-            address = bus_read(cpu->bus, cpu->PC++) | (bus_read(cpu->bus, cpu->PC++) << 8);
-            break;
-        default:
-            printf("STY encountered with unsupported addressing mode: %d\n", mode);
-            cpu->running = false;
-            return;
-    }
+// Stores never take the page-cross cycle (it is already part of their cycle count)
+CPU_INLINE void handle_STA(Cpu* cpu, AddressingMode mode, uint16_t address) {
+    write_operand(cpu, mode, address, cpu->A);
+}
 
-    bus_write(cpu->bus, address, cpu->Y);
+CPU_INLINE void handle_STX(Cpu* cpu, AddressingMode mode, uint16_t address) {
+    write_operand(cpu, mode, address, cpu->X);
 }
 
-void handle_TAX(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
+CPU_INLINE void handle_STY(Cpu* cpu, AddressingMode mode, uint16_t address) {
+    write_operand(cpu, mode, address, cpu->Y);
+}
 
+CPU_INLINE void handle_TAX(Cpu* cpu, AddressingMode mode, uint16_t address) {
     cpu->X = cpu->A;
 
-    set_zero_flag(cpu, cpu->X == 0x00);
-    set_negative_flag(cpu, cpu->X & 0x80);
+    set_nz_flags(cpu, cpu->X);
 }
 
-void handle_TAY(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
-
+CPU_INLINE void handle_TAY(Cpu* cpu, AddressingMode mode, uint16_t address) {
     cpu->Y = cpu->A;
 
-    set_zero_flag(cpu, cpu->Y == 0x00);
-    set_negative_flag(cpu, cpu->Y & 0x80);
+    set_nz_flags(cpu, cpu->Y);
 }
 
-void handle_TXA(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
-
+CPU_INLINE void handle_TXA(Cpu* cpu, AddressingMode mode, uint16_t address) {
     cpu->A = cpu->X;
 
-    set_zero_flag(cpu, cpu->A == 0x00);
-    set_negative_flag(cpu, cpu->A & 0x80);
+    set_nz_flags(cpu, cpu->A);
 }
 
-void handle_TYA(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
-    
+CPU_INLINE void handle_TYA(Cpu* cpu, AddressingMode mode, uint16_t address) {
     cpu->A = cpu->Y;
 
-    set_zero_flag(cpu, cpu->A == 0x00);
-    set_negative_flag(cpu, cpu->A & 0x80);
+    set_nz_flags(cpu, cpu->A);
 }
 
-void handle_TSX(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
-
+CPU_INLINE void handle_TSX(Cpu* cpu, AddressingMode mode, uint16_t address) {
     cpu->X = cpu->SP;
     
-    set_zero_flag(cpu, cpu->X == 0x00);
-    set_negative_flag(cpu, cpu->X & 0x80);
+    set_nz_flags(cpu, cpu->X);
 }
 
-void handle_TXS(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
-
+CPU_INLINE void handle_TXS(Cpu* cpu, AddressingMode mode, uint16_t address) {
     cpu->SP = cpu->X;
 }
 
-void handle_PHA(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
-
+CPU_INLINE void handle_PHA(Cpu* cpu, AddressingMode mode, uint16_t address) {
     push_stack(cpu, cpu->A);
 }
 
-void handle_PHP(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
-
-    uint8_t status = cpu->STATUS | FLAG_BREAK | FLAG_UNUSED;
+CPU_INLINE void handle_PHP(Cpu* cpu, AddressingMode mode, uint16_t address) {
+    uint8_t status = cpu_get_status(cpu) | FLAG_BREAK | FLAG_UNUSED;
     set_break_flag(cpu, false);
     set_unused_flag(cpu, false);
     push_stack(cpu, status);
 }
 
-void handle_PLA(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
-
+CPU_INLINE void handle_PLA(Cpu* cpu, AddressingMode mode, uint16_t address) {
     cpu->A = pull_stack(cpu);
-    set_zero_flag(cpu, cpu->A == 0x00);
-    set_negative_flag(cpu, cpu->A & 0x80);
+    set_nz_flags(cpu, cpu->A);
 }
 
-void handle_PLP(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
-
-    cpu->STATUS = pull_stack(cpu);
+CPU_INLINE void handle_PLP(Cpu* cpu, AddressingMode mode, uint16_t address) {
+    delay_interrupt_flag(cpu);
+    cpu_set_status(cpu, pull_stack(cpu));
     set_unused_flag(cpu, true);
 }
 
-void handle_AND(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
-
-    uint16_t address = 0;
-    AddressingMode mode = opcode_table[opcode].addressing_mode;
-    uint8_t value = fetch_operand(cpu, mode, &address);
-
-    cpu->A = cpu->A & value;
-    set_zero_flag(cpu, cpu->A == 0x00);
-    set_negative_flag(cpu, cpu->A & 0x80);
-
-    // Check page crossing
-    if (mode == ABX) {
-        uint16_t base = address - cpu->X;
-        if (page_crossed(base, address)) cpu->cycles_left += 1;
-    } else if (mode == ABY) {
-        uint16_t base = address - cpu->Y;
-        if (page_crossed(base, address)) cpu->cycles_left += 1;
-    }
+CPU_INLINE void handle_AND(Cpu* cpu, AddressingMode mode, uint16_t address) {
+    cpu->A = cpu->A & read_operand(cpu, mode, address);
+    set_nz_flags(cpu, cpu->A);
 }
 
-void handle_EOR(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
-
-    uint16_t address = 0;
-    AddressingMode mode = opcode_table[opcode].addressing_mode;
-    uint8_t value = fetch_operand(cpu, mode, &address);
-    
-    cpu->A ^= value;
-    set_zero_flag(cpu, cpu->A == 0x00);
-    set_negative_flag(cpu, cpu->A & 0x80);
-
-    // Check page crossing
-    if (mode == ABX) {
-        uint16_t base = address - cpu->X;
-        if (page_crossed(base, address)) cpu->cycles_left += 1;
-    } else if (mode == ABY) {
-        uint16_t base = address - cpu->Y;
-        if (page_crossed(base, address)) cpu->cycles_left += 1;
-    }
+CPU_INLINE void handle_EOR(Cpu* cpu, AddressingMode mode, uint16_t address) {
+    cpu->A ^= read_operand(cpu, mode, address);
+    set_nz_flags(cpu, cpu->A);
 }
 
-void handle_ORA(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
-
-    uint16_t address = 0;
-    AddressingMode mode = opcode_table[opcode].addressing_mode;
-    uint8_t value = fetch_operand(cpu, mode, &address);
-
-    cpu->A = cpu->A | value;
-    set_zero_flag(cpu, cpu->A == 0x00);
-    set_negative_flag(cpu, cpu->A & 0x80);
-
-    // Check page crossing
-    if (mode == ABX) {
-        uint16_t base = address - cpu->X;
-        if (page_crossed(base, address)) cpu->cycles_left += 1;
-    } else if (mode == ABY) {
-        uint16_t base = address - cpu->Y;
-        if (page_crossed(base, address)) cpu->cycles_left += 1;
-    }
+CPU_INLINE void handle_ORA(Cpu* cpu, AddressingMode mode, uint16_t address) {
+    cpu->A = cpu->A | read_operand(cpu, mode, address);
+    set_nz_flags(cpu, cpu->A);
 }
 
-void handle_BIT(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
-
-    uint16_t address = 0;
-    uint8_t value = fetch_operand(cpu, opcode_table[opcode].addressing_mode, &address);
-
+CPU_INLINE void handle_BIT(Cpu* cpu, AddressingMode mode, uint16_t address) {
+    uint8_t value = read_operand(cpu, mode, address);
     uint8_t result = cpu->A & value;
 
     set_zero_flag(cpu, (result & 0x00FF) == 0x00);
@@ -1237,356 +964,155 @@ void handle_BIT(Cpu* cpu, uint8_t opcode) {
 	set_overflow_flag(cpu, value & (1 << 6));
 }
 
-void handle_ADC(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
-
-    AddressingMode mode = opcode_table[opcode].addressing_mode;
-    uint16_t address = 0;
-    uint8_t value = fetch_operand(cpu, mode, &address);
-    uint16_t temp;
-    
+// Shared by ADC and SBC (SBC adds the inverted operand)
+CPU_INLINE void add_with_carry(Cpu* cpu, uint8_t value) {
     // Add is performed in 16-bit domain for emulation to capture any
 	// carry bit, which will exist in bit 8 of the 16-bit word
-	temp = (uint16_t)cpu->A + (uint16_t)value + (uint16_t)(cpu->STATUS & FLAG_CARRY);
+	uint16_t temp = (uint16_t)cpu->A + (uint16_t)value + (uint16_t)get_flag(cpu, FLAG_CARRY);
 	
 	// The carry flag out exists in the high byte bit 0
 	set_carry_flag(cpu, temp > 255);
 	
-	// The Zero flag is set if the result is 0
-	set_zero_flag(cpu, (temp & 0x00FF) == 0);
+	// The Zero and Negative flags are set from the 8-bit result
+	set_nz_flags(cpu, temp & 0x00FF);
 	
 	// The signed Overflow flag is set based on all that up there! :D
 	set_overflow_flag(cpu, (~((uint16_t)cpu->A ^ (uint16_t)value) & ((uint16_t)cpu->A ^ (uint16_t)temp)) & 0x0080);
 	
-	// The negative flag is set to the most significant bit of the result
-	set_negative_flag(cpu, temp & 0x80);
-	
 	// Load the result into the accumulator (it's 8-bit dont forget!)
 	cpu->A = temp & 0x00FF;
-
-    // Check page crossing
-    if (mode == ABX) {
-        uint16_t base = address - cpu->X;
-        if (page_crossed(base, address)) cpu->cycles_left += 1;
-    } else if (mode == ABY) {
-        uint16_t base = address - cpu->Y;
-        if (page_crossed(base, address)) cpu->cycles_left += 1;
-    }
 }
 
-void handle_SBC(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
-
-    AddressingMode mode = opcode_table[opcode].addressing_mode;
-    uint16_t address = 0;
-    uint8_t value = fetch_operand(cpu, mode, &address) ^ 0x00FF;
-    uint16_t temp;
-    
-    // Add is performed in 16-bit domain for emulation to capture any
-	// carry bit, which will exist in bit 8 of the 16-bit word
-	temp = (uint16_t)cpu->A + (uint16_t)value + (uint16_t)(cpu->STATUS & FLAG_CARRY);
-	
-	// The carry flag out exists in the high byte bit 0
-	set_carry_flag(cpu, temp > 255);
-	
-	// The Zero flag is set if the result is 0
-	set_zero_flag(cpu, (temp & 0x00FF) == 0);
-	
-	// The signed Overflow flag is set based on all that up there! :D
-	set_overflow_flag(cpu, (~((uint16_t)cpu->A ^ (uint16_t)value) & ((uint16_t)cpu->A ^ (uint16_t)temp)) & 0x0080);
-	
-	// The negative flag is set to the most significant bit of the result
-	set_negative_flag(cpu, temp & 0x80);
-	
-	// Load the result into the accumulator (it's 8-bit dont forget!)
-	cpu->A = temp & 0x00FF;
-
-    // Check page crossing
-    if (mode == ABX) {
-        uint16_t base = address - cpu->X;
-        if (page_crossed(base, address)) cpu->cycles_left += 1;
-    } else if (mode == ABY) {
-        uint16_t base = address - cpu->Y;
-        if (page_crossed(base, address)) cpu->cycles_left += 1;
-    }
+CPU_INLINE void handle_ADC(Cpu* cpu, AddressingMode mode, uint16_t address) {
+    add_with_carry(cpu, read_operand(cpu, mode, address));
 }
 
-void handle_CMP(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
-
-    AddressingMode mode = opcode_table[opcode].addressing_mode;
-    uint16_t address = 0;
-    uint8_t value = fetch_operand(cpu, opcode_table[opcode].addressing_mode, &address);
-
-    uint16_t result = (uint16_t)cpu->A - (uint16_t)value;
-
-    set_carry_flag(cpu, cpu->A >= value);
-    set_zero_flag(cpu, (result & 0x00FF) == 0x0000);
-    set_negative_flag(cpu, result & 0x0080);
-
-    // Check page crossing
-    if (mode == ABX) {
-        uint16_t base = address - cpu->X;
-        if (page_crossed(base, address)) cpu->cycles_left += 1;
-    } else if (mode == ABY) {
-        uint16_t base = address - cpu->Y;
-        if (page_crossed(base, address)) cpu->cycles_left += 1;
-    }
+CPU_INLINE void handle_SBC(Cpu* cpu, AddressingMode mode, uint16_t address) {
+    add_with_carry(cpu, read_operand(cpu, mode, address) ^ 0x00FF);
 }
 
-void handle_CPX(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
+// Shared by CMP, CPX and CPY
+CPU_INLINE void compare(Cpu* cpu, uint8_t reg, uint8_t value) {
+    uint16_t result = (uint16_t)reg - (uint16_t)value;
 
-    uint16_t address = 0;
-    uint8_t value = fetch_operand(cpu, opcode_table[opcode].addressing_mode, &address);
-
-    uint16_t result = (uint16_t)cpu->X - (uint16_t)value;
-
-    set_carry_flag(cpu, cpu->X >= value);
-    set_zero_flag(cpu, (result & 0x00FF) == 0x0000);
-    set_negative_flag(cpu, result & 0x0080);
+    set_carry_flag(cpu, reg >= value);
+    set_nz_flags(cpu, result & 0x00FF);
 }
 
-void handle_CPY(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
-
-    uint16_t address = 0;
-    uint8_t value = fetch_operand(cpu, opcode_table[opcode].addressing_mode, &address);
+CPU_INLINE void handle_CMP(Cpu* cpu, AddressingMode mode, uint16_t address) {
+    compare(cpu, cpu->A, read_operand(cpu, mode, address));
+}
 
-    uint16_t result = (uint16_t)cpu->Y - (uint16_t)value;
+CPU_INLINE void handle_CPX(Cpu* cpu, AddressingMode mode, uint16_t address) {
+    compare(cpu, cpu->X, read_operand(cpu, mode, address));
+}
 
-    set_carry_flag(cpu, cpu->Y >= value);
-    set_zero_flag(cpu, (result & 0x00FF) == 0x0000);
-    set_negative_flag(cpu, result & 0x0080);
+CPU_INLINE void handle_CPY(Cpu* cpu, AddressingMode mode, uint16_t address) {
+    compare(cpu, cpu->Y, read_operand(cpu, mode, address));
 }
 
-void handle_INC(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
+CPU_INLINE void handle_INC(Cpu* cpu, AddressingMode mode, uint16_t address) {
+    uint8_t temp = read_operand(cpu, mode, address) + 1;
 
-    AddressingMode mode = opcode_table[opcode].addressing_mode;
-    uint16_t address = 0;
-    uint8_t value = fetch_operand(cpu, mode, &address);
-    uint8_t temp;
-
-    temp = value + 1;
-    bus_write(cpu->bus, address, temp & 0x00FF);
-    set_zero_flag(cpu, (temp & 0x00FF) == 0x0000);
-    set_negative_flag(cpu, temp & 0x0080);
-
-    // Check page crossing
-    if (mode == ABX) {
-        uint16_t base = address - cpu->X;
-        if (page_crossed(base, address)) cpu->cycles_left += 1;
-    }
+    write_operand(cpu, mode, address, temp & 0x00FF);
+    set_nz_flags(cpu, temp);
 }
 
-void handle_INX(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
-
+CPU_INLINE void handle_INX(Cpu* cpu, AddressingMode mode, uint16_t address) {
     cpu->X++;
-    set_zero_flag(cpu, cpu->X == 0x00);
-    set_negative_flag(cpu, cpu->X & 0x80);
+    set_nz_flags(cpu, cpu->X);
 }
 
-void handle_INY(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
-
+CPU_INLINE void handle_INY(Cpu* cpu, AddressingMode mode, uint16_t address) {
     cpu->Y++;
-    set_zero_flag(cpu, cpu->Y == 0x00);
-    set_negative_flag(cpu, cpu->Y & 0x80);
+    set_nz_flags(cpu, cpu->Y);
 }
 
-void handle_DEC(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
+CPU_INLINE void handle_DEC(Cpu* cpu, AddressingMode mode, uint16_t address) {
+    uint8_t temp = read_operand(cpu, mode, address) - 1;
 
-    AddressingMode mode = opcode_table[opcode].addressing_mode;
-    uint16_t address = 0;
-    uint8_t value = fetch_operand(cpu, mode, &address);
-    uint8_t temp;
-
-    temp = value - 1;
-    bus_write(cpu->bus, address, temp & 0x00FF);
-    set_zero_flag(cpu, (temp & 0x00FF) == 0x0000);
-    set_negative_flag(cpu, temp & 0x0080);
-
-    // Check page crossing
-    if (mode == ABX) {
-        uint16_t base = address - cpu->X;
-        if (page_crossed(base, address)) cpu->cycles_left += 1;
-    }
+    write_operand(cpu, mode, address, temp & 0x00FF);
+    set_nz_flags(cpu, temp);
 }
 
-void handle_DEX(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
-
+CPU_INLINE void handle_DEX(Cpu* cpu, AddressingMode mode, uint16_t address) {
     cpu->X--;
-    set_zero_flag(cpu, cpu->X == 0x00);
-    set_negative_flag(cpu, cpu->X & 0x80);
+    set_nz_flags(cpu, cpu->X);
 }
 
-void handle_DEY(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
-
+CPU_INLINE void handle_DEY(Cpu* cpu, AddressingMode mode, uint16_t address) {
     cpu->Y--;
-    set_zero_flag(cpu, cpu->Y == 0x00);
-    set_negative_flag(cpu, cpu->Y & 0x80);
+    set_nz_flags(cpu, cpu->Y);
 }
 
-void handle_ASL(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
+// Shifts operate on the accumulator (ACC) or on memory (read, modify, write back)
+CPU_INLINE uint8_t shift_operand(Cpu* cpu, AddressingMode mode, uint16_t address) {
+    return (mode == ACC) ? cpu->A : read_operand(cpu, mode, address);
+}
 
-    uint16_t address = 0;
-    uint8_t value;
-    bool is_accumulator = false;
-    AddressingMode mode = opcode_table[opcode].addressing_mode;
+CPU_INLINE void shift_result(Cpu* cpu, AddressingMode mode, uint16_t address, uint8_t value) {
+    set_nz_flags(cpu, value);
 
     if (mode == ACC) {
-        value = cpu->A;
-        is_accumulator = true;
-    } else {
-        value = fetch_operand(cpu, mode, &address);
-    }
-
-    set_carry_flag(cpu, (value & 0x80) != 0);
-
-    value <<= 1;
-    set_zero_flag(cpu, value == 0x00);
-    set_negative_flag(cpu, value & 0x80);
-
-    if (is_accumulator) {
         cpu->A = value;
     } else {
-        bus_write(cpu->bus, address, value);
+        write_operand(cpu, mode, address, value);
     }
 }
 
-void handle_LSR(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
+CPU_INLINE void handle_ASL(Cpu* cpu, AddressingMode mode, uint16_t address) {
+    uint8_t value = shift_operand(cpu, mode, address);
 
-    uint16_t address = 0;
-    uint8_t value;
-    uint8_t temp;
-    bool is_accumulator = false;
-    AddressingMode mode = opcode_table[opcode].addressing_mode;
+    set_carry_flag(cpu, (value & 0x80) != 0);
+    shift_result(cpu, mode, address, value << 1);
+}
 
-    if (mode == ACC) {
-        value = cpu->A;
-        is_accumulator = true;
-    } else {
-        value = fetch_operand(cpu, mode, &address);
-    }
+CPU_INLINE void handle_LSR(Cpu* cpu, AddressingMode mode, uint16_t address) {
+    uint8_t value = shift_operand(cpu, mode, address);
 
     set_carry_flag(cpu, value & 0x01);
-
-    temp = value >> 1;
-    set_zero_flag(cpu, (temp & 0x00FF) == 0x0000);
-    set_negative_flag(cpu, temp & 0x0080);
-
-    if (is_accumulator) {
-        cpu->A = temp & 0x00FF;
-    } else {
-        bus_write(cpu->bus, address, temp & 0x00FF);
-    }
+    shift_result(cpu, mode, address, value >> 1);
 }
 
-void handle_ROL(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
-
-    uint16_t address = 0;
-    uint8_t value;
-    bool is_accumulator = false;
-    AddressingMode mode = opcode_table[opcode].addressing_mode;
-
-    if (mode == ACC) {
-        value = cpu->A;
-        is_accumulator = true;
-    } else {
-        value = fetch_operand(cpu, mode, &address);
-    }
+CPU_INLINE void handle_ROL(Cpu* cpu, AddressingMode mode, uint16_t address) {
+    uint8_t value = shift_operand(cpu, mode, address);
 
-    uint8_t carry_in = (cpu->STATUS & FLAG_CARRY) ? 1 : 0;
+    uint8_t carry_in = get_flag(cpu, FLAG_CARRY) ? 1 : 0;
     set_carry_flag(cpu, (value & 0x80) != 0);
-
-    value = (value << 1) | carry_in;
-    set_zero_flag(cpu, value == 0x00);
-    set_negative_flag(cpu, value & 0x80);
-
-    if (is_accumulator) {
-        cpu->A = value;
-    } else {
-        bus_write(cpu->bus, address, value);
-    }
+    shift_result(cpu, mode, address, (value << 1) | carry_in);
 }
 
-void handle_ROR(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
+CPU_INLINE void handle_ROR(Cpu* cpu, AddressingMode mode, uint16_t address) {
+    uint8_t value = shift_operand(cpu, mode, address);
 
-    uint16_t address = 0;
-    uint8_t value;
-    bool is_accumulator = false;
-    AddressingMode mode = opcode_table[opcode].addressing_mode;
-
-    if (mode == ACC) {
-        value = cpu->A;
-        is_accumulator = true;
-    } else {
-        value = fetch_operand(cpu, mode, &address);
-    }
-
-    uint8_t carry_in = (cpu->STATUS & FLAG_CARRY) ? 0x80 : 0;
+    uint8_t carry_in = get_flag(cpu, FLAG_CARRY) ? 0x80 : 0;
     set_carry_flag(cpu, (value & 0x01) != 0);
-
-    value = (value >> 1) | carry_in;
-    set_zero_flag(cpu, value == 0x00);
-    set_negative_flag(cpu, value & 0x80);
-
-    if (is_accumulator) {
-        cpu->A = value;
-    } else {
-        bus_write(cpu->bus, address, value);
-    }
+    shift_result(cpu, mode, address, (value >> 1) | carry_in);
 }
 
-void handle_JMP(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
-
-    AddressingMode mode = opcode_table[opcode].addressing_mode;
-    
-    if (mode == ABS) {
-        uint16_t addr = bus_read(cpu->bus, cpu->PC++) | (bus_read(cpu->bus, cpu->PC++) << 8);
-        cpu->PC = addr;
-
-    } else if (mode == IND) {
-        uint16_t ptr = bus_read(cpu->bus, cpu->PC++) | (bus_read(cpu->bus, cpu->PC++) << 8);
-        uint16_t addr;
-        if ((ptr & 0x00FF) == 0x00FF) {
-            addr = bus_read(cpu->bus, ptr) | (bus_read(cpu->bus, ptr & 0xFF00) << 8);
+CPU_INLINE void handle_JMP(Cpu* cpu, AddressingMode mode, uint16_t address) {
+    if (mode == IND) {
+        // 'address' is the pointer, the 6502 doesn't carry into the high byte when fetching through it
+        if ((address & 0x00FF) == 0x00FF) {
+            cpu->PC = read_memory(cpu, address) | (read_memory(cpu, address & 0xFF00) << 8);
         } else {
-            addr = bus_read(cpu->bus, ptr) | (bus_read(cpu->bus, ptr + 1) << 8);
+            cpu->PC = read_memory(cpu, address) | (read_memory(cpu, address + 1) << 8);
         }
-        cpu->PC = addr;
-
     } else {
-        printf("JMP encountered with unsupported addressing mode: %d\n", mode);
-        cpu->running = false;
+        cpu->PC = address;
     }
     // JMP does not have variable cycle additions based on conditions
 }
 
-void handle_JSR(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
-
-    uint16_t addr = bus_read(cpu->bus, cpu->PC++) | (bus_read(cpu->bus, cpu->PC++) << 8);
+CPU_INLINE void handle_JSR(Cpu* cpu, AddressingMode mode, uint16_t address) {
     uint16_t return_addr = cpu->PC - 1;
     push_stack(cpu, (return_addr >> 8) & 0xFF);
     push_stack(cpu, return_addr & 0xFF);
-    cpu->PC = addr;
+    cpu->PC = address;
     // JSR no extra conditional cycles
 }
 
-void handle_RTS(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
-
+CPU_INLINE void handle_RTS(Cpu* cpu, AddressingMode mode, uint16_t address) {
     uint8_t low = pull_stack(cpu);
     uint8_t high = pull_stack(cpu);
     uint16_t return_addr = (high << 8) | low;
@@ -1595,150 +1121,79 @@ void handle_RTS(Cpu* cpu, uint8_t opcode) {
     // RTS no extra conditional cycles
 }
 
-// Branches (subtract cycles if branch taken and possibly if page crossed)
-void handle_BCC(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
-
-    int8_t offset = (int8_t)bus_read(cpu->bus, cpu->PC++);
-
-    if (!(cpu->STATUS & FLAG_CARRY)) {
+// Branches (add a cycle if branch taken, and another if it lands on a different page)
+CPU_INLINE void branch(Cpu* cpu, bool condition, uint16_t address) {
+    if (condition) {
         uint16_t old_pc = cpu->PC;
-        cpu->PC += offset;
+        cpu->PC = address;
         cpu->cycles_left += 1; // branch taken
         if (page_crossed(old_pc, cpu->PC)) cpu->cycles_left += 1;
     }
 }
 
-void handle_BCS(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
-
-    int8_t offset = (int8_t)bus_read(cpu->bus, cpu->PC++);
-
-    if (cpu->STATUS & FLAG_CARRY) {
-        uint16_t old_pc = cpu->PC;
-        cpu->PC += offset;
-        cpu->cycles_left += 1;
-        if (page_crossed(old_pc, cpu->PC)) cpu->cycles_left += 1;
-    }
+CPU_INLINE void handle_BCC(Cpu* cpu, AddressingMode mode, uint16_t address) {
+    branch(cpu, !get_flag(cpu, FLAG_CARRY), address);
 }
 
-void handle_BEQ(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
-
-    int8_t offset = (int8_t)bus_read(cpu->bus, cpu->PC++);
-
-
-    if (cpu->STATUS & FLAG_ZERO) {
-        uint16_t old_pc = cpu->PC;
-        cpu->PC += offset;
-        cpu->cycles_left += 1;
-        if (page_crossed(old_pc, cpu->PC)) cpu->cycles_left += 1;
-    }
+CPU_INLINE void handle_BCS(Cpu* cpu, AddressingMode mode, uint16_t address) {
+    branch(cpu, get_flag(cpu, FLAG_CARRY), address);
 }
 
-void handle_BMI(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
-
-    int8_t offset = (int8_t)bus_read(cpu->bus, cpu->PC++);
-
-    if (cpu->STATUS & FLAG_NEGATIVE) {
-        uint16_t old_pc = cpu->PC;
-        cpu->PC += offset;
-        cpu->cycles_left += 1;
-        if (page_crossed(old_pc, cpu->PC)) cpu->cycles_left += 1;
-    }
+CPU_INLINE void handle_BEQ(Cpu* cpu, AddressingMode mode, uint16_t address) {
+    branch(cpu, get_flag(cpu, FLAG_ZERO), address);
 }
 
-void handle_BNE(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
-    
-    int8_t offset = (int8_t)bus_read(cpu->bus, cpu->PC++);
-
-    if (!(cpu->STATUS & FLAG_ZERO)) {
-        uint16_t old_pc = cpu->PC;
-        cpu->PC += offset;
-        cpu->cycles_left += 1;
-        if (page_crossed(old_pc, cpu->PC)) cpu->cycles_left += 1;
-    }
+CPU_INLINE void handle_BMI(Cpu* cpu, AddressingMode mode, uint16_t address) {
+    branch(cpu, get_flag(cpu, FLAG_NEGATIVE), address);
 }
 
-void handle_BPL(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
-
-    int8_t offset = (int8_t)bus_read(cpu->bus, cpu->PC++);
-
-    if (!(cpu->STATUS & FLAG_NEGATIVE)) {
-        uint16_t old_pc = cpu->PC;
-        cpu->PC += offset;
-        cpu->cycles_left += 1;
-        if (page_crossed(old_pc, cpu->PC)) cpu->cycles_left += 1;
-    }
+CPU_INLINE void handle_BNE(Cpu* cpu, AddressingMode mode, uint16_t address) {
+    branch(cpu, !get_flag(cpu, FLAG_ZERO), address);
 }
 
-void handle_BVC(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
-
-    int8_t offset = (int8_t)bus_read(cpu->bus, cpu->PC++);
-
-    if (!(cpu->STATUS & FLAG_OVERFLOW)) {
-        uint16_t old_pc = cpu->PC;
-        cpu->PC += offset;
-        cpu->cycles_left += 1;
-        if (page_crossed(old_pc, cpu->PC)) cpu->cycles_left += 1;
-    }
+CPU_INLINE void handle_BPL(Cpu* cpu, AddressingMode mode, uint16_t address) {
+    branch(cpu, !get_flag(cpu, FLAG_NEGATIVE), address);
 }
 
-void handle_BVS(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
-
-    int8_t offset = (int8_t)bus_read(cpu->bus, cpu->PC++);
+CPU_INLINE void handle_BVC(Cpu* cpu, AddressingMode mode, uint16_t address) {
+    branch(cpu, !get_flag(cpu, FLAG_OVERFLOW), address);
+}
 
-    if (cpu->STATUS & FLAG_OVERFLOW) {
-        uint16_t old_pc = cpu->PC;
-        cpu->PC += offset;
-        cpu->cycles_left += 1;
-        if (page_crossed(old_pc, cpu->PC)) cpu->cycles_left += 1;
-    }
+CPU_INLINE void handle_BVS(Cpu* cpu, AddressingMode mode, uint16_t address) {
+    branch(cpu, get_flag(cpu, FLAG_OVERFLOW), address);
 }
 
-void handle_CLC(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
+CPU_INLINE void handle_CLC(Cpu* cpu, AddressingMode mode, uint16_t address) {
     set_carry_flag(cpu, false);
 }
 
-void handle_CLD(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
+CPU_INLINE void handle_CLD(Cpu* cpu, AddressingMode mode, uint16_t address) {
     set_decimal_flag(cpu, false);
 }
 
-void handle_CLI(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
+CPU_INLINE void handle_CLI(Cpu* cpu, AddressingMode mode, uint16_t address) {
+    delay_interrupt_flag(cpu);
     set_interrupt_flag(cpu, false);
 }
 
-void handle_CLV(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
+CPU_INLINE void handle_CLV(Cpu* cpu, AddressingMode mode, uint16_t address) {
     set_overflow_flag(cpu, false);
 }
 
-void handle_SEC(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
+CPU_INLINE void handle_SEC(Cpu* cpu, AddressingMode mode, uint16_t address) {
     set_carry_flag(cpu, true);
 }
 
-void handle_SED(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
+CPU_INLINE void handle_SED(Cpu* cpu, AddressingMode mode, uint16_t address) {
     set_decimal_flag(cpu, true);
 }
 
-void handle_SEI(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
+CPU_INLINE void handle_SEI(Cpu* cpu, AddressingMode mode, uint16_t address) {
+    delay_interrupt_flag(cpu);
     set_interrupt_flag(cpu, true);
 }
 
-void handle_BRK(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
-
+CPU_INLINE void handle_BRK(Cpu* cpu, AddressingMode mode, uint16_t address) {
     cpu->PC++;
 
     set_interrupt_flag(cpu, true);
@@ -1746,73 +1201,294 @@ void handle_BRK(Cpu* cpu, uint8_t opcode) {
     push_stack(cpu, cpu->PC & 0xFF);
 
     set_break_flag(cpu, true);
-    push_stack(cpu, cpu->STATUS);
+    push_stack(cpu, cpu_get_status(cpu));
     set_break_flag(cpu, false);
 
-    cpu->PC = (uint16_t)bus_read(cpu->bus, 0xFFFE) | ((uint16_t)bus_read(cpu->bus, 0xFFFF) << 8);
+    cpu->PC = (uint16_t)read_memory(cpu, 0xFFFE) | ((uint16_t)read_memory(cpu, 0xFFFF) << 8);
 }
 
-void handle_RTI(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
-
-    cpu->STATUS = pull_stack(cpu);
-    cpu->STATUS &= ~FLAG_BREAK;
-    cpu->STATUS &= ~FLAG_UNUSED;
+CPU_INLINE void handle_RTI(Cpu* cpu, AddressingMode mode, uint16_t address) {
+    cpu_set_status(cpu, pull_stack(cpu) & ~(FLAG_BREAK | FLAG_UNUSED));
     
     uint8_t low = pull_stack(cpu);
     uint8_t high = pull_stack(cpu);
     cpu->PC = (high << 8) | low;
 }
 
-void handle_NOP(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
+CPU_INLINE void handle_NOP(Cpu* cpu, AddressingMode mode, uint16_t address) {
     // NOP does nothing else :0)
 }
 
 // Empty functions for prospective possible implementation of some unofficial/illegal opcodes:
 // NOTE: These aren't important for most, if not all, commercial NES games, but seem to be for some homebrew implementations...
     // Therefore, however, this is not too importnat to me unless I find myself with excess time (unlikely)
-void handle_LAX(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
-
+// (Their operand bytes are still skipped by 'fetch_operand', so execution carries on with the next instruction)
+CPU_INLINE void handle_LAX(Cpu* cpu, AddressingMode mode, uint16_t address) {
 }
 
-void handle_SAX(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
+CPU_INLINE void handle_SAX(Cpu* cpu, AddressingMode mode, uint16_t address) {
+}
 
+CPU_INLINE void handle_DCP(Cpu* cpu, AddressingMode mode, uint16_t address) {
 }
 
-void handle_DCP(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
+CPU_INLINE void handle_ISB(Cpu* cpu, AddressingMode mode, uint16_t address) {
+}
 
+CPU_INLINE void handle_SLO(Cpu* cpu, AddressingMode mode, uint16_t address) {
 }
 
-void handle_ISB(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
+CPU_INLINE void handle_RLA(Cpu* cpu, AddressingMode mode, uint16_t address) {
+}
 
+CPU_INLINE void handle_SRE(Cpu* cpu, AddressingMode mode, uint16_t address) {
 }
 
-void handle_SLO(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
+CPU_INLINE void handle_RRA(Cpu* cpu, AddressingMode mode, uint16_t address) {
+}
 
+CPU_INLINE void handle_SBC_EB(Cpu* cpu, AddressingMode mode, uint16_t address) {
 }
 
-void handle_RLA(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
+// Execution profiler (build with -DCPU_PROFILE), counts executions and cycles per opcode, and how often
+// an opcode took more than its listed cycles (page-cross penalties, and for branches taken/crossing)
+// Without it 'PROFILE_BEGIN'/'PROFILE_END' expand to nothing
+#ifdef CPU_PROFILE
+typedef struct ProfileEntry {
+    unsigned long long executions;
+    unsigned long long cycles;
+    unsigned long long penalties;       // Executions that took more than the listed cycles
+    unsigned long long penalty_cycles;  // Cycles over the listed ones
+} ProfileEntry;
 
-}
+static ProfileEntry profile[256];
+
+#define PROFILE_BEGIN(cpu) int profile_cycles_before = (cpu)->cycles_left;
+#define PROFILE_END(cpu, opcode, listed_cycles) { \
+        int profile_taken = (cpu)->cycles_left - profile_cycles_before; \
+        profile[opcode].executions++; \
+        profile[opcode].cycles += profile_taken; \
+        profile[opcode].penalties += (profile_taken > (listed_cycles)); \
+        profile[opcode].penalty_cycles += profile_taken - (listed_cycles); \
+    }
+#else
+#define PROFILE_BEGIN(cpu)
+#define PROFILE_END(cpu, opcode, listed_cycles)
+#endif
+
+// Instruction trace (build with -DCPU_TRACE), records every instruction before it runs (see Trace.h)
+#ifdef CPU_TRACE
+#define TRACE_INSTRUCTION(cpu) trace_instruction((cpu)->trace, (cpu));
+#else
+#define TRACE_INSTRUCTION(cpu)
+#endif
+
+// Per-opcode handlers, each one an instruction handler specialised for the opcode's addressing mode,
+// with the cycle count and page-cross penalty known at compile time
+// 'dop_XX' runs an already decoded instruction (see BlockCache.h), 'op_XX' fetches its operand from PC first
+#define X(op, instr, mode, cycles, page_penalty) \
+    CPU_INLINE void dop_##op(Cpu* cpu, uint16_t operand) { \
+        PROFILE_BEGIN(cpu) \
+        cpu->cycles_left += cycles; \
+        handle_##instr(cpu, mode, resolve_address(cpu, mode, page_penalty, operand)); \
+        PROFILE_END(cpu, op, cycles) \
+    } \
+    CPU_INLINE void op_##op(Cpu* cpu) { \
+        dop_##op(cpu, fetch_operand(cpu, mode)); \
+    }
+CPU_OPCODES(X)
+#undef X
 
-void handle_SRE(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
+// Any opcode not in the list (see 'opcode_table')
+CPU_INLINE void dop_unlisted(Cpu* cpu, uint16_t operand) {
+    cpu->cycles_left += 2;
+    handle_NOP(cpu, IMP, 0);
+}
 
+CPU_INLINE void op_unlisted(Cpu* cpu) {
+    dop_unlisted(cpu, 0);
 }
 
-void handle_RRA(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
+const DecodedHandler decoded_handlers[256] = {
+    [0 ... 255] = dop_unlisted,
+#define X(op, instr, mode, cycles, page_penalty) [op] = dop_##op,
+    CPU_OPCODES(X)
+#undef X
+};
 
+// GCC and Clang support 'labels as values', so with -DCPU_COMPUTED_GOTO the dispatch is a single computed goto into
+// a copy of each handler inlined in 'cpu_step', rather than an indirect call through 'opcode_handlers'.
+// Not the default: with the block cache running almost everything, the two measure the same on 'make bench-cpu'.
+#if defined(CPU_COMPUTED_GOTO) && !defined(__GNUC__) && !defined(__clang__)
+#error "CPU_COMPUTED_GOTO needs GCC or Clang (labels as values)"
+#endif
+
+#ifndef CPU_COMPUTED_GOTO
+// Opcode dispatch table, indexed directly by the opcode byte
+static void (*const opcode_handlers[256])(Cpu* cpu) = {
+    [0 ... 255] = op_unlisted,
+#define X(op, instr, mode, cycles, page_penalty) [op] = op_##op,
+    CPU_OPCODES(X)
+#undef X
+};
+#endif
+
+#ifdef CPU_BLOCK_CACHE
+// The decoded op for PC, following on through the current block or looking up (decoding) the next one
+CPU_INLINE const DecodedOp* fetch_decoded(Cpu* cpu) {
+    BlockCache* cache = cpu->block_cache;
+    const DecodedOp* op = cache->next;
+    if (!op || op->pc != cpu->PC) {
+        op = block_cache_lookup(cache, cpu->bus, cpu->PC);
+        if (!op) {
+            return NULL;
+        }
+    }
+    // Set before the instruction runs, so a write that invalidates the cache can clear it
+    cache->next = op + 1;
+    return op;
+}
+#endif
+
+// Run one whole instruction, returning the number of CPU cycles it took
+int cpu_step(Cpu* cpu) {
+    TRACE_INSTRUCTION(cpu)
+
+#ifdef CPU_BLOCK_CACHE
+    const DecodedOp* decoded = fetch_decoded(cpu);
+    if (decoded) {
+        cpu->cycles_left = 0;
+        cpu->PC = decoded->next_pc;
+        decoded->handler(cpu, decoded->operand);
+        cpu->cycle_count += cpu->cycles_left;
+        return cpu->cycles_left;
+    }
+#endif
+
+    // Not cacheable code, fetch and dispatch straight from the code page
+    uint8_t opcode = fetch_byte(cpu);
+
+    // NOTE: The opcode handlers add the instruction's cycles (plus any penalties) to cpu->cycles_left
+    cpu->cycles_left = 0;
+#ifdef CPU_COMPUTED_GOTO
+    static void* const dispatch[256] = {
+        [0 ... 255] = &&op_unlisted,
+#define X(op, instr, mode, cycles, page_penalty) [op] = &&op_##op,
+        CPU_OPCODES(X)
+#undef X
+    };
+    goto *dispatch[opcode];
+
+#define X(op, instr, mode, cycles, page_penalty) op_##op: op_##op(cpu); goto dispatched;
+    CPU_OPCODES(X)
+#undef X
+    op_unlisted: op_unlisted(cpu); goto dispatched;
+dispatched:
+#else
+    opcode_handlers[opcode](cpu);
+#endif
+
+    cpu->cycle_count += cpu->cycles_left;
+    return cpu->cycles_left;
+}
+
+#ifdef CPU_JIT
+// Run a compiled block when PC enters one, as long as it is guaranteed to finish within 'max_cycles'
+// Blocks are counted on every entry and compiled once they're hot (see Jit.h)
+int cpu_run_block(Cpu* cpu, int max_cycles) {
+    BlockCache* cache = cpu->block_cache;
+    const DecodedOp* next = cache->next;
+    if (cpu->jit && cpu->PC >= 0x8000 && (!next || next->pc != cpu->PC)) {
+        Block* block = block_cache_block(cache, cpu->bus, cpu->PC);
+        if (block) {
+            if (block->jit_state == JIT_NONE && ++block->hits >= JIT_HOT_THRESHOLD) {
+                jit_compile(cpu->jit, cache, cpu->bus, block);
+            }
+            if (block->jit_state == JIT_COMPILED && block->max_cycles <= max_cycles &&
+                block->generation == cache->generation[BLOCK_SOURCE_PRG]) {
+                cpu->cycles_left = 0;
+                block->native(cpu);
+                cache->next = NULL;
+                cpu->jit->blocks_run++;
+                cpu->cycle_count += cpu->cycles_left;
+                return cpu->cycles_left;
+            }
+            // Let 'cpu_step' carry on through the block without looking it up again
+            if (block->generation == cache->generation[BLOCK_SOURCE_PRG]) {
+                cache->next = &block->ops[0];
+            }
+        }
+    }
+    return cpu_step(cpu);
 }
+#endif
 
-void handle_SBC_EB(Cpu* cpu, uint8_t opcode) {
-    cpu->cycles_left += opcode_table[opcode].cycles;
+// Main CPU Clock function (one cycle at a time, the instruction itself runs on its first cycle)
+void cpu_clock(Cpu* cpu, bool run_debug, int frame_num) {
+    if (cpu->cycles_left == 0) {
+        cpu_step(cpu);
+    }
+    cpu->cycles_left--;
+}
+
+#ifdef CPU_PROFILE
+static int compare_profile_cycles(const void* a, const void* b) {
+    unsigned long long ca = profile[*(const int*)a].cycles;
+    unsigned long long cb = profile[*(const int*)b].cycles;
+    return (ca < cb) - (ca > cb);
+}
+
+void cpu_profile_report(FILE* out) {
+    unsigned long long total_executions = 0;
+    unsigned long long total_cycles = 0;
+    ProfileEntry modes[ADDRESSING_MODE_COUNT] = {0};
+    int order[256];
+    for (int op = 0; op < 256; op++) {
+        AddressingMode mode = opcode_table[op].addressing_mode;
+        modes[mode].executions += profile[op].executions;
+        modes[mode].cycles += profile[op].cycles;
+        modes[mode].penalties += profile[op].penalties;
+        modes[mode].penalty_cycles += profile[op].penalty_cycles;
+        total_executions += profile[op].executions;
+        total_cycles += profile[op].cycles;
+        order[op] = op;
+    }
+    if (total_executions == 0) {
+        fprintf(out, "CPU profile: nothing executed\n");
+        return;
+    }
+    qsort(order, 256, sizeof(int), compare_profile_cycles);
+
+    fprintf(out, "CPU profile: %llu instructions, %llu cycles\n", total_executions, total_cycles);
+    fprintf(out, "(penalties: executions over the listed cycles, page crossed or branch taken)\n\n");
+    fprintf(out, "By opcode (most cycles first):\n");
+    fprintf(out, "  OP  INSTR MODE  %14s %7s %14s %7s %14s %7s %14s\n",
+            "executions", "%", "cycles", "%", "penalties", "% exec", "extra cycles");
+    for (int i = 0; i < 256 && profile[order[i]].executions; i++) {
+        int op = order[i];
+        ProfileEntry* e = &profile[op];
+        fprintf(out, "  %02X  %s   %-4s  %14llu %6.2f%% %14llu %6.2f%% %14llu %6.2f%% %14llu\n", op,
+                InstructionStrings[opcode_table[op].instruction], AddressModeStrings[opcode_table[op].addressing_mode],
+                e->executions, 100.0 * e->executions / total_executions,
+                e->cycles, 100.0 * e->cycles / total_cycles,
+                e->penalties, 100.0 * e->penalties / e->executions, e->penalty_cycles);
+    }
 
-}
\ No newline at end of file
+    fprintf(out, "\nBy addressing mode:\n");
+    fprintf(out, "  MODE  %14s %7s %14s %7s %14s %7s %14s\n",
+            "executions", "%", "cycles", "%", "penalties", "% exec", "extra cycles");
+    for (int mode = 0; mode < ADDRESSING_MODE_COUNT; mode++) {
+        ProfileEntry* e = &modes[mode];
+        if (e->executions) {
+            fprintf(out, "  %-4s  %14llu %6.2f%% %14llu %6.2f%% %14llu %6.2f%% %14llu\n", AddressModeStrings[mode],
+                    e->executions, 100.0 * e->executions / total_executions,
+                    e->cycles, 100.0 * e->cycles / total_cycles,
+                    e->penalties, 100.0 * e->penalties / e->executions, e->penalty_cycles);
+        }
+    }
+}
+
+void cpu_profile_reset() {
+    memset(profile, 0, sizeof(profile));
+}
+#endif
@@ -5,6 +5,11 @@
 #pragma once
 
 #include "Bus.h"
+#include "BlockCache.h"
+#include "Jit.h"
+#include "IdleLoop.h"
+#include "Interrupts.h"
+#include "Trace.h"
 #include <stdint.h>
 #include <stdbool.h>
 #include <time.h>
@@ -24,7 +29,32 @@
 #define FLAG_OVERFLOW           0x40
 #define FLAG_NEGATIVE           0x80
 
+// Lazy flags: N, Z, C and V are kept as the inputs that produced them and only packed into
+// 'STATUS' when something reads the whole register (PHP, BRK, interrupts, debug output)
+// Build with -DCPU_NO_LAZY_FLAGS to have every instruction update 'STATUS' directly instead
+#ifndef CPU_NO_LAZY_FLAGS
+#define CPU_LAZY_FLAGS
+#endif
+
+// Decoded block cache: instructions in PRG/RAM are fetched from pre-decoded blocks (see BlockCache.h)
+// Build with -DCPU_NO_BLOCK_CACHE to fetch every instruction through the bus instead
+#ifndef CPU_NO_BLOCK_CACHE
+#define CPU_BLOCK_CACHE
+#endif
+
+#define CODE_PAGE_NONE 0xFFFF  // 'code_page_number' that never matches a real page
+
+// Idle loops: trips round a loop polling memory that can't change yet are skipped (see IdleLoop.h)
+// Build with -DCPU_NO_IDLE_SKIP to interpret every trip instead
+#ifndef CPU_NO_IDLE_SKIP
+#define CPU_IDLE_SKIP
+#endif
+
+#define CPU_CACHE_LINE 64       // The hot state below fits in one of these (see 'init_cpu')
+
 // CPU Structure
+// Everything an instruction touches comes first and fits in one cache line (the Cpu is allocated aligned
+// to one), anything only looked at between instructions, or less, comes after
 typedef struct Cpu {
     // CPU Registers
     uint8_t A;          // Accumulator
@@ -32,114 +62,117 @@ typedef struct Cpu {
     uint8_t Y;          // Y Register
     uint8_t SP;         // Stack Pointer
     uint16_t PC;        // Program Counter
-    uint8_t STATUS;     // STATUS Register
+    uint8_t STATUS;     // STATUS Register (use cpu_get_status/cpu_set_status, N/Z/C/V may be stale with lazy flags)
+
+#ifdef CPU_LAZY_FLAGS
+    uint8_t flag_n;     // Negative = bit 7 of this
+    uint8_t flag_z;     // Zero = this is 0
+    uint8_t flag_c;     // Carry = this is non-zero
+    uint8_t flag_v;     // Overflow = this is non-zero
+#endif
+
+    // Cycles remaining until 'finished'
+    int cycles_left;
+
+    // Cycles occured since reset
+    long long cycle_count;
+
+    // Memory map, so operands in RAM or PRG are a load away rather than a walk through bus, cartridge and mapper
+    uint8_t* ram;                   // 'bus->main_memory'
+    const uint8_t* prg_map[4];      // PRG memory behind each 8KB window of $8000-$FFFF (NULL: read through the bus)
+                                    // Refreshed whenever the cartridge could have switched banks ('cpu_map_prg')
 
-    bool running;       // Is the CPU running?
-    
     // Bus
     Bus* bus;   // Reference to the bus
 
-    // Cycles occured since reset
-    int cycle_count;
+    // Current code page: memory behind PC's 256-byte page, so instruction bytes are a plain load
+    // Re-fetched from the bus when PC leaves the page or the cartridge takes a write (see 'bus_code_page')
+    const uint8_t* code_page;       // NULL if the page has to be read through 'bus_read'
+    uint16_t code_page_number;      // PC >> 8 of 'code_page' (CODE_PAGE_NONE if not set up yet)
+    uint32_t code_page_cart_writes; // 'bus->cart_writes' when 'code_page' was looked up
 
-    // Cycles remaining until 'finished'
-    int cycles_left;
+    // Pre-decoded instructions (also referenced by the bus, which invalidates it)
+    BlockCache* block_cache;
+
+    // Interrupt polling (see Interrupts.h)
+    long long poll_dot;             // PPU dot the last instruction's final cycle started on (set by the caller)
+    long long delayed_i_cycle;      // 'cycle_count' just after the last CLI/SEI/PLP...
+    uint8_t delayed_i;              // ...and its I flag from before it changed it
+
+    // Idle loop detection (NULL if built without it)
+    IdleLoop* idle_loop;
+
+    bool running;       // Is the CPU running?
+
+#ifdef CPU_JIT
+    // Native code for hot blocks (NULL if executable memory wasn't available)
+    Jit* jit;
+#endif
+
+#ifdef CPU_TRACE
+    // Instruction trace ring (see Trace.h)
+    Trace* trace;
+#endif
 } Cpu;
 
+// Instruction list: X(mnemonic)
+// Expanded into the 'Instruction' enum and 'InstructionStrings', so the two can never disagree
+#define CPU_INSTRUCTIONS(X) \
+    /* Load/Store Operations */ \
+    X(LDA) X(LDX) X(LDY) X(STA) X(STX) X(STY) \
+    /* Register Transfers */ \
+    X(TAX) X(TAY) X(TXA) X(TYA) \
+    /* Stack Operations */ \
+    X(TSX) X(TXS) X(PHA) X(PHP) X(PLA) X(PLP) \
+    /* Logical Instructions */ \
+    X(AND) X(EOR) X(ORA) X(BIT) \
+    /* Arithmetic Instructions */ \
+    X(ADC) X(SBC) X(CMP) X(CPX) X(CPY) \
+    /* Increments & Decrements */ \
+    X(INC) X(INX) X(INY) X(DEC) X(DEX) X(DEY) \
+    /* Shifts */ \
+    X(ASL) X(LSR) X(ROL) X(ROR) \
+    /* Jumps & Calls */ \
+    X(JMP) X(JSR) X(RTS) \
+    /* Branches */ \
+    X(BCC) X(BCS) X(BEQ) X(BMI) X(BNE) X(BPL) X(BVC) X(BVS) \
+    /* Status Flag Changes */ \
+    X(CLC) X(CLD) X(CLI) X(CLV) X(SEC) X(SED) X(SEI) \
+    /* System Functions */ \
+    X(BRK) X(NOP) X(RTI) \
+    /* Illegal opcodes, rarely but sometimes used for NES processing */ \
+    X(LAX) X(SAX) X(DCP) X(ISB) X(SLO) X(RLA) X(SRE) X(RRA) X(SBC_EB)
+
+// Addressing mode list: X(mode, operand bytes)
+// Expanded into the 'AddressingMode' enum, 'AddressModeStrings' and each opcode's instruction length
+#define CPU_ADDRESSING_MODES(X) \
+    X(IMM, 1)   /* IMMEDIATE */ \
+    X(ZP0, 1)   /* ZERO_PAGE */ \
+    X(ZPX, 1)   /* ZERO_PAGE_X */ \
+    X(ZPY, 1)   /* ZERO_PAGE_Y */ \
+    X(ABS, 2)   /* ABSOLUTE */ \
+    X(ABX, 2)   /* ABSOLUTE X */ \
+    X(ABY, 2)   /* ABSOLUTE Y */ \
+    X(IND, 2)   /* INDIRECT */ \
+    X(IZX, 1)   /* INDEXED INDIRECT */ \
+    X(IZY, 1)   /* INDIRECT INDEXED */ \
+    X(REL, 1)   /* RELATIVE */ \
+    X(ACC, 0)   /* ACCUMULATOR */ \
+    X(IMP, 0)   /* IMPLIED */
+
 // Enums for instructions and addressing modes
 typedef enum Instruction {
-    // Load/Store Operations
-    LDA,
-    LDX,
-    LDY,
-    STA,
-    STX,
-    STY,
-    // Register Transfers
-    TAX,
-    TAY,
-    TXA,
-    TYA,
-    // Stack Operations
-    TSX,
-    TXS,
-    PHA,
-    PHP,
-    PLA,
-    PLP,
-    // Logical Instructions
-    AND,
-    EOR,
-    ORA,
-    BIT,
-    // Arithmetic Instructions
-    ADC,
-    SBC,
-    CMP,
-    CPX,
-    CPY,
-    // Increments & Decrements
-    INC,
-    INX,
-    INY,
-    DEC,
-    DEX,
-    DEY,
-    // Shifts
-    ASL,
-    LSR,
-    ROL,
-    ROR,
-    // Jumps & Calls
-    JMP,
-    JSR,
-    RTS,
-    // Branches
-    BCC,
-    BCS,
-    BEQ,
-    BMI,
-    BNE,
-    BPL,
-    BVC,
-    BVS,
-    // Status Flag Changes
-    CLC,
-    CLD,
-    CLI,
-    CLV,
-    SEC,
-    SED,
-    SEI,
-    // System Functions
-    BRK,
-    NOP,
-    RTI,
-    LAX,
-    SAX,
-    DCP,
-    ISB,
-    SLO,
-    RLA,
-    SRE,
-    RRA,
-    SBC_EB,
+#define X(name) name,
+    CPU_INSTRUCTIONS(X)
+#undef X
+    INSTRUCTION_COUNT
 } Instruction;
 
 typedef enum AddressingMode {
-    IMM,    // IMMEDIATE
-    ZP0,    // ZERO_PAGE
-    ZPX,    // ZERO_PAGE_X
-    ZPY,    // ZERO_PAGE_Y
-    ABS,    // ABSOLUTE
-    ABX,    // ABSOLUTE X
-    ABY,    // ABSOLUTE Y
-    IND,    // INDIRECT
-    IZX,    // INDEXED INDIRECT
-    IZY,    // INDIRECT INDEXED
-    REL,    // RELATIVE
-    ACC,    // ACCUMULATOR
-    IMP,    // IMPLIED
+#define X(name, operand_bytes) name,
+    CPU_ADDRESSING_MODES(X)
+#undef X
+    ADDRESSING_MODE_COUNT
 } AddressingMode;
 
 // Opcode structure
@@ -148,26 +181,61 @@ typedef struct Opcode {
     AddressingMode addressing_mode;
     uint8_t bytes;
     uint8_t cycles;
+    bool page_penalty;  // +1 cycle when the indexed address crosses a page
 } Opcode;
 
 // Declare the opcode_table as extern
 extern const Opcode opcode_table[256];
 
+// Declare the per-opcode decoded handlers as extern (used to build the block cache)
+extern const DecodedHandler decoded_handlers[256];
+
 // Declare a table of referrable instruction names for debug/printf
-extern const char *InstructionStrings[65];
+extern const char *InstructionStrings[INSTRUCTION_COUNT];
 
 // Delcare a table of referrable addressing modes for debug/printf
-extern const char *AddressModeStrings[13];
+extern const char *AddressModeStrings[ADDRESSING_MODE_COUNT];
 
 // Function to initialize the CPU
 Cpu* init_cpu(Bus* bus);
 
+// Function to free the CPU (and its block cache, idle loop detection and trace)
+void free_cpu(Cpu* cpu);
+
+// Function to look up the PRG memory behind $8000-$FFFF again ('prg_map'), after a bank switch or cartridge swap
+void cpu_map_prg(Cpu* cpu);
+
+// Function to run a single whole instruction, returns the number of CPU cycles it took
+int cpu_step(Cpu* cpu);
+
+#ifdef CPU_JIT
+// Function to run a whole compiled block if PC is at one and it takes no more than 'max_cycles',
+// otherwise a single instruction, returns the number of CPU cycles it took
+int cpu_run_block(Cpu* cpu, int max_cycles);
+#endif
+
 // Function to run a single CPU clock cycle
 void cpu_clock(Cpu* cpu, bool run_debug, int i);
 
 void cpu_reset(Cpu* cpu, Bus* bus);
-void cpu_nmi(Cpu* cpu, Bus* bus);
-void cpu_irq(Cpu* cpu, Bus* bus);
+int cpu_nmi(Cpu* cpu, Bus* bus);
+int cpu_irq(Cpu* cpu, Bus* bus);
+
+// Function to call between instructions, takes the interrupt the CPU polled during the last one (see Interrupts.h)
+// if there is one, returns the CPU cycles it took (0 if none)
+// NOTE: Set 'poll_dot' after every instruction/block to the PPU dot its last cycle started on
+int cpu_interrupt(Cpu* cpu);
+
+// Functions to read/write the full STATUS register (packs/unpacks any lazily kept flags)
+uint8_t cpu_get_status(Cpu* cpu);
+void cpu_set_status(Cpu* cpu, uint8_t status);
+
+#ifdef CPU_PROFILE
+// Functions to write out (sorted by cycles, per opcode and per addressing mode) and clear the execution profile
+// NOTE: Only instructions run by the interpreter are counted (not the JIT's natively compiled ones)
+void cpu_profile_report(FILE* out);
+void cpu_profile_reset();
+#endif
 
 // Function to print the state of the CPU's current state (registers)
 void print_cpu(Cpu* cpu);
@@ -175,77 +243,7 @@ void print_cpu(Cpu* cpu);
 // Function to print a single CPU instruction
 void print_instruction(Cpu* cpu, Opcode c, uint8_t n);
 
-// Declare all handle_* functions
-void handle_LDA(Cpu* cpu, uint8_t opcode);
-void handle_LDX(Cpu* cpu, uint8_t opcode);
-void handle_LDY(Cpu* cpu, uint8_t opcode);
-void handle_STA(Cpu* cpu, uint8_t opcode);
-void handle_STX(Cpu* cpu, uint8_t opcode);
-void handle_STY(Cpu* cpu, uint8_t opcode);
-void handle_TAX(Cpu* cpu, uint8_t opcode);
-void handle_TAY(Cpu* cpu, uint8_t opcode);
-void handle_TXA(Cpu* cpu, uint8_t opcode);
-void handle_TYA(Cpu* cpu, uint8_t opcode);
-void handle_TSX(Cpu* cpu, uint8_t opcode);
-void handle_TXS(Cpu* cpu, uint8_t opcode);
-void handle_PHA(Cpu* cpu, uint8_t opcode);
-void handle_PHP(Cpu* cpu, uint8_t opcode);
-void handle_PLA(Cpu* cpu, uint8_t opcode);
-void handle_PLP(Cpu* cpu, uint8_t opcode);
-void handle_AND(Cpu* cpu, uint8_t opcode);
-void handle_EOR(Cpu* cpu, uint8_t opcode);
-void handle_ORA(Cpu* cpu, uint8_t opcode);
-void handle_BIT(Cpu* cpu, uint8_t opcode);
-void handle_ADC(Cpu* cpu, uint8_t opcode);
-void handle_SBC(Cpu* cpu, uint8_t opcode);
-void handle_CMP(Cpu* cpu, uint8_t opcode);
-void handle_CPX(Cpu* cpu, uint8_t opcode);
-void handle_CPY(Cpu* cpu, uint8_t opcode);
-void handle_INC(Cpu* cpu, uint8_t opcode);
-void handle_INX(Cpu* cpu, uint8_t opcode);
-void handle_INY(Cpu* cpu, uint8_t opcode);
-void handle_DEC(Cpu* cpu, uint8_t opcode);
-void handle_DEX(Cpu* cpu, uint8_t opcode);
-void handle_DEY(Cpu* cpu, uint8_t opcode);
-void handle_ASL(Cpu* cpu, uint8_t opcode);
-void handle_LSR(Cpu* cpu, uint8_t opcode);
-void handle_ROL(Cpu* cpu, uint8_t opcode);
-void handle_ROR(Cpu* cpu, uint8_t opcode);
-void handle_JMP(Cpu* cpu, uint8_t opcode);
-void handle_JSR(Cpu* cpu, uint8_t opcode);
-void handle_RTS(Cpu* cpu, uint8_t opcode);
-void handle_BCC(Cpu* cpu, uint8_t opcode);
-void handle_BCS(Cpu* cpu, uint8_t opcode);
-void handle_BEQ(Cpu* cpu, uint8_t opcode);
-void handle_BMI(Cpu* cpu, uint8_t opcode);
-void handle_BNE(Cpu* cpu, uint8_t opcode);
-void handle_BPL(Cpu* cpu, uint8_t opcode);
-void handle_BVC(Cpu* cpu, uint8_t opcode);
-void handle_BVS(Cpu* cpu, uint8_t opcode);
-void handle_CLC(Cpu* cpu, uint8_t opcode);
-void handle_CLD(Cpu* cpu, uint8_t opcode);
-void handle_CLI(Cpu* cpu, uint8_t opcode);
-void handle_CLV(Cpu* cpu, uint8_t opcode);
-void handle_SEC(Cpu* cpu, uint8_t opcode);
-void handle_SED(Cpu* cpu, uint8_t opcode);
-void handle_SEI(Cpu* cpu, uint8_t opcode);
-void handle_BRK(Cpu* cpu, uint8_t opcode);
-void handle_NOP(Cpu* cpu, uint8_t opcode);
-void handle_RTI(Cpu* cpu, uint8_t opcode);
-// Illegal/Unofficial opcodes
-void handle_LAX(Cpu* cpu, uint8_t opcode);
-void handle_SAX(Cpu* cpu, uint8_t opcode);
-void handle_DCP(Cpu* cpu, uint8_t opcode);
-void handle_ISB(Cpu* cpu, uint8_t opcode);
-void handle_SLO(Cpu* cpu, uint8_t opcode);
-void handle_RLA(Cpu* cpu, uint8_t opcode);
-void handle_SRE(Cpu* cpu, uint8_t opcode);
-void handle_RRA(Cpu* cpu, uint8_t opcode);
-void handle_SBC_EB(Cpu* cpu, uint8_t opcode);
-
-
 // Helper functions
-uint8_t fetch_operand(Cpu* cpu, AddressingMode mode, uint16_t* address);
 void set_zero_flag(Cpu* cpu, bool set);
 void set_negative_flag(Cpu* cpu, uint8_t value);
 void set_carry_flag(Cpu* cpu, bool set);
@@ -7,6 +7,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 
 #define PRG_CHUNK_SIZE 16384
 #define CHR_CHUNK_SIZE 8192
@@ -83,11 +84,19 @@ Cartridge* init_cart(const char* filepath) {
     cart->n_prg_banks = header.prg_count;
     cart->n_chr_banks = header.chr_count;
     cart->prg_memory = createVector(PRG_CHUNK_SIZE * header.prg_count);
-    cart->chr_memory = createVector(CHR_CHUNK_SIZE * header.chr_count);
+    cart->chr_memory = createVector(CHR_CHUNK_SIZE * (header.chr_count ? header.chr_count : 1));
+    if (header.chr_count == 0) {
+        // No CHR ROM means the cartridge has 8KB of CHR RAM instead, which starts out blank
+        memset(cart->chr_memory->items, 0, CHR_CHUNK_SIZE);
+    }
 
     // Compute mapper ID and mirroring mode.
     cart->mapper_id = ((header.flag7 >> 4) << 4) | (header.flag6 >> 4);
-    cart->mirror = (header.flag6 & 0x01) ? VERTICAL : HORIZONTAL;
+    if (header.flag6 & 0x08) {
+        cart->mirror = FOUR_SCREEN;
+    } else {
+        cart->mirror = (header.flag6 & 0x01) ? VERTICAL : HORIZONTAL;
+    }
 
     // Load PRG data.
     size_t prgTotal = PRG_CHUNK_SIZE * header.prg_count;
@@ -123,6 +132,22 @@ Cartridge* init_cart(const char* filepath) {
     return cart;
 }
 
+// Helper to free a vector and its items.
+static void freeVector(Vector* vec) {
+    if (vec) {
+        free(vec->items);
+        free(vec);
+    }
+}
+
+// Frees a cartridge with its PRG/CHR memory and mapper.
+void free_cart(Cartridge* cart) {
+    freeVector(cart->prg_memory);
+    freeVector(cart->chr_memory);
+    free(cart->mapper);
+    free(cart);
+}
+
 // CPU read: translates the CPU address via the mapper and reads from PRG memory.
 bool cartridge_cpu_read(Cartridge *cart, uint16_t addr, uint8_t *data) {
     uint32_t mappedAddr = 0;
@@ -143,6 +168,54 @@ bool cartridge_cpu_write(Cartridge *cart, uint16_t addr, uint8_t data) {
     return false;
 }
 
+// CPU address lookup: translates the CPU address via the mapper without touching PRG memory.
+bool cartridge_cpu_map(Cartridge *cart, uint16_t addr, uint32_t *offset) {
+    return cart->mapper->mapper_cpu_read(cart->mapper, addr, offset) && *offset < cart->prg_memory->capacity;
+}
+
+// CPU range lookup: maps both ends of the range, the bytes between are only taken as direct if the ends land 'mask' apart.
+static const uint8_t* cpu_range(Cartridge *cart, uint16_t addr, uint16_t mask) {
+    uint32_t first = 0;
+    uint32_t last = 0;
+    if (cart->mapper->mapper_cpu_read(cart->mapper, addr & ~mask, &first) &&
+        cart->mapper->mapper_cpu_read(cart->mapper, addr | mask, &last) &&
+        last == first + mask && last < cart->prg_memory->capacity) {
+        return &cart->prg_memory->items[first];
+    }
+    return NULL;
+}
+
+// CPU page lookup: the 256-byte page holding the address.
+const uint8_t* cartridge_cpu_page(Cartridge *cart, uint16_t addr) {
+    return cpu_range(cart, addr, 0x00FF);
+}
+
+// CPU bank lookup: the 8KB window holding the address.
+const uint8_t* cartridge_cpu_bank(Cartridge *cart, uint16_t addr) {
+    return cpu_range(cart, addr, 0x1FFF);
+}
+
+// CHR range lookup: as 'cpu_range', through the mapper's PPU read or write mapping.
+static uint8_t* chr_range(Cartridge *cart, MapperMapFunc map, uint16_t addr, uint16_t mask, bool *claimed) {
+    uint32_t first = 0;
+    uint32_t last = 0;
+    *claimed = map(cart->mapper, addr & ~mask, &first);
+    if (*claimed && map(cart->mapper, addr | mask, &last) &&
+        last == first + mask && last < cart->chr_memory->capacity) {
+        return &cart->chr_memory->items[first];
+    }
+    return NULL;
+}
+
+// PPU bank lookup: the 1KB window holding the address.
+const uint8_t* cartridge_ppu_bank(Cartridge *cart, uint16_t addr, bool *claimed) {
+    return chr_range(cart, cart->mapper->mapper_ppu_read, addr, 0x03FF, claimed);
+}
+
+uint8_t* cartridge_ppu_write_bank(Cartridge *cart, uint16_t addr, bool *claimed) {
+    return chr_range(cart, cart->mapper->mapper_ppu_write, addr, 0x03FF, claimed);
+}
+
 // PPU read: translates the PPU address via the mapper and reads from CHR memory.
 bool cartridge_ppu_read(Cartridge *cart, uint16_t addr, uint8_t *data) {
     uint32_t mappedAddr = 0;
@@ -19,7 +19,10 @@ typedef struct Vector {
 
 typedef enum Mirror {
     HORIZONTAL,
-    VERTICAL
+    VERTICAL,
+    ONESCREEN_LO,   // Every nametable is the first 1KB of the PPU's VRAM
+    ONESCREEN_HI,   // Every nametable is the second 1KB of the PPU's VRAM
+    FOUR_SCREEN     // Four separate nametables (2KB of extra VRAM on the cartridge)
 } Mirror;
 
 typedef struct Cartridge {
@@ -35,10 +38,27 @@ typedef struct Cartridge {
 // Initialise the cartridge (using a '.nes' ROM file)
 Cartridge* init_cart(const char* filepath);
 
+// Free the cartridge (its PRG/CHR memory and mapper too)
+void free_cart(Cartridge* cartridge);
+
 // CPU Read/Write
 bool cartridge_cpu_read(Cartridge *cartridge, uint16_t address, uint8_t* data);
 bool cartridge_cpu_write(Cartridge *cartridge, uint16_t address, uint8_t data);
 
+// CPU address lookup: offset into PRG memory the mapper maps 'address' to (false if it isn't the cartridge's)
+bool cartridge_cpu_map(Cartridge *cartridge, uint16_t address, uint32_t* offset);
+
+// CPU page lookup: PRG memory behind the 256-byte page holding 'address', if the mapper maps it contiguously (else NULL)
+const uint8_t* cartridge_cpu_page(Cartridge *cartridge, uint16_t address);
+
+// CPU bank lookup: PRG memory behind the 8KB window holding 'address', if the mapper maps it contiguously (else NULL)
+const uint8_t* cartridge_cpu_bank(Cartridge *cartridge, uint16_t address);
+
+// PPU bank lookup: CHR memory behind the 1KB window holding 'address' for reads/writes, if the mapper maps it
+// contiguously (else NULL), '*claimed' says whether the mapper takes reads/writes there at all
+const uint8_t* cartridge_ppu_bank(Cartridge *cartridge, uint16_t address, bool* claimed);
+uint8_t* cartridge_ppu_write_bank(Cartridge *cartridge, uint16_t address, bool* claimed);
+
 // PPU Read/Write
 bool cartridge_ppu_read(Cartridge *cartridge, uint16_t address, uint8_t* data);
 bool cartridge_ppu_write(Cartridge *cartridge, uint16_t address, uint8_t data);
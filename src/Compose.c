@@ -0,0 +1,131 @@
+// Compose.c
+// Nintendo Entertainment System PPU Scanline Compositing Implementation
+#include "Compose.h"
+
+#ifdef COMPOSE_SIMD
+#include <immintrin.h>
+#endif
+
+
+int compose_line_scalar(uint32_t* row, const uint8_t* bg, const uint8_t* fg, const uint32_t* colours,
+                        bool show_bg_left, bool show_fg_left) {
+    int hit_dot = 0;
+    for (int x = 0; x < COMPOSE_WIDTH; x++) {
+        uint8_t b = (x < 8 && !show_bg_left) ? 0x00 : bg[x];
+        uint8_t f = (x < 8 && !show_fg_left) ? 0x00 : fg[x];
+        uint8_t index = b;
+        if (f) {
+            if (!b || (f & COMPOSE_SPRITE_FRONT)) {
+                index = f & 0x1F;
+            }
+            if (b && (f & COMPOSE_SPRITE_ZERO) && !hit_dot) {
+                hit_dot = x + 1;
+            }
+        }
+        row[x] = colours[index];
+    }
+    return hit_dot;
+}
+
+#ifdef COMPOSE_SIMD
+// Per byte, with all ones for true:
+//   keep_bg = no sprite pixel, or an opaque background pixel the sprite is behind
+//   hit     = opaque background pixel under sprite zero (its pixels are always opaque)
+
+__attribute__((target("sse2")))
+int compose_line_sse2(uint32_t* row, const uint8_t* bg, const uint8_t* fg, const uint32_t* colours,
+                      bool show_bg_left, bool show_fg_left) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i front = _mm_set1_epi8(COMPOSE_SPRITE_FRONT);
+    const __m128i sprite_zero = _mm_set1_epi8((char)COMPOSE_SPRITE_ZERO);
+    const __m128i palette = _mm_set1_epi8(0x1F);
+    const __m128i left = _mm_set_epi64x(0, -1);
+    int hit_dot = 0;
+    uint8_t index[16];
+    for (int x = 0; x < COMPOSE_WIDTH; x += 16) {
+        __m128i b = _mm_loadu_si128((const __m128i*)&bg[x]);
+        __m128i f = _mm_loadu_si128((const __m128i*)&fg[x]);
+        if (x == 0) {
+            b = show_bg_left ? b : _mm_andnot_si128(left, b);
+            f = show_fg_left ? f : _mm_andnot_si128(left, f);
+        }
+        __m128i bg_clear = _mm_cmpeq_epi8(b, zero);
+        __m128i fg_clear = _mm_cmpeq_epi8(f, zero);
+        __m128i behind = _mm_cmpeq_epi8(_mm_and_si128(f, front), zero);
+        __m128i keep_bg = _mm_or_si128(fg_clear, _mm_andnot_si128(bg_clear, behind));
+        __m128i pixels = _mm_or_si128(_mm_and_si128(keep_bg, b), _mm_andnot_si128(keep_bg, _mm_and_si128(f, palette)));
+        if (!hit_dot) {
+            __m128i not_zero = _mm_cmpeq_epi8(_mm_and_si128(f, sprite_zero), zero);
+            int hits = ~_mm_movemask_epi8(_mm_or_si128(bg_clear, not_zero)) & 0xFFFF;
+            if (hits) {
+                hit_dot = x + __builtin_ctz(hits) + 1;
+            }
+        }
+
+        // No gather before AVX2, the colours are looked up one at a time
+        _mm_storeu_si128((__m128i*)index, pixels);
+        for (int i = 0; i < 16; i++) {
+            row[x + i] = colours[index[i]];
+        }
+    }
+    return hit_dot;
+}
+
+__attribute__((target("avx2")))
+int compose_line_avx2(uint32_t* row, const uint8_t* bg, const uint8_t* fg, const uint32_t* colours,
+                      bool show_bg_left, bool show_fg_left) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i front = _mm256_set1_epi8(COMPOSE_SPRITE_FRONT);
+    const __m256i sprite_zero = _mm256_set1_epi8((char)COMPOSE_SPRITE_ZERO);
+    const __m256i palette = _mm256_set1_epi8(0x1F);
+    const __m256i left = _mm256_setr_epi64x(-1, 0, 0, 0);
+    int hit_dot = 0;
+    for (int x = 0; x < COMPOSE_WIDTH; x += 32) {
+        __m256i b = _mm256_loadu_si256((const __m256i*)&bg[x]);
+        __m256i f = _mm256_loadu_si256((const __m256i*)&fg[x]);
+        if (x == 0) {
+            b = show_bg_left ? b : _mm256_andnot_si256(left, b);
+            f = show_fg_left ? f : _mm256_andnot_si256(left, f);
+        }
+        __m256i bg_clear = _mm256_cmpeq_epi8(b, zero);
+        __m256i fg_clear = _mm256_cmpeq_epi8(f, zero);
+        __m256i behind = _mm256_cmpeq_epi8(_mm256_and_si256(f, front), zero);
+        __m256i keep_bg = _mm256_or_si256(fg_clear, _mm256_andnot_si256(bg_clear, behind));
+        __m256i pixels = _mm256_blendv_epi8(_mm256_and_si256(f, palette), b, keep_bg);
+        if (!hit_dot) {
+            __m256i not_zero = _mm256_cmpeq_epi8(_mm256_and_si256(f, sprite_zero), zero);
+            unsigned hits = ~(unsigned)_mm256_movemask_epi8(_mm256_or_si256(bg_clear, not_zero));
+            if (hits) {
+                hit_dot = x + __builtin_ctz(hits) + 1;
+            }
+        }
+
+        // Colours 8 pixels at a time, palette indices widened to the gather's 32-bit lanes
+        __m128i low = _mm256_castsi256_si128(pixels);
+        __m128i high = _mm256_extracti128_si256(pixels, 1);
+        _mm256_storeu_si256((__m256i*)&row[x], _mm256_i32gather_epi32((const int*)colours, _mm256_cvtepu8_epi32(low), 4));
+        _mm256_storeu_si256((__m256i*)&row[x + 8],
+                            _mm256_i32gather_epi32((const int*)colours, _mm256_cvtepu8_epi32(_mm_srli_si128(low, 8)), 4));
+        _mm256_storeu_si256((__m256i*)&row[x + 16], _mm256_i32gather_epi32((const int*)colours, _mm256_cvtepu8_epi32(high), 4));
+        _mm256_storeu_si256((__m256i*)&row[x + 24],
+                            _mm256_i32gather_epi32((const int*)colours, _mm256_cvtepu8_epi32(_mm_srli_si128(high, 8)), 4));
+    }
+    return hit_dot;
+}
+#endif
+
+ComposeLine compose_select(const char** name) {
+#ifdef COMPOSE_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        *name = "avx2";
+        return compose_line_avx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        *name = "sse2";
+        return compose_line_sse2;
+    }
+#endif
+    *name = "scalar";
+    return compose_line_scalar;
+}
@@ -0,0 +1,52 @@
+// Compose.h
+// Nintendo Entertainment System PPU Scanline Compositing (Header File)
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#if !defined(COMPOSE_NO_SIMD) && (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define COMPOSE_SIMD
+#endif
+
+/*///////SCANLINE COMPOSITING//////////////////////////////////////////////////////////////////////////
+
+The last step of the scanline renderer (see PPU_SCANLINE_RENDER): a line of background pixels and a
+line of sprite pixels merged into framebuffer colours.
+    Background  - Palette index (0-31) of each pixel, 0 where transparent
+    Sprites     - Palette index of the first opaque sprite at each pixel (0 where there is none), with
+                  COMPOSE_SPRITE_FRONT if it is in front of the background and COMPOSE_SPRITE_ZERO if
+                  it is sprite zero
+    Clipping    - The left 8 pixels of either line are left out unless PPUMASK shows them
+
+A sprite pixel wins over a transparent background pixel, or an opaque one when it is in front. Sprite
+zero over an opaque background pixel is a sprite zero hit, the kernel returns the dot of the first.
+
+The scalar kernel is the reference. On x86 there are SSE2 (16 pixels at a time) and AVX2 (32 at a
+time, colours gathered 8 at a time) kernels as well, the host CPU picks one at runtime (cpuid), and
+'make compose-check' fuzzes them against the scalar one. Build with -DCOMPOSE_NO_SIMD for the
+scalar kernel only.
+
+///////////////////////////////////////////////////////////////////////////////////////////////////*/
+
+#define COMPOSE_WIDTH           256     // Pixels in a line (PPU_SCREEN_WIDTH)
+#define COMPOSE_SPRITE_FRONT    0x40    // Sprite pixel flags
+#define COMPOSE_SPRITE_ZERO     0x80
+
+// Composites a line into 'row' using the colour of each palette index, returns the dot (1-256) of the first sprite zero
+// hit, 0 if there isn't one
+typedef int (*ComposeLine)(uint32_t* row, const uint8_t* bg, const uint8_t* fg, const uint32_t* colours,
+                           bool show_bg_left, bool show_fg_left);
+
+// The kernels
+int compose_line_scalar(uint32_t* row, const uint8_t* bg, const uint8_t* fg, const uint32_t* colours,
+                        bool show_bg_left, bool show_fg_left);
+#ifdef COMPOSE_SIMD
+int compose_line_sse2(uint32_t* row, const uint8_t* bg, const uint8_t* fg, const uint32_t* colours,
+                      bool show_bg_left, bool show_fg_left);
+int compose_line_avx2(uint32_t* row, const uint8_t* bg, const uint8_t* fg, const uint32_t* colours,
+                      bool show_bg_left, bool show_fg_left);
+#endif
+
+// Function to pick the fastest kernel the host CPU can run, with its name
+ComposeLine compose_select(const char** name);
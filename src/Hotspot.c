@@ -0,0 +1,102 @@
+// Hotspot.c
+// Nintendo Entertainment System CPU Hotspot Sampler Implementation
+#include "Hotspot.h"
+#include "Bus.h"
+#include "CPU.h"
+#include "Cartridge.h"
+
+
+Hotspot* init_hotspot() {
+    Hotspot* hotspot = (Hotspot*)malloc(sizeof(Hotspot));
+    if (!hotspot) {
+        fprintf(stderr, "[HOTSPOT] Error, Failed to allocate memory for the hotspot sampler.\n");
+        exit(1);
+    }
+    hotspot_reset(hotspot);
+
+    printf("[HOTSPOT] Hotspot sampler initialised!\n");
+    return hotspot;
+}
+
+void hotspot_reset(Hotspot* hotspot) {
+    memset(hotspot, 0, sizeof(Hotspot));
+    hotspot->countdown = HOTSPOT_INTERVAL;
+}
+
+// Offset into PRG the cartridge currently maps 'address' to
+static uint32_t prg_offset(Bus* bus, uint16_t address) {
+    uint32_t offset;
+    if (!bus->cart || !cartridge_cpu_map(bus->cart, address, &offset)) {
+        return HOTSPOT_NO_PRG;
+    }
+    return offset;
+}
+
+void hotspot_sample(Hotspot* hotspot, Bus* bus, uint16_t pc) {
+    // The instruction (or block, or idle loop skip) may have covered more than one interval
+    int count = 1 + (-hotspot->countdown / HOTSPOT_INTERVAL);
+    hotspot->countdown += count * HOTSPOT_INTERVAL;
+    hotspot->samples += count;
+
+    uint32_t offset = prg_offset(bus, pc);
+
+    // Open addressing, probing on from the hashed slot
+    uint32_t index = ((offset ^ ((uint32_t)pc << 16)) * 2654435761u) >> 20;
+    for (int probe = 0; probe < HOTSPOT_TABLE_SIZE; probe++) {
+        HotspotEntry* entry = &hotspot->table[(index + probe) & (HOTSPOT_TABLE_SIZE - 1)];
+        if (entry->samples == 0) {
+            entry->prg_offset = offset;
+            entry->address = pc;
+        } else if (entry->prg_offset != offset || entry->address != pc) {
+            continue;
+        }
+        entry->samples += count;
+        return;
+    }
+    hotspot->dropped += count;
+}
+
+static int compare_samples(const void* a, const void* b) {
+    uint32_t sa = ((const HotspotEntry*)a)->samples;
+    uint32_t sb = ((const HotspotEntry*)b)->samples;
+    return (sa < sb) - (sa > sb);
+}
+
+void hotspot_write(Hotspot* hotspot, Bus* bus, FILE* out) {
+    HotspotEntry* sorted = (HotspotEntry*)malloc(sizeof(hotspot->table));
+    if (!sorted) {
+        fprintf(stderr, "[HOTSPOT] Error, Failed to allocate memory for the flat profile.\n");
+        return;
+    }
+    int count = 0;
+    for (int i = 0; i < HOTSPOT_TABLE_SIZE; i++) {
+        if (hotspot->table[i].samples) {
+            sorted[count++] = hotspot->table[i];
+        }
+    }
+    qsort(sorted, count, sizeof(HotspotEntry), compare_samples);
+
+    fprintf(out, "# Flat profile: %lld samples (1 per %d CPU cycles), %d addresses, %lld dropped\n",
+            hotspot->samples, HOTSPOT_INTERVAL, count, hotspot->dropped);
+    fprintf(out, "# %10s %7s %7s  bank  addr  prg     instruction\n", "samples", "%", "cum %");
+    long long cumulative = 0;
+    for (int i = 0; i < count; i++) {
+        HotspotEntry* entry = &sorted[i];
+        cumulative += entry->samples;
+        fprintf(out, "  %10u %6.2f%% %6.2f%%  ", entry->samples,
+                100.0 * entry->samples / hotspot->samples, 100.0 * cumulative / hotspot->samples);
+
+        if (entry->prg_offset == HOTSPOT_NO_PRG) {
+            fprintf(out, "  --  %04X  --      (RAM)\n", entry->address);
+        } else if (!bus->cart || entry->prg_offset >= bus->cart->prg_memory->capacity) {
+            fprintf(out, "  %02X  %04X  %05X   (not in this cartridge's PRG)\n", entry->prg_offset / 0x4000,
+                    entry->address, entry->prg_offset);
+        } else {
+            // Read straight from PRG, the bank may have been switched out since
+            Opcode c = opcode_table[bus->cart->prg_memory->items[entry->prg_offset]];
+            fprintf(out, "  %02X  %04X  %05X   %s %s\n", entry->prg_offset / 0x4000, entry->address,
+                    entry->prg_offset, InstructionStrings[c.instruction], AddressModeStrings[c.addressing_mode]);
+        }
+    }
+    free(sorted);
+}
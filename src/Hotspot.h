@@ -0,0 +1,55 @@
+// Hotspot.h
+// Nintendo Entertainment System CPU Hotspot Sampler (Header File)
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+// Forward declarations to avoid circular dependencies
+typedef struct Bus Bus;
+
+/*///////HOTSPOTS//////////////////////////////////////////////////////////////////////////////////////
+
+A sampling profiler for finding where a game spends its time (idle loops, busy routines worth special
+casing). Every 'HOTSPOT_INTERVAL' CPU cycles the instruction those cycles were spent in is counted,
+keyed by its address and the PRG offset mapped there, so the same address in different banks
+stays apart. Cycles an idle loop skip sits out count towards the loop.
+
+The samples go in a fixed size hash table (anything past 'HOTSPOT_TABLE_SIZE' different instructions
+is counted as dropped), and 'hotspot_write' writes them out as a flat profile sorted by samples, with
+each instruction's PRG offset so it can be found in a disassembly of the ROM.
+
+Built in with -DCPU_HOTSPOT, the emulator writes 'hotspots.txt' on F10 and at exit. The only cost
+per instruction is the countdown in 'system_clock' (System.c).
+
+///////////////////////////////////////////////////////////////////////////////////////////////////*/
+
+#define HOTSPOT_INTERVAL    97      // CPU cycles between samples (prime, so it can't lock onto a loop's period)
+#define HOTSPOT_TABLE_SIZE  4096    // Different instructions tracked (power of 2)
+#define HOTSPOT_NO_PRG      0xFFFFFFFF  // PRG offset of code outside the cartridge (RAM)
+
+typedef struct HotspotEntry {
+    uint32_t prg_offset;    // Where the instruction is in PRG (its bank is this / 16KB), or HOTSPOT_NO_PRG
+    uint16_t address;       // CPU address of the instruction
+    uint32_t samples;       // 0 if the entry is empty
+} HotspotEntry;
+
+typedef struct Hotspot {
+    int countdown;          // CPU cycles until the next sample
+    long long samples;
+    long long dropped;      // Samples that didn't fit in the table
+    HotspotEntry table[HOTSPOT_TABLE_SIZE];
+} Hotspot;
+
+// Function to initialise the hotspot sampler
+Hotspot* init_hotspot();
+
+// Function to forget every sample (the cartridge changed, so the PRG offsets sampled so far mean nothing)
+void hotspot_reset(Hotspot* hotspot);
+
+// Function to call once 'countdown' has run out, counts the sample(s) due for the instruction at 'pc'
+void hotspot_sample(Hotspot* hotspot, Bus* bus, uint16_t pc);
+
+// Function to write the flat profile (most samples first)
+void hotspot_write(Hotspot* hotspot, Bus* bus, FILE* out);
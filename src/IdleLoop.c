@@ -0,0 +1,182 @@
+// IdleLoop.c
+// Nintendo Entertainment System CPU Idle Loop Detection Implementation
+#include "IdleLoop.h"
+#include "Bus.h"
+#include "CPU.h"
+#include "PPU.h"
+
+
+IdleLoop* init_idle_loop() {
+    IdleLoop* idle = (IdleLoop*)malloc(sizeof(IdleLoop));
+    if (!idle) {
+        fprintf(stderr, "[IDLELOOP] Error, Failed to allocate memory for idle loop detection.\n");
+        exit(1);
+    }
+    memset(idle, 0, sizeof(IdleLoop));
+    idle->enabled = true;
+
+    printf("[IDLELOOP] Idle loop detection initialised!\n");
+    return idle;
+}
+
+void idle_loop_forget(IdleLoop* idle) {
+    idle->watching = false;
+    idle->arrived = false;
+}
+
+// Instructions allowed in an idle loop: nothing that writes memory, the stack or X/Y
+static bool idle_instruction(Instruction instruction) {
+    switch (instruction) {
+        case LDA: case BIT: case CMP: case CPX: case CPY: case AND: case ORA: case EOR:
+        case TXA: case TYA: case CLC: case SEC: case CLV: case NOP:
+        case BCC: case BCS: case BEQ: case BMI: case BNE: case BPL: case BVC: case BVS:
+        case JMP:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool is_branch(Instruction instruction) {
+    switch (instruction) {
+        case BCC: case BCS: case BEQ: case BMI: case BNE: case BPL: case BVC: case BVS:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Decide whether the loop starting at 'head' is idle, X/Y can't change inside one so indexed addresses are fixed
+static bool analyse_loop(IdleLoop* idle, Cpu* cpu, uint16_t head) {
+    Bus* bus = cpu->bus;
+    idle->reads_ppu_status = false;
+
+    // Code has to come from somewhere reading it can't disturb
+    if (head >= 0x2000 && head < 0x8000) {
+        return false;
+    }
+
+    uint16_t addr = head;
+    uint16_t nearest_exit = 0;
+    for (int count = 0; count < IDLE_LOOP_MAX_OPS; count++) {
+        uint8_t opcode = bus_read(bus, addr);
+        Opcode c = opcode_table[opcode];
+        if (!idle_instruction(c.instruction) || (c.instruction == NOP && opcode != 0xEA)) {
+            return false;
+        }
+
+        uint16_t operand = 0;
+        if (c.bytes == 2) {
+            operand = bus_read(bus, addr + 1);
+        } else if (c.bytes == 3) {
+            operand = bus_read(bus, addr + 1) | (bus_read(bus, addr + 2) << 8);
+        }
+        uint16_t next = addr + c.bytes;
+
+        if (is_branch(c.instruction) || c.instruction == JMP) {
+            uint16_t target = (c.instruction == JMP) ? operand : (uint16_t)(next + (int8_t)operand);
+            if (c.instruction == JMP && c.addressing_mode != ABS) {
+                return false;
+            }
+            if (target == head) {
+                // The jump back, anything branching out has to leave the loop entirely
+                idle->tail = addr;
+                return addr - head <= IDLE_LOOP_MAX_BYTES && (nearest_exit == 0 || nearest_exit >= next);
+            }
+            if (c.instruction == JMP || target <= addr) {
+                return false;
+            }
+            if (nearest_exit == 0 || target < nearest_exit) {
+                nearest_exit = target;
+            }
+        } else if (c.addressing_mode != IMM && c.addressing_mode != IMP && c.addressing_mode != ACC) {
+            uint16_t address;
+            switch (c.addressing_mode) {
+                case ZP0: address = operand & 0x00FF; break;
+                case ZPX: address = (operand + cpu->X) & 0x00FF; break;
+                case ZPY: address = (operand + cpu->Y) & 0x00FF; break;
+                case ABS: address = operand; break;
+                case ABX: address = operand + cpu->X; break;
+                case ABY: address = operand + cpu->Y; break;
+                default: return false;  // Pointers in memory
+            }
+
+            if (address >= 0x2000 && address < 0x4000 && (address & 0x0007) == 0x0002) {
+                idle->reads_ppu_status = true;
+            } else if (address >= 0x2000 && address < 0x8000) {
+                return false;
+            }
+        }
+        addr = next;
+    }
+    return false;
+}
+
+int idle_loop_skip(IdleLoop* idle, Cpu* cpu, Ppu* ppu, uint16_t from_pc, int step_cycles) {
+    if (!idle->enabled) {
+        return 0;
+    }
+
+    uint16_t head = cpu->PC;
+    if (!idle->watching || idle->head != head || idle->cart_writes != cpu->bus->cart_writes) {
+        idle->watching = true;
+        idle->arrived = false;
+        idle->head = head;
+        idle->cart_writes = cpu->bus->cart_writes;
+        idle->idle = analyse_loop(idle, cpu, head);
+    }
+
+    // Only a trip straight round the loop counts (a compiled block from 'head' is one), anything else
+    // jumping back here could have been anywhere in between
+    if (!idle->idle || (from_pc != idle->tail && from_pc != head)) {
+        idle->arrived = false;
+        return 0;
+    }
+
+    // Reads stay the same until the next PPU event (or PPUSTATUS change) counted from the start of this step
+    Interrupts* lines = cpu->bus->interrupts;
+    int budget = (lines->nmi || lines->irq) ? 0 : (ppu_dots_until_event(ppu) / 3) - 1;
+    if (idle->reads_ppu_status) {
+        int status_budget = (ppu_dots_until_status_change(ppu) / 3) - 1;
+        if (status_budget < budget) {
+            budget = status_budget;
+        }
+    }
+    long long deadline = cpu->cycle_count - step_cycles + budget;
+
+    uint8_t status = cpu_get_status(cpu);
+    bool repeated = idle->arrived && idle->A == cpu->A && idle->X == cpu->X && idle->Y == cpu->Y &&
+                    idle->SP == cpu->SP && idle->status == status;
+    long long trip_cycles = cpu->cycle_count - idle->cycle_count;
+    long long previous_deadline = idle->deadline;
+
+    idle->arrived = true;
+    idle->A = cpu->A;
+    idle->X = cpu->X;
+    idle->Y = cpu->Y;
+    idle->SP = cpu->SP;
+    idle->status = status;
+    idle->cycle_count = cpu->cycle_count;
+    idle->deadline = deadline;
+
+    if (!repeated || trip_cycles <= 0) {
+        return 0;
+    }
+
+    // The last trip read what the next ones would, as long as nothing changed since it began, so whole trips
+    // up to the deadline seen at the previous arrival (or this one, if sooner) can be skipped
+    if (previous_deadline < deadline) {
+        deadline = previous_deadline;
+    }
+    long long trips = (deadline - cpu->cycle_count) / trip_cycles;
+    if (trips <= 0) {
+        return 0;
+    }
+
+    int skipped = (int)(trips * trip_cycles);   // Within the budget, so well inside an int
+    cpu->cycle_count += skipped;
+    idle->cycle_count = cpu->cycle_count;
+    idle->cycles_skipped += skipped;
+    idle->skips++;
+    return skipped;
+}
@@ -0,0 +1,66 @@
+// IdleLoop.h
+// Nintendo Entertainment System CPU Idle Loop Detection (Header File)
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Forward declarations to avoid circular dependencies
+typedef struct Cpu Cpu;
+typedef struct Ppu Ppu;
+
+/*///////IDLE LOOPS////////////////////////////////////////////////////////////////////////////////////
+
+Most games sit in a short loop while they wait for the NMI, e.g.
+    wait:   LDA $20     ; flag set by the NMI handler       wait:   BIT $2002
+            BEQ wait                                                BPL wait
+
+When the CPU jumps back to the start of a loop whose body only reads RAM, PRG or PPUSTATUS (and changes
+nothing but A/X/Y/flags), and it arrives there twice in a row with identical registers, every further
+trip round is identical too until something outside the CPU changes what it reads. So the trips that
+fit before the next PPU event (vblank NMI, end of frame, and for PPUSTATUS loops the next point its
+flags can change) are skipped, the CPU just burns their cycles while the PPU carries on as normal.
+
+    Skips are whole trips ending before the event (as seen at the start of the trip before, whose reads
+    they repeat), so the CPU lands in exactly the state it would have been in, and the loop then runs
+    normally to see the event happen.
+    Only arrivals straight from the jump back count, any interrupt (or reset) forgets the loop.
+
+Build with -DCPU_NO_IDLE_SKIP (or clear 'enabled' at runtime) to interpret every trip (accuracy testing).
+
+///////////////////////////////////////////////////////////////////////////////////////////////////*/
+
+#define IDLE_LOOP_MAX_OPS       8   // Instructions in a loop body (including the jump back)
+#define IDLE_LOOP_MAX_BYTES     16  // Furthest back the jump may go
+
+typedef struct IdleLoop {
+    bool enabled;               // Off switch (accuracy testing)
+
+    // Loop being watched
+    bool watching;              // 'head' has been analysed
+    bool idle;                  // The body at 'head' is side effect free
+    bool reads_ppu_status;      // The body reads PPUSTATUS ($2002 or a mirror)
+    uint16_t head;              // Start of the loop (the target of the jump back)
+    uint16_t tail;              // The jump back
+    uint32_t cart_writes;       // 'bus->cart_writes' when 'head' was analysed
+
+    // CPU state at the last arrival at 'head'
+    bool arrived;
+    uint8_t A, X, Y, SP, status;
+    long long cycle_count;
+    long long deadline;         // CPU cycle (as 'cycle_count') of the next point what the loop reads could change
+
+    // Stats (see bench/cpu_lockstep.c)
+    long long cycles_skipped;
+    long long skips;
+} IdleLoop;
+
+// Function to initialise idle loop detection
+IdleLoop* init_idle_loop();
+
+// Function to call when an instruction (or block) that started at 'from_pc' has left PC at or before it,
+// returns the CPU cycles to skip after the 'step_cycles' it took (already added to 'cpu->cycle_count')
+int idle_loop_skip(IdleLoop* idle, Cpu* cpu, Ppu* ppu, uint16_t from_pc, int step_cycles);
+
+// Function to forget the loop being watched (interrupts, reset)
+void idle_loop_forget(IdleLoop* idle);
@@ -0,0 +1,47 @@
+// Input.c
+// Nintendo Entertainment System Controller Input Implementation
+#include "Input.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+
+Input* init_input() {
+    Input* input = (Input*)malloc(sizeof(Input));
+    if (!input) {
+        fprintf(stderr, "[INPUT] Error, Failed to allocate memory for controller input.\n");
+        exit(1);
+    }
+    memset(input, 0, sizeof(Input));
+
+    printf("[INPUT] Controller input initialised!\n");
+    return input;
+}
+
+void input_sample(Input* input, int port, uint8_t buttons, uint64_t time) {
+    input->host[port] = buttons;
+    input->host_time[port] = time;
+}
+
+void input_inject(Input* input, int port, uint8_t buttons, uint64_t time) {
+    input->injected[port] = true;
+    input->inject[port] = buttons;
+    input->inject_time[port] = time;
+}
+
+void input_release(Input* input, int port) {
+    input->injected[port] = false;
+}
+
+uint8_t input_latch(Input* input, int port, long long dot) {
+    if (input->injected[port]) {
+        input->latched[port] = input->inject[port];
+        input->latched_time[port] = input->inject_time[port];
+    } else {
+        input->latched[port] = input->host[port];
+        input->latched_time[port] = input->host_time[port];
+    }
+    input->latch_dot[port] = dot;
+    return input->latched[port];
+}
@@ -0,0 +1,61 @@
+// Input.h
+// Nintendo Entertainment System Controller Input (Header File)
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*///////CONTROLLER INPUT//////////////////////////////////////////////////////////////////////////////
+
+What is held on the two controller ports, kept apart from the host it comes from:
+    Host sample - The front end samples its keyboard/pads once per frame ('input_sample'), with the host
+                  time it did so, never from inside the CPU/PPU loop
+    Injected    - Replay/automation can take a port over ('input_inject'), its buttons then replace the
+                  host's until it lets go ('input_release')
+    Latched     - A strobe write to $4016 latches both ports ('input_latch') into the controllers' shift
+                  registers on the bus, stamping the PPU dot and which sample the game got
+
+Input-to-photon latency is then the time from 'latched_time' (when the buttons the game last read were
+sampled) to the frame that used them being presented.
+
+Buttons are one byte per port, in the order the controller shifts them out (bit 7 first).
+
+///////////////////////////////////////////////////////////////////////////////////////////////////*/
+
+#define INPUT_PORTS 2
+
+typedef enum InputButton {
+    INPUT_A         = 0x80,
+    INPUT_B         = 0x40,
+    INPUT_SELECT    = 0x20,
+    INPUT_START     = 0x10,
+    INPUT_UP        = 0x08,
+    INPUT_DOWN      = 0x04,
+    INPUT_LEFT      = 0x02,
+    INPUT_RIGHT     = 0x01
+} InputButton;
+
+typedef struct Input {
+    uint8_t host[INPUT_PORTS];              // Buttons in the last host sample
+    uint64_t host_time[INPUT_PORTS];        // Host time of that sample (the front end's clock)
+    bool injected[INPUT_PORTS];             // Port taken over by 'input_inject'
+    uint8_t inject[INPUT_PORTS];            // Buttons injected
+    uint64_t inject_time[INPUT_PORTS];      // Time given with them
+
+    uint8_t latched[INPUT_PORTS];           // Buttons at the last strobe
+    uint64_t latched_time[INPUT_PORTS];     // Sample time of those buttons
+    long long latch_dot[INPUT_PORTS];       // PPU dot of the strobe
+} Input;
+
+// Function to initialise controller input (nothing held on either port)
+Input* init_input();
+
+// Function to give the buttons the host has held on a port, sampled at 'time'
+void input_sample(Input* input, int port, uint8_t buttons, uint64_t time);
+
+// Functions to take a port over with other buttons (replay/automation), and to give it back to the host
+void input_inject(Input* input, int port, uint8_t buttons, uint64_t time);
+void input_release(Input* input, int port);
+
+// Function to latch a port at a strobe on PPU dot 'dot', returning the buttons for its shift register
+uint8_t input_latch(Input* input, int port, long long dot);
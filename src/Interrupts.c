@@ -0,0 +1,39 @@
+// Interrupts.c
+// Nintendo Entertainment System CPU Interrupt Lines Implementation
+#include "Interrupts.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+
+Interrupts* init_interrupts() {
+    Interrupts* lines = (Interrupts*)malloc(sizeof(Interrupts));
+    if (!lines) {
+        fprintf(stderr, "[INTERRUPTS] Error, Failed to allocate memory for the interrupt lines.\n");
+        exit(1);
+    }
+    memset(lines, 0, sizeof(Interrupts));
+
+    printf("[INTERRUPTS] Interrupt lines initialised!\n");
+    return lines;
+}
+
+void interrupts_nmi(Interrupts* lines, long long time) {
+    // A second edge before the CPU has taken the first is the same NMI
+    if (!lines->nmi) {
+        lines->nmi = true;
+        lines->nmi_time = time;
+    }
+}
+
+void interrupts_irq_assert(Interrupts* lines, IrqSource source, long long time) {
+    if (!lines->irq) {
+        lines->irq_time = time;
+    }
+    lines->irq |= source;
+}
+
+void interrupts_irq_release(Interrupts* lines, IrqSource source) {
+    lines->irq &= ~source;
+}
@@ -0,0 +1,49 @@
+// Interrupts.h
+// Nintendo Entertainment System CPU Interrupt Lines (Header File)
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*///////INTERRUPT LINES///////////////////////////////////////////////////////////////////////////////
+
+The CPU's two interrupt inputs, driven by the rest of the system and only looked at by the CPU between
+instructions ('cpu_interrupt' in CPU.c):
+    NMI - Edge triggered, a source signals the edge ('interrupts_nmi') and it stays latched until the
+          CPU takes it (PPU: start of vblank, or enabling the NMI during vblank)
+    IRQ - Level triggered, each source holds the line ('interrupts_irq_assert') until it is acknowledged
+          ('interrupts_irq_release'), the CPU takes it whenever the line is held and I is clear
+
+Sources stamp what they do with the PPU dot ('ppu->dot_count') it happened on. Like the 6502, the CPU
+polls during the last cycle of an instruction: an edge/level from before that cycle started is taken
+once the instruction finishes, anything later waits until the next one has finished.
+CLI, SEI and PLP change I after the poll, so the instruction straight after them still sees the old I.
+
+Compiled blocks and idle loop skips don't run while either line is active, and only run up to the next
+PPU event ('ppu_dots_until_event'), so a new source has to be one of those events as well.
+
+///////////////////////////////////////////////////////////////////////////////////////////////////*/
+
+// Who is holding the IRQ line (bits of 'irq')
+typedef enum IrqSource {
+    IRQ_SOURCE_MAPPER       = 0x01,
+    IRQ_SOURCE_APU_FRAME    = 0x02,
+    IRQ_SOURCE_APU_DMC      = 0x04
+} IrqSource;
+
+typedef struct Interrupts {
+    bool nmi;               // NMI edge seen and not yet taken
+    long long nmi_time;     // PPU dot of the edge
+    uint8_t irq;            // IrqSource bits holding the IRQ line
+    long long irq_time;     // PPU dot the line was last asserted from released
+} Interrupts;
+
+// Function to initialise the interrupt lines (both released)
+Interrupts* init_interrupts();
+
+// Function to signal an NMI edge
+void interrupts_nmi(Interrupts* lines, long long time);
+
+// Functions to hold/release the IRQ line for one source
+void interrupts_irq_assert(Interrupts* lines, IrqSource source, long long time);
+void interrupts_irq_release(Interrupts* lines, IrqSource source);
@@ -0,0 +1,361 @@
+// Jit.c
+// Nintendo Entertainment System CPU x86-64 Recompiler Implementation
+// NOTE: Only built with -DCPU_JIT (see Jit.h)
+#include "Jit.h"
+
+#ifdef CPU_JIT
+
+#include "BlockCache.h"
+#include "Bus.h"
+#include "CPU.h"
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if !defined(CPU_LAZY_FLAGS) || !defined(CPU_BLOCK_CACHE)
+#error "CPU_JIT needs lazy flags and the block cache"
+#endif
+
+// Generated code addresses 'Cpu' fields as [rbx + disp8]
+_Static_assert(offsetof(Cpu, block_cache) < 128, "Cpu fields used by the JIT must be within disp8 of the struct");
+_Static_assert(offsetof(Bus, main_memory) == 0, "The JIT expects system RAM at the start of the Bus");
+
+#define OFF_A       ((uint8_t)offsetof(Cpu, A))
+#define OFF_X       ((uint8_t)offsetof(Cpu, X))
+#define OFF_Y       ((uint8_t)offsetof(Cpu, Y))
+#define OFF_SP      ((uint8_t)offsetof(Cpu, SP))
+#define OFF_PC      ((uint8_t)offsetof(Cpu, PC))
+#define OFF_N       ((uint8_t)offsetof(Cpu, flag_n))
+#define OFF_Z       ((uint8_t)offsetof(Cpu, flag_z))
+#define OFF_C       ((uint8_t)offsetof(Cpu, flag_c))
+#define OFF_V       ((uint8_t)offsetof(Cpu, flag_v))
+#define OFF_BUS     ((uint8_t)offsetof(Cpu, bus))
+#define OFF_CYCLES  ((uint8_t)offsetof(Cpu, cycles_left))
+
+
+Jit* init_jit() {
+    Jit* jit = (Jit*)malloc(sizeof(Jit));
+    if (!jit) {
+        fprintf(stderr, "[JIT] Error, Failed to allocate memory for the JIT.\n");
+        exit(1);
+    }
+    memset(jit, 0, sizeof(Jit));
+
+    // Writable while code is being emitted into it, executable once it has been, never both (see 'jit_protect')
+    void* arena = mmap(NULL, JIT_ARENA_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (arena == MAP_FAILED) {
+        fprintf(stderr, "[JIT] Unable to map executable memory, running on the interpreter only.\n");
+        free(jit);
+        return NULL;
+    }
+    jit->arena = (uint8_t*)arena;
+
+    printf("[JIT] JIT initialised!\n");
+    return jit;
+}
+
+// Switch the pages the next block's code can land in ('JIT_MAX_BLOCK_CODE' from 'start') between writable and executable
+static bool jit_protect(Jit* jit, uint8_t* start, bool writable) {
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    size_t first = (size_t)(start - jit->arena) & ~(page_size - 1);
+    size_t last = (size_t)(start - jit->arena) + JIT_MAX_BLOCK_CODE;
+    last = (last + page_size - 1) & ~(page_size - 1);
+    if (last > JIT_ARENA_SIZE) {
+        last = JIT_ARENA_SIZE;
+    }
+    return mprotect(jit->arena + first, last - first, writable ? (PROT_READ | PROT_WRITE) : (PROT_READ | PROT_EXEC)) == 0;
+}
+
+void free_jit(Jit* jit) {
+    if (!jit) {
+        return;
+    }
+    munmap(jit->arena, JIT_ARENA_SIZE);
+    free(jit);
+}
+
+//// x86-64 emission (rbx holds the Cpu*, eax/ecx/edx/esi are scratch)
+typedef struct Emitter {
+    uint8_t* p;
+} Emitter;
+
+static void emit8(Emitter* e, uint8_t b) {
+    *e->p++ = b;
+}
+
+static void emit_bytes(Emitter* e, const uint8_t* bytes, size_t n) {
+    memcpy(e->p, bytes, n);
+    e->p += n;
+}
+
+static void emit16(Emitter* e, uint16_t v) {
+    emit_bytes(e, (const uint8_t*)&v, 2);
+}
+
+static void emit32(Emitter* e, uint32_t v) {
+    emit_bytes(e, (const uint8_t*)&v, 4);
+}
+
+static void emit64(Emitter* e, uint64_t v) {
+    emit_bytes(e, (const uint8_t*)&v, 8);
+}
+
+// movzx eax/ecx/edx, byte [rbx + off]
+static void emit_load_eax(Emitter* e, uint8_t off) { emit8(e, 0x0F); emit8(e, 0xB6); emit8(e, 0x43); emit8(e, off); }
+static void emit_load_ecx(Emitter* e, uint8_t off) { emit8(e, 0x0F); emit8(e, 0xB6); emit8(e, 0x4B); emit8(e, off); }
+static void emit_load_edx(Emitter* e, uint8_t off) { emit8(e, 0x0F); emit8(e, 0xB6); emit8(e, 0x53); emit8(e, off); }
+
+// mov byte [rbx + off], al/cl/dl
+static void emit_store_al(Emitter* e, uint8_t off) { emit8(e, 0x88); emit8(e, 0x43); emit8(e, off); }
+static void emit_store_cl(Emitter* e, uint8_t off) { emit8(e, 0x88); emit8(e, 0x4B); emit8(e, off); }
+static void emit_store_dl(Emitter* e, uint8_t off) { emit8(e, 0x88); emit8(e, 0x53); emit8(e, off); }
+
+// mov byte [rbx + off], imm8
+static void emit_store_imm8(Emitter* e, uint8_t off, uint8_t value) {
+    emit8(e, 0xC6); emit8(e, 0x43); emit8(e, off); emit8(e, value);
+}
+
+// Lazy N/Z from al/cl (see 'set_nz_flags')
+static void emit_nz_al(Emitter* e) { emit_store_al(e, OFF_N); emit_store_al(e, OFF_Z); }
+static void emit_nz_cl(Emitter* e) { emit_store_cl(e, OFF_N); emit_store_cl(e, OFF_Z); }
+
+// ecx = the instruction's operand value (immediate, or a RAM byte at a fixed address)
+static void emit_operand_ecx(Emitter* e, AddressingMode mode, uint16_t operand) {
+    if (mode == IMM) {
+        emit8(e, 0xB9); emit32(e, operand);                             // mov ecx, imm32
+    } else {
+        emit8(e, 0x48); emit8(e, 0x8B); emit8(e, 0x43); emit8(e, OFF_BUS);  // mov rax, [rbx + bus]
+        emit8(e, 0x0F); emit8(e, 0xB6); emit8(e, 0x88);                 // movzx ecx, byte [rax + disp32]
+        emit32(e, offsetof(Bus, main_memory) + (operand & 0x07FF));
+    }
+}
+
+// A = A + ecx + C, with C/V/N/Z as 'add_with_carry' sets them
+static void emit_adc_ecx(Emitter* e) {
+    emit_load_eax(e, OFF_A);
+    emit_load_edx(e, OFF_C);
+    emit8(e, 0x01); emit8(e, 0xC2);                                     // add edx, eax
+    emit8(e, 0x01); emit8(e, 0xCA);                                     // add edx, ecx
+    emit8(e, 0x89); emit8(e, 0xD6);                                     // mov esi, edx
+    emit8(e, 0xC1); emit8(e, 0xEE); emit8(e, 0x08);                     // shr esi, 8
+    emit8(e, 0x40); emit8(e, 0x88); emit8(e, 0x73); emit8(e, OFF_C);    // mov [rbx + C], sil
+    emit_store_dl(e, OFF_N);
+    emit_store_dl(e, OFF_Z);
+    emit8(e, 0x31); emit8(e, 0xC1);                                     // xor ecx, eax
+    emit8(e, 0xF7); emit8(e, 0xD1);                                     // not ecx
+    emit8(e, 0x31); emit8(e, 0xD0);                                     // xor eax, edx
+    emit8(e, 0x21); emit8(e, 0xC8);                                     // and eax, ecx
+    emit8(e, 0x25); emit32(e, 0x80);                                    // and eax, 0x80
+    emit_store_al(e, OFF_V);
+    emit_store_dl(e, OFF_A);
+}
+
+// reg - ecx, with C/N/Z as 'compare' sets them
+static void emit_compare_ecx(Emitter* e, uint8_t reg) {
+    emit_load_eax(e, reg);
+    emit8(e, 0x38); emit8(e, 0xC8);                                     // cmp al, cl
+    emit8(e, 0x0F); emit8(e, 0x93); emit8(e, 0xC2);                     // setae dl
+    emit_store_dl(e, OFF_C);
+    emit8(e, 0x28); emit8(e, 0xC8);                                     // sub al, cl
+    emit_nz_al(e);
+}
+
+// Call the op's decoded handler: handler(cpu, operand)
+static void emit_call(Emitter* e, const DecodedOp* op) {
+    emit8(e, 0x48); emit8(e, 0x89); emit8(e, 0xDF);                     // mov rdi, rbx
+    emit8(e, 0xBE); emit32(e, op->operand);                             // mov esi, operand
+    emit8(e, 0x48); emit8(e, 0xB8); emit64(e, (uint64_t)(uintptr_t)op->handler);  // mov rax, handler
+    emit8(e, 0xFF); emit8(e, 0xD0);                                     // call rax
+}
+
+// Is the operand a fixed address in system RAM (so it can be read natively)?
+static bool fixed_ram_operand(AddressingMode mode, uint16_t operand) {
+    return mode == ZP0 || (mode == ABS && operand < 0x2000);
+}
+
+// Try to emit an instruction natively, false if it needs its handler
+static bool emit_native(Emitter* e, Opcode c, uint16_t operand, uint8_t opcode) {
+    AddressingMode mode = c.addressing_mode;
+    bool value_operand = (mode == IMM) || fixed_ram_operand(mode, operand);
+
+    switch (c.instruction) {
+        case LDA: case LDX: case LDY:
+            if (!value_operand) return false;
+            emit_operand_ecx(e, mode, operand);
+            emit_store_cl(e, c.instruction == LDA ? OFF_A : (c.instruction == LDX ? OFF_X : OFF_Y));
+            emit_nz_cl(e);
+            return true;
+        case AND: case ORA: case EOR:
+            if (!value_operand) return false;
+            emit_operand_ecx(e, mode, operand);
+            emit_load_eax(e, OFF_A);
+            emit8(e, c.instruction == AND ? 0x20 : (c.instruction == ORA ? 0x08 : 0x30));
+            emit8(e, 0xC8);                                             // and/or/xor al, cl
+            emit_store_al(e, OFF_A);
+            emit_nz_al(e);
+            return true;
+        case ADC: case SBC:
+            if (!value_operand) return false;
+            emit_operand_ecx(e, mode, operand);
+            if (c.instruction == SBC) {
+                emit8(e, 0x81); emit8(e, 0xF1); emit32(e, 0xFF);        // xor ecx, 0xFF
+            }
+            emit_adc_ecx(e);
+            return true;
+        case CMP: case CPX: case CPY:
+            if (!value_operand) return false;
+            emit_operand_ecx(e, mode, operand);
+            emit_compare_ecx(e, c.instruction == CMP ? OFF_A : (c.instruction == CPX ? OFF_X : OFF_Y));
+            return true;
+        case TAX: case TAY: case TXA: case TYA: case TSX: case TXS:
+            {
+                uint8_t src = (c.instruction == TAX || c.instruction == TAY) ? OFF_A :
+                              (c.instruction == TXA || c.instruction == TXS) ? OFF_X :
+                              (c.instruction == TYA) ? OFF_Y : OFF_SP;
+                uint8_t dst = (c.instruction == TAX || c.instruction == TSX) ? OFF_X :
+                              (c.instruction == TAY) ? OFF_Y :
+                              (c.instruction == TXS) ? OFF_SP : OFF_A;
+                emit_load_ecx(e, src);
+                emit_store_cl(e, dst);
+                if (c.instruction != TXS) {
+                    emit_nz_cl(e);
+                }
+            }
+            return true;
+        case INX: case INY: case DEX: case DEY:
+            {
+                uint8_t reg = (c.instruction == INX || c.instruction == DEX) ? OFF_X : OFF_Y;
+                emit_load_ecx(e, reg);
+                emit8(e, 0xFE);
+                emit8(e, (c.instruction == INX || c.instruction == INY) ? 0xC1 : 0xC9);  // inc/dec cl
+                emit_store_cl(e, reg);
+                emit_nz_cl(e);
+            }
+            return true;
+        case CLC: emit_store_imm8(e, OFF_C, 0); return true;
+        case SEC: emit_store_imm8(e, OFF_C, 1); return true;
+        case CLV: emit_store_imm8(e, OFF_V, 0); return true;
+        case NOP:
+            return opcode == 0xEA;  // The official NOP, illegal NOPs never reach here
+        default:
+            return false;
+    }
+}
+
+// Instructions that write memory through their addressing mode (rather than the stack)
+static bool writes_memory(Opcode c) {
+    switch (c.instruction) {
+        case STA: case STX: case STY: case INC: case DEC:
+            return true;
+        case ASL: case LSR: case ROL: case ROR:
+            return c.addressing_mode != ACC;
+        default:
+            return false;
+    }
+}
+
+static bool is_illegal(Instruction instruction) {
+    switch (instruction) {
+        case LAX: case SAX: case DCP: case ISB: case SLO: case RLA: case SRE: case RRA: case SBC_EB:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Can this instruction only ever touch system RAM, or read PRG? (never IO, cartridge RAM, or cartridge writes)
+static bool safe_to_run_ahead(Opcode c, uint16_t operand, uint8_t opcode) {
+    if (is_illegal(c.instruction) || (c.instruction == NOP && opcode != 0xEA)) {
+        return false;
+    }
+    bool writes = writes_memory(c);
+    switch (c.addressing_mode) {
+        case IMM: case ZP0: case ZPX: case ZPY: case REL: case ACC: case IMP:
+            return true;
+        case ABS:
+            if (c.instruction == JMP || c.instruction == JSR) {
+                return true;
+            }
+            return operand < 0x2000 || (!writes && operand >= 0x8000);
+        case ABX: case ABY:
+            // Any index 0-255, reads from $8000+ may wrap into zero page which is still fine
+            return (operand + 0xFF < 0x2000) || (!writes && operand >= 0x8000);
+        case IND:
+            return operand < 0x1FFF || operand >= 0x8000;
+        case IZX: case IZY:
+        default:
+            return false;
+    }
+}
+
+bool jit_compile(Jit* jit, BlockCache* cache, Bus* bus, Block* block) {
+    // Everything in the arena was compiled for blocks of an older PRG generation, start again
+    if (jit->generation != cache->generation[BLOCK_SOURCE_PRG]) {
+        jit->generation = cache->generation[BLOCK_SOURCE_PRG];
+        jit->used = 0;
+    }
+    // Out of space, drop every PRG block (and so all compiled code) and start again
+    if (jit->used + JIT_MAX_BLOCK_CODE > JIT_ARENA_SIZE) {
+        block_cache_invalidate_prg(cache);
+        return false;
+    }
+
+    // Check every op first, and work out the most cycles the block can take
+    int max_cycles = 0;
+    for (int i = 0; i < block->count; i++) {
+        uint8_t opcode = bus_read(bus, block->ops[i].pc);
+        Opcode c = opcode_table[opcode];
+        if (!safe_to_run_ahead(c, block->ops[i].operand, opcode)) {
+            block->jit_state = JIT_REJECTED;
+            jit->blocks_rejected++;
+            return false;
+        }
+        max_cycles += c.cycles + (c.page_penalty ? 1 : 0) + (c.addressing_mode == REL ? 2 : 0);
+    }
+
+    uint8_t* start = jit->arena + jit->used;
+    if (!jit_protect(jit, start, true)) {
+        return false;
+    }
+    Emitter e = { start };
+    emit8(&e, 0x53);                                                    // push rbx
+    emit8(&e, 0x48); emit8(&e, 0x89); emit8(&e, 0xFB);                  // mov rbx, rdi
+
+    int native_cycles = 0;
+    for (int i = 0; i < block->count; i++) {
+        const DecodedOp* op = &block->ops[i];
+        uint8_t opcode = bus_read(bus, op->pc);
+        Opcode c = opcode_table[opcode];
+        bool last = (i == block->count - 1);
+
+        // Only the last op can use or change PC (branches, jumps, calls, returns, BRK all end blocks)
+        if (last) {
+            emit8(&e, 0x66); emit8(&e, 0xC7); emit8(&e, 0x43); emit8(&e, OFF_PC); emit16(&e, op->next_pc);  // mov word [rbx + PC], next_pc
+        }
+        if (emit_native(&e, c, op->operand, opcode)) {
+            native_cycles += c.cycles;
+        } else {
+            emit_call(&e, op);
+        }
+    }
+
+    if (native_cycles) {
+        emit8(&e, 0x81); emit8(&e, 0x43); emit8(&e, OFF_CYCLES); emit32(&e, native_cycles);  // add dword [rbx + cycles_left], imm32
+    }
+    emit8(&e, 0x5B);                                                    // pop rbx
+    emit8(&e, 0xC3);                                                    // ret
+    if (!jit_protect(jit, start, false)) {
+        fprintf(stderr, "[JIT] Unable to make compiled code executable, block left to the interpreter.\n");
+        block->jit_state = JIT_REJECTED;
+        jit->blocks_rejected++;
+        return false;
+    }
+
+    jit->used += (size_t)(e.p - start);
+    block->native = (void (*)(Cpu*))start;
+    block->max_cycles = max_cycles;
+    block->jit_state = JIT_COMPILED;
+    jit->blocks_compiled++;
+    return true;
+}
+
+#endif
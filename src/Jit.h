@@ -0,0 +1,61 @@
+// Jit.h
+// Nintendo Entertainment System CPU x86-64 Recompiler (Header File)
+// NOTE: Optional, only built with -DCPU_JIT, and only for Linux on x86-64 (headless/batch use)
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#if defined(CPU_JIT) && !(defined(__x86_64__) && defined(__linux__))
+#error "CPU_JIT is only supported on Linux x86-64"
+#endif
+
+// Forward declarations to avoid circular dependencies
+typedef struct Bus Bus;
+typedef struct Block Block;
+typedef struct BlockCache BlockCache;
+
+/*///////JIT///////////////////////////////////////////////////////////////////////////////////////////
+
+Blocks from the block cache (see BlockCache.h) that keep being entered are translated to x86-64:
+    Register/immediate ops and loads from fixed RAM addresses are emitted as native code
+    Everything else is emitted as a direct call into that opcode's decoded handler
+
+A block is only compiled if nothing in it can reach $2000-$7FFF (PPU/APU/IO registers, cartridge RAM)
+or write to the cartridge, so running it ahead of the PPU is unobservable. Blocks using (zp,X)/(zp),Y,
+indexed ranges that may leave RAM/PRG, or illegal opcodes stay on the interpreter.
+
+The caller ('cpu_run_block') only runs a compiled block when it fits before the next PPU event.
+Compiled code belongs to the current PRG generation, so mapper writes (bank switches) drop all of it.
+
+///////////////////////////////////////////////////////////////////////////////////////////////////*/
+
+#define JIT_HOT_THRESHOLD   32                  // Block entries before it gets compiled
+#define JIT_ARENA_SIZE      (4 * 1024 * 1024)   // Executable memory for compiled blocks
+#define JIT_MAX_BLOCK_CODE  1024                // Upper bound on the code emitted for one block
+
+// Block 'jit_state'
+#define JIT_NONE        0
+#define JIT_COMPILED    1
+#define JIT_REJECTED    2
+
+typedef struct Jit {
+    uint8_t* arena;             // mmap'd memory, pages read/execute except while a block is being emitted into them
+    size_t used;
+    uint32_t generation;        // PRG generation the arena's code was compiled for
+
+    // Stats (printed by bench/cpu_lockstep.c, built with -DCPU_JIT by 'make jit-check')
+    long long blocks_compiled;
+    long long blocks_rejected;
+    long long blocks_run;
+} Jit;
+
+// Function to initialise the JIT (NULL if executable memory isn't available)
+Jit* init_jit();
+
+// Function to release the JIT and its arena
+void free_jit(Jit* jit);
+
+// Function to compile a block, sets its 'jit_state' (returns false if it can't be run natively right now)
+bool jit_compile(Jit* jit, BlockCache* cache, Bus* bus, Block* block);
@@ -6,10 +6,8 @@
 
 #define SDL_MAIN_HANDLED
 
-#include "Bus.h"
-#include "CPU.h"
-#include "PPU.h"
-#include "Cartridge.h"
+#include "System.h"
+#include "Input.h"
 
 #include <ctype.h>
 #include <stdlib.h>
@@ -52,18 +50,30 @@ SDL_Scancode key_up      = SDL_SCANCODE_UP;
 SDL_Scancode key_down    = SDL_SCANCODE_DOWN;
 SDL_Scancode key_left    = SDL_SCANCODE_LEFT;
 SDL_Scancode key_right   = SDL_SCANCODE_RIGHT;
+#ifdef CPU_PROFILE
+SDL_Scancode key_profile = SDL_SCANCODE_F9;     // Writes out the CPU profile so far
+bool profile_key_held = false;
+#endif
+#ifdef CPU_HOTSPOT
+SDL_Scancode key_hotspot = SDL_SCANCODE_F10;    // Writes out the hotspot samples so far
+bool hotspot_key_held = false;
+#endif
+#ifdef CPU_TRACE
+SDL_Scancode key_trace   = SDL_SCANCODE_F11;    // Starts/stops streaming the instruction trace to 'trace.bin'
+bool trace_key_held = false;
+FILE* trace_file = NULL;
+#endif
 
 uint32_t frame_duration_ms;
 uint32_t frame_start_time_ms;
 uint32_t frame_end_time_ms;
 uint32_t frame_num = 0;
+uint64_t input_latency_total = 0;   // Host ticks from input samples to the frames that used them being shown
+uint32_t input_latency_frames = 0;
 
 const char* file_path;
 
-Cartridge* cart;
-Bus* bus;
-Ppu* ppu;
-Cpu* cpu;
+System* nes = NULL;
 
 HWND hwnd;
 MSG msg;
@@ -71,7 +81,6 @@ SDL_Window* sdl_window;
 SDL_Texture* texture;
 SDL_Renderer* renderer;
 
-int nes_cycles_passed = 0;
 bool nes_running;
 bool cpu_running;
 bool run_debug = false;
@@ -80,15 +89,74 @@ int delay_time;
 
 const uint8_t *state;
 
+#ifdef CPU_PROFILE
+// Write the CPU execution profile (so far) out to 'cpu_profile.txt'
+void write_cpu_profile() {
+    FILE* out = fopen("cpu_profile.txt", "w");
+    if (!out) {
+        fprintf(stderr, "[MANAGER] Error, Failed to open 'cpu_profile.txt' for the CPU profile.\n");
+        return;
+    }
+    cpu_profile_report(out);
+    fclose(out);
+    printf("[MANAGER] CPU profile written to 'cpu_profile.txt'\n");
+}
+#endif
+
+#ifdef CPU_HOTSPOT
+// Write the hotspot samples (so far) out to 'hotspots.txt'
+void write_hotspots() {
+    FILE* out = fopen("hotspots.txt", "w");
+    if (!out) {
+        fprintf(stderr, "[MANAGER] Error, Failed to open 'hotspots.txt' for the hotspot samples.\n");
+        return;
+    }
+    hotspot_write(nes->hotspot, nes->bus, out);
+    fclose(out);
+    printf("[MANAGER] Hotspot samples written to 'hotspots.txt'\n");
+}
+#endif
+
+#ifdef CPU_TRACE
+// Start streaming the instruction trace to 'trace.bin' (from the records still in the ring), or stop
+void toggle_trace() {
+    if (trace_file) {
+        trace_drain(nes->cpu->trace, trace_file);
+        fclose(trace_file);
+        trace_file = NULL;
+        printf("[MANAGER] Instruction trace written to 'trace.bin' (%llu records dropped)\n",
+               (unsigned long long)nes->cpu->trace->dropped);
+        return;
+    }
+    trace_file = fopen("trace.bin", "wb");
+    if (!trace_file) {
+        fprintf(stderr, "[MANAGER] Error, Failed to open 'trace.bin' for the instruction trace.\n");
+        return;
+    }
+    trace_write_header(trace_file);
+    printf("[MANAGER] Tracing instructions to 'trace.bin'...\n");
+}
+#endif
+
 void cleanup() {
+#ifdef CPU_TRACE
+    if (trace_file) {
+        toggle_trace();
+    }
+#endif
+#ifdef CPU_PROFILE
+    write_cpu_profile();
+#endif
+#ifdef CPU_HOTSPOT
+    if (nes) {
+        write_hotspots();
+    }
+#endif
     // Clean up - Free NES components + SDL/Window from memory
     if (file_path) {
         free((void*)file_path);
     }
-    free(cpu);
-    free(ppu);
-    free(bus);
-    free(cart);
+    free_system(nes);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyTexture(texture);
     SDL_DestroyWindow(sdl_window);
@@ -98,38 +166,14 @@ void cleanup() {
 
 // Initialise the NES as a system (peripherals)
 void init_nes() {
-    // Initialise .nes game ('Cartridge')
-    cart = init_cart(file_path);
-
-    // Initialize Bus
-    printf("[MANAGER] Initialising BUS...\n");
-    bus = init_bus();
-    printf("[MANAGER] Assigning Game Cartridge reference to the BUS...\n");
-    bus->cart = cart;
-    printf("[MANAGER] Assigning Controller 0 (Keyboard) to the BUS...\n");
-    bus->controller[0] = 0x00;
-    printf("[MANAGER] Initialising BUS finished!\n");
-
-    // Initialize PPU
-    printf("[MANAGER] Initialising PPU...\n");
-    ppu = init_ppu();
-    printf("[MANAGER] Assigning PPU reference to the BUS...\n");
-    bus->ppu = ppu;
-    printf("[MANAGER] Assigning Game Cartridge reference to the PPU...\n");
-    ppu->cart = cart;
-    printf("[MANAGER] Initialising PPU finished!\n");
-
-    // Initialize CPU
-    printf("[MANAGER] Initialising CPU...\n");
-    cpu = init_cpu(bus);
-    printf("[MANAGER] Initialising CPU finished!\n");
-
-    // Set program counter to the reset vector (0xFFFC-0xFFFD)
-    uint16_t reset_low = bus_read(bus, 0xFFFC);
-    uint16_t reset_high = bus_read(bus, 0xFFFD);
-    uint16_t reset_vector = (reset_high << 8) | reset_low;
-    cpu->PC = reset_vector;   // Normally set to reset_vector value unless modified for a test case etc...
-    printf("[MANAGER] CPU PC set to reset vector 0x%04X\n\n", cpu->PC);
+    // A fresh NES for the game, sampling (CPU_HOTSPOT) afresh as well
+    free_system(nes);
+    nes = init_system(file_path);
+    if (!nes) {
+        MessageBox(hwnd, "This game's mapper is not implemented.", "Error", MB_OK | MB_ICONERROR);
+        cleanup();
+        exit(1);
+    }
 }
 
 // Initialise the SDL2-based display
@@ -149,69 +193,59 @@ void init_sdl_display() {
 
 // Update SDL2-based display
 void update_sdl_display() {
-    SDL_UpdateTexture(texture, NULL, ppu->framebuffer + 2048, NES_WIDTH * sizeof(uint32_t)); // we skip 2048 bytes to skip the first 8 scanlines, and consequently the last 8 scanlines (224 height instead of 240)
+    SDL_UpdateTexture(texture, NULL, nes->ppu->framebuffer + 2048, NES_WIDTH * sizeof(uint32_t)); // we skip 2048 bytes to skip the first 8 scanlines, and consequently the last 8 scanlines (224 height instead of 240)
     SDL_RenderCopy(renderer, texture, NULL, NULL);
     SDL_RenderPresent(renderer);
 }
 
 // Reset the NES system (Reset Button simulation)
-void reset_nes(Cpu* cpu, Bus* bus, Ppu* ppu) {
+void reset_nes(System* nes) {
     // Reset CPU
-    cpu_reset(cpu, bus);
-    cpu->cycle_count = 0;
+    cpu_reset(nes->cpu, nes->bus);
+    nes->cpu->cycle_count = 0;
 
     // Reset (not really) PPU
-    memset(ppu->framebuffer, 0, sizeof(ppu->framebuffer));
-    ppu->frames_completed = 0;
+    memset(nes->ppu->framebuffer, 0, sizeof(nes->ppu->framebuffer));
+    nes->ppu->frames_completed = 0;
 
     update_sdl_display();
     
     // NES will now run from 'cycle' 0
-    nes_cycles_passed = 0;
+    nes->nes_cycles_passed = 0;
 }
 
-// One NES 'clock'
-void nes_clock() {
-    // Do one PPU 'clock'
-    ppu_clock(ppu);
-
-    // Run 1 CPU 'clock' for every 3 PPU cycles
-    if (nes_cycles_passed % 3 == 0) {
-        if (bus->dma_transfer) {
-            if (bus->dma_dummy) {
-                if (nes_cycles_passed % 2 == 0) {
-                    bus->dma_dummy = false;
-                }
-            } else {
-                // DMA can take place!
-                if (nes_cycles_passed % 2 == 0) {
-                    // On even clock cycles, read from CPU bus
-                    bus->dma_data = bus_read(bus, bus->dma_page << 8 | bus->dma_addr);
-                } else {
-                    // On odd clock cycles, write to PPU OAM
-                    bus->ppu->p_oam[bus->dma_addr] = bus->dma_data;
-                    // Increment the low byte of the address
-                    bus->dma_addr++;
-                    // If this wraps around, we know that 256
-                    // bytes have been written, so end the DMA
-                    // transfer, and proceed as normal
-                    if (bus->dma_addr == 0x00) {
-                        bus->dma_transfer = false;
-                        bus->dma_dummy = true;
-                    }
-                }
-            }
-        } else {
-            cpu_clock(cpu, run_debug, frame_num);
-        }
-    }
-
-    if (bus->ppu->nmi_occurred) {
-        bus->ppu->nmi_occurred = false;
-        cpu_nmi(cpu, bus);
-    }
-
-    nes_cycles_passed++;
+// Sample the keyboard, once per frame: the hotkeys, and the buttons for controller port 0 (nothing is bound to port 1)
+void poll_host_input() {
+    if (state[key_power])       nes_running = false;            // POWER    (Key P) This only powers OFF within this loop
+    if (state[key_reset])       reset_nes(nes);                 // RESET    (Key R)
+#ifdef CPU_PROFILE
+    if (state[key_profile] && !profile_key_held) write_cpu_profile();   // PROFILE  (Key F9)
+    profile_key_held = state[key_profile];
+#endif
+#ifdef CPU_HOTSPOT
+    if (state[key_hotspot] && !hotspot_key_held) write_hotspots();      // HOTSPOTS (Key F10)
+    hotspot_key_held = state[key_hotspot];
+#endif
+#ifdef CPU_TRACE
+    if (state[key_trace] && !trace_key_held) toggle_trace();            // TRACE    (Key F11)
+    trace_key_held = state[key_trace];
+#endif
+
+    uint8_t buttons = 0x00;
+    if (state[key_a])           buttons |= INPUT_A;             // A        (Key Z)
+    if (state[key_b])           buttons |= INPUT_B;             // B        (Key X)
+
+    if (state[key_select])      buttons |= INPUT_SELECT;        // Select   (Key SELECT)
+    if (state[key_start])       buttons |= INPUT_START;         // Start    (Key ENTER/RETURN)
+
+    if (state[key_up])          buttons |= INPUT_UP;            // Up       (Key UP ARR)
+    if (state[key_down])        buttons |= INPUT_DOWN;          // Down     (Key DOWN ARR)
+    if (state[key_left])        buttons |= INPUT_LEFT;          // Left     (Key LEFT ARR)
+    if (state[key_right])       buttons |= INPUT_RIGHT;         // Right    (Key RIGHT ARR)
+
+    uint64_t now = SDL_GetPerformanceCounter();
+    input_sample(nes->bus->input, 0, buttons, now);
+    input_sample(nes->bus->input, 1, 0x00, now);
 }
 
 // Load ROM
@@ -255,11 +289,18 @@ void load_rom() {
     //  probably a much more efficient way to do these checks ;0)
     if (nes_running && cart_changed) {
         // Reset and assign cartridge
-        cart = init_cart(file_path);
-        bus->cart = cart;
-        ppu->cart = cart;
+        Cartridge* old_cart = nes->cart;
+        nes->cart = init_cart(file_path);
+        bus_attach_cartridge(nes->bus, nes->cart);
+        ppu_attach_cartridge(nes->ppu, nes->cart);
+#ifdef CPU_HOTSPOT
+        // Samples so far are offsets into the old cartridge's PRG
+        hotspot_reset(nes->hotspot);
+#endif
         // Reset the NES
-        reset_nes(cpu, bus, ppu);
+        reset_nes(nes);
+        // Nothing points into the old cartridge any more
+        free_cart(old_cart);
     } else if ((nes_running && !cart_changed) || (!nes_running && cart_changed)) {
         nes_running = true;
     } else {
@@ -538,7 +579,7 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
                     break;
                 case ID_CONTROL_RESET:
                     if (nes_running) {
-                        reset_nes(cpu, bus, ppu);
+                        reset_nes(nes);
                     }
                     break;
                 case ID_CONTROL_POWER:
@@ -706,57 +747,54 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         init_nes();
         
 
+        // Handle any key presses (controller activity), from here on once per frame
+        poll_host_input();
+
         // Run the NES!
         while (nes_running) {
-            // Handle Windows messages
-            if (nes_cycles_passed % 100 == 0) {
-                while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
-                    if (msg.message == WM_QUIT) {
-                        cleanup();
-                        nes_running = false;
-                    }
-                    TranslateMessage(&msg);
-                    DispatchMessage(&msg);
-                }
-            }
-
-            // Handle any key presses (controller activity)
-            bus->controller[0] = 0x00;                                  // Initiate Controller 0 (1st controller)
-
-            if (state[key_power])       nes_running = false;            // POWER    (Key P) This only powers OFF within this loop
-            if (state[key_reset])       reset_nes(cpu, bus, ppu);       // RESET    (Key R)
-
-            if (state[key_a])           bus->controller[0] |= 0x80;     // A        (Key Z)
-            if (state[key_b])           bus->controller[0] |= 0x40;     // B        (Key X)
-
-            if (state[key_select])      bus->controller[0] |= 0x20;     // Select   (Key SELECT)
-            if (state[key_start])       bus->controller[0] |= 0x10;     // Start    (Key ENTER/RETURN)
-
-            if (state[key_up])          bus->controller[0] |= 0x08;     // Up       (Key UP ARR)
-            if (state[key_down])        bus->controller[0] |= 0x04;     // Down     (Key DOWN ARR)
-            if (state[key_left])        bus->controller[0] |= 0x02;     // Left     (Key LEFT ARR)
-            if (state[key_right])       bus->controller[0] |= 0x01;     // Right    (Key RIGHT ARR)
-
 
             // Do 1 NES 'clock'
-            /* Within 'nes_clock':
-                Controller state is checked (KB input) (We pass in the Keyboard's state, as visible)
-                The PPU is clocked thrice
-                The CPU is clocked once
+            /* Within 'system_clock' (System.c):
+                The CPU runs one whole instruction
+                The PPU is clocked thrice for every CPU cycle that instruction took
                 DMA and NMI is partially handled here as well
             */
-            nes_clock();
+            system_clock(nes, true);
 
 
             // If the PPU completes the frame rendering process...
-            if (ppu->frame_done) {
+            if (nes->ppu->frame_done) {
                 // Reset flag
-                ppu->frame_done = false;
+                nes->ppu->frame_done = false;
 
                 // Render frame to the SDL window/'display'
                 update_sdl_display();
                 frame_num++;    // Increment the count (debug purposes only, otherwise serves no functional purpose)
 
+                // Input-to-photon latency: from when the buttons the game last latched were sampled until now
+                if (nes->bus->input->latched_time[0] != 0) {
+                    input_latency_total += SDL_GetPerformanceCounter() - nes->bus->input->latched_time[0];
+                    input_latency_frames++;
+                }
+
+#ifdef CPU_TRACE
+                // Stream the frame's instructions out before the ring comes round to them again
+                if (trace_file) {
+                    trace_drain(nes->cpu->trace, trace_file);
+                }
+#endif
+
+                // Handle Windows messages (once per frame, system_clock no longer lands on every cycle count)
+                while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
+                    if (msg.message == WM_QUIT) {
+                        // Everything is freed, so nothing more of this frame can run
+                        cleanup();
+                        exit(0);
+                    }
+                    TranslateMessage(&msg);
+                    DispatchMessage(&msg);
+                }
+
                 // Handle any SDL events
                 for (SDL_Event event; SDL_PollEvent(&event);) {
                     if (event.type == SDL_QUIT) {
@@ -764,6 +802,9 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
                     }
                 }
 
+                // Handle any key presses (controller activity), the keyboard state only changes with the events above
+                poll_host_input();
+
                 // Attempt to time the frame to achieve ~60fps
                 frame_end_time_ms = SDL_GetTicks();
                 int delay_time = frame_duration_ms - (int)(frame_end_time_ms - frame_start_time_ms);
@@ -774,6 +815,15 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
                 // Debug to check frequency of 60 frame update events
                 if (frame_num % 60 == 0) {
                     printf("60 frames passed/updated!\n");
+#ifdef CPU_IDLE_SKIP
+                    printf("[CPU] Idle loop cycles skipped: %lld (%lld skips)\n", nes->cpu->idle_loop->cycles_skipped, nes->cpu->idle_loop->skips);
+#endif
+                    if (input_latency_frames > 0) {
+                        printf("[INPUT] Average input-to-display latency: %.2fms\n",
+                               1000.0 * input_latency_total / input_latency_frames / SDL_GetPerformanceFrequency());
+                        input_latency_total = 0;
+                        input_latency_frames = 0;
+                    }
                 }
 
                 // Update the start time for the next frame
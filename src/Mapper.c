@@ -24,6 +24,7 @@ Mapper *mapper_create(
     // Initialize function pointers to NULL (to be set up later as needed)
     new_mapper->mapper_cpu_read = NULL;
     new_mapper->mapper_cpu_write = NULL;
+    new_mapper->mapper_cpu_claims = NULL;
     new_mapper->mapper_ppu_read = NULL;
     new_mapper->mapper_ppu_write = NULL;
 
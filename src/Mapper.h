@@ -8,8 +8,12 @@
 typedef struct Mapper Mapper;
 
 // Function pointer typedefs for memory mapping operations.
-typedef bool (*MapperReadFunc)(Mapper *mapper, uint16_t address, uint32_t *mapped_addr);
-typedef bool (*MapperWriteFunc)(Mapper *mapper, uint16_t address, uint32_t *mapped_addr);
+// Reads and writes are mapped the same way (address in, offset out), so they share one type.
+typedef bool (*MapperMapFunc)(Mapper *mapper, uint16_t address, uint32_t *mapped_addr);
+typedef MapperMapFunc MapperReadFunc;
+typedef MapperMapFunc MapperWriteFunc;
+// Does the mapper take CPU reads or writes at this address? Only asks, unlike a write (a register write on some mappers).
+typedef bool (*MapperClaimsFunc)(Mapper *mapper, uint16_t address);
 
 // Base Mapper structure definition.
 // This structure supports Mapper 0, 1, 2, and 3.
@@ -20,6 +24,7 @@ struct Mapper {
     // Function pointers for CPU memory operations.
     MapperReadFunc  mapper_cpu_read;
     MapperWriteFunc mapper_cpu_write;
+    MapperClaimsFunc mapper_cpu_claims;
 
     // Function pointers for PPU memory operations.
     MapperReadFunc  mapper_ppu_read;
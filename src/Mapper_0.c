@@ -7,6 +7,7 @@
 
 bool mapper_cpu_read(Mapper *mapper, uint16_t address, uint32_t *mapped_addr);
 bool mapper_cpu_write(Mapper *mapper, uint16_t address, uint32_t *mapped_addr);
+bool mapper_cpu_claims(Mapper *mapper, uint16_t address);
 
 bool mapper_ppu_read(Mapper *mapper, uint16_t address, uint32_t *mapped_addr);
 bool mapper_ppu_write(Mapper *mapper, uint16_t address, uint32_t *mapped_addr);
@@ -15,6 +16,7 @@ bool mapper_ppu_write(Mapper *mapper, uint16_t address, uint32_t *mapped_addr);
 void mapper_load_0(Mapper *mapper) {
     mapper->mapper_cpu_read = mapper_cpu_read;
     mapper->mapper_cpu_write = mapper_cpu_write;
+    mapper->mapper_cpu_claims = mapper_cpu_claims;
     mapper->mapper_ppu_read = mapper_ppu_read;
     mapper->mapper_ppu_write = mapper_ppu_write;
 }
@@ -37,6 +39,10 @@ bool mapper_cpu_write(Mapper *mapper, uint16_t address, uint32_t *mapped_addr) {
     return false;
 }
 
+bool mapper_cpu_claims(Mapper *mapper, uint16_t address) {
+    return address >= 0x8000 && address <= 0xFFFF;
+}
+
 bool mapper_ppu_read(Mapper *mapper, uint16_t address, uint32_t *mapped_addr) {
     if (address >= 0x0000 && address <= 0x1FFF) {
         *mapped_addr = address;
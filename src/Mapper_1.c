@@ -9,6 +9,7 @@
 // Forward declarations of Mapper 1 specific read/write functions
 static bool mapper1_cpu_read(Mapper *this, uint16_t address, uint32_t *mapped_addr);
 static bool mapper1_cpu_write(Mapper *this, uint16_t address, uint32_t *mapped_addr);
+static bool mapper1_cpu_claims(Mapper *this, uint16_t address);
 static bool mapper1_ppu_read(Mapper *this, uint16_t address, uint32_t *mapped_addr);
 static bool mapper1_ppu_write(Mapper *this, uint16_t address, uint32_t *mapped_addr);
 
@@ -16,6 +17,7 @@ void mapper_load_1(Mapper *mapper) {
     // Set the function pointers to the Mapper 1 specific implementations
     mapper->mapper_cpu_read = mapper1_cpu_read;
     mapper->mapper_cpu_write = mapper1_cpu_write;
+    mapper->mapper_cpu_claims = mapper1_cpu_claims;
     mapper->mapper_ppu_read = mapper1_ppu_read;
     mapper->mapper_ppu_write = mapper1_ppu_write;
 
@@ -101,6 +103,14 @@ static bool mapper1_cpu_write(Mapper *this, uint16_t address, uint32_t *mapped_a
     return true;
 }
 
+/**
+ * CPU address claim for Mapper 1.
+ * PRG reads and register writes both live in 0x8000-0xFFFF, asking never touches the shift register.
+ */
+static bool mapper1_cpu_claims(Mapper *this, uint16_t address) {
+    return address >= 0x8000;
+}
+
 /**
  * PPU Read for Mapper 1.
  * Maps PPU addresses to CHR ROM/RAM banks based on MMC1 registers.
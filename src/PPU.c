@@ -84,10 +84,81 @@ static inline uint32_t get_palette_colour(uint8_t i) {
     return 0x000000FF | (NES_PALETTE[index] << 8);
 }
 
-// Flip a byte horizontally (used for the rendering of sprites)
-static inline uint8_t flipbyte(uint8_t b) {
-    b = ((b * 0x0802U & 0x22110U) | (b * 0x8020U & 0x88440U)) * 0x10101U >> 16;
-    return b;
+#ifdef PPU_SCANLINE_RENDER
+static void ppu_catch_up(Ppu* ppu);
+#endif
+
+// Resolve palette entry 'index' (one not mirrored) into 'palette_colours', along with the entry mirroring it
+static inline void ppu_resolve_colour(Ppu* ppu, uint8_t index) {
+    uint32_t colour = get_palette_colour(ppu->palette_table[index] & (ppu->registers.mask.grayscale ? 0x30 : 0x3F));
+    ppu->palette_colours[index] = colour;
+    if ((index & 0x03) == 0) {
+        ppu->palette_colours[index | 0x10] = colour;
+    }
+}
+
+static void ppu_resolve_palette(Ppu* ppu) {
+    for (uint8_t index = 0; index < 0x10; index++) {
+        ppu_resolve_colour(ppu, index);
+        if (index & 0x03) {
+            ppu_resolve_colour(ppu, index | 0x10);
+        }
+    }
+}
+
+// Pattern Tile Cache (see PPU_PATTERN_PAGES)
+
+// A row of pixel indices from its two bit planes, left to right (or 'flip'ped, right to left)
+static inline uint64_t decode_row(uint8_t lo, uint8_t hi, bool flip) {
+    uint64_t row = 0;
+    for (int x = 0; x < 8; x++) {
+        int bit = flip ? x : 7 - x;
+        row |= (uint64_t)(((lo >> bit) & 0x01) | (((hi >> bit) & 0x01) << 1)) << (8 * x);
+    }
+    return row;
+}
+
+static void decode_tile_row(PpuTile* tile, const uint8_t* planes, int row) {
+    tile->rows[row] = decode_row(planes[row], planes[row + 8], false);
+    tile->flipped[row] = decode_row(planes[row], planes[row + 8], true);
+}
+
+static void decode_tiles(PpuTile* tiles, const uint8_t* planes, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        for (int row = 0; row < 8; row++) {
+            decode_tile_row(&tiles[i], &planes[i * 16], row);
+        }
+    }
+}
+
+// Decoded tile at 'memory' (in CHR memory or 'pattern_table'), NULL if it isn't the start of one
+static PpuTile* tile_at(Ppu* ppu, const uint8_t* memory) {
+    const uint8_t* own = &ppu->pattern_table[0][0];
+    if (memory >= own && memory < own + sizeof(ppu->pattern_table)) {
+        size_t offset = memory - own;
+        return (offset & 0x0F) ? NULL : &ppu->own_tiles[offset >> 4];
+    }
+    if (ppu->chr_tiles) {
+        const uint8_t* chr = ppu->cart->chr_memory->items;
+        if (memory >= chr && memory < chr + ppu->chr_tile_count * 16) {
+            size_t offset = memory - chr;
+            return (offset & 0x0F) ? NULL : &ppu->chr_tiles[offset >> 4];
+        }
+    }
+    return NULL;
+}
+
+// Decoded row of the pattern whose low plane byte is at 'address'. Anything but a low plane byte in $0000-$1FFF
+// (a sprite size change between evaluation and fetch can ask for one) decodes whatever two bytes are there
+static inline uint64_t ppu_pattern_row(Ppu* ppu, uint16_t address, bool flip) {
+    if (address <= 0x1FFF && !(address & 0x08)) {
+        const PpuTile* tiles = ppu->tile_page[address >> 10];
+        if (tiles) {
+            const PpuTile* tile = &tiles[(address >> 4) & 0x3F];
+            return flip ? tile->flipped[address & 0x07] : tile->rows[address & 0x07];
+        }
+    }
+    return decode_row(ppu_read(ppu, address), ppu_read(ppu, address + 8), flip);
 }
 
 // PPU Initialization & Reset
@@ -100,10 +171,17 @@ Ppu* init_ppu() {
     }
 
     ppu->cart = NULL;
+    ppu->chr_tiles = NULL;
+    ppu->chr_tile_count = 0;
     memset(ppu->framebuffer, 0, PPU_SCREEN_WIDTH * PPU_SCREEN_HEIGHT * sizeof(uint32_t));
     memset(ppu->name_table, 0, sizeof(ppu->name_table));
     memset(ppu->palette_table, 0, sizeof(ppu->palette_table));
     memset(ppu->pattern_table, 0, sizeof(ppu->pattern_table));
+    memset(ppu->own_tiles, 0, sizeof(ppu->own_tiles));
+    // Nothing mapped yet, 'ppu_map_memory' compares against these before filling them in
+    memset(ppu->read_page, 0, sizeof(ppu->read_page));
+    memset(ppu->write_page, 0, sizeof(ppu->write_page));
+    memset(ppu->tile_page, 0, sizeof(ppu->tile_page));
 
     ppu->scanline = 0;
     ppu->cycle = 0;
@@ -112,6 +190,7 @@ Ppu* init_ppu() {
     ppu->registers.ctrl = (PpuCtrl){0};
     ppu->registers.status = (PpuStatus){0};
     ppu->registers.mask = (PpuMask){0};
+    ppu_resolve_palette(ppu);
 
     ppu->vram_addr = (LoopyRegister){0};
     ppu->vram_addr.reg = 0x0000;
@@ -134,17 +213,94 @@ Ppu* init_ppu() {
     ppu->b_sprite_zero_hit_possible = false;
     ppu->b_sprite_zero_being_rendered = false;
     ppu->p_oam = (uint8_t*)ppu->oam;
+    ppu->oam_dirty = true;
     ppu->frame_done = false;
-    ppu->nmi_occurred = false;
+    ppu->interrupts = NULL;
+    ppu->dot_count = 0;
+#ifdef PPU_SCANLINE_RENDER
+    ppu->scanline_render = true;
+    const char* kernel;
+    ppu->compose = compose_select(&kernel);
+    ppu->line_pending = false;
+    ppu->line_hit_known = false;
+    ppu->line_dots_until = 0;
+    ppu->lines_rendered = 0;
+    ppu->lines_caught_up = 0;
+#endif
+    ppu_map_memory(ppu);
 
     return ppu;
 }
 
+void free_ppu(Ppu* ppu) {
+    free(ppu->chr_tiles);
+    free(ppu);
+}
+
+void ppu_attach_cartridge(Ppu* ppu, Cartridge* cart) {
+    free(ppu->chr_tiles);
+    ppu->chr_tiles = NULL;
+    ppu->chr_tile_count = 0;
+    ppu->cart = cart;
+    if (cart) {
+        ppu->chr_tile_count = cart->chr_memory->capacity / 16;
+        ppu->chr_tiles = (PpuTile*)malloc(ppu->chr_tile_count * sizeof(PpuTile));
+        if (!ppu->chr_tiles) {
+            fprintf(stderr, "[PPU] Failed to allocate memory for the CHR tile cache\n");
+            exit(1);
+        }
+        decode_tiles(ppu->chr_tiles, cart->chr_memory->items, ppu->chr_tile_count);
+    }
+    ppu_map_memory(ppu);
+}
+
+// Which 1KB of VRAM each nametable ($2000, $2400, $2800, $2C00) is for each mirroring mode
+static const uint8_t NAME_TABLE_LAYOUT[][4] = {
+    [HORIZONTAL]   = { 0, 0, 1, 1 },
+    [VERTICAL]     = { 0, 1, 0, 1 },
+    [ONESCREEN_LO] = { 0, 0, 0, 0 },
+    [ONESCREEN_HI] = { 1, 1, 1, 1 },
+    [FOUR_SCREEN]  = { 0, 1, 2, 3 },
+};
+
+void ppu_map_memory(Ppu* ppu) {
+    Cartridge* cart = ppu->cart;
+    const uint8_t* layout = NAME_TABLE_LAYOUT[cart ? cart->mirror : HORIZONTAL];
+    const uint8_t* read_page[PPU_PAGES];
+    uint8_t* write_page[PPU_PAGES];
+    for (int page = 0; page < PPU_PAGES; page++) {
+        uint16_t address = page << 10;
+        uint8_t* own = (address <= 0x1FFF) ? &ppu->pattern_table[page >> 2][(page & 0x03) << 10]
+                                           : ppu->name_table[layout[page & 0x03]];
+
+        // The cartridge gets the first say, anything it doesn't take is the PPU's own memory
+        bool claimed = false;
+        const uint8_t* chr = cart ? cartridge_ppu_bank(cart, address, &claimed) : NULL;
+        read_page[page] = claimed ? chr : own;
+        uint8_t* chr_write = cart ? cartridge_ppu_write_bank(cart, address, &claimed) : NULL;
+        write_page[page] = claimed ? chr_write : own;
+    }
+
+#ifdef PPU_SCANLINE_RENDER
+    // A bank switch or mirroring change part way through a scanline only applies to the dots after it
+    if (memcmp(read_page, ppu->read_page, sizeof(read_page)) != 0 ||
+        memcmp(write_page, ppu->write_page, sizeof(write_page)) != 0) {
+        ppu_catch_up(ppu);
+    }
+#endif
+    memcpy(ppu->read_page, read_page, sizeof(read_page));
+    memcpy(ppu->write_page, write_page, sizeof(write_page));
+    for (int page = 0; page < PPU_PATTERN_PAGES; page++) {
+        ppu->tile_page[page] = read_page[page] ? tile_at(ppu, read_page[page]) : NULL;
+    }
+}
+
 void ppu_reset(Ppu* ppu) {
     memset(ppu->framebuffer, 0, PPU_SCREEN_WIDTH * PPU_SCREEN_HEIGHT * sizeof(uint32_t));
     memset(ppu->name_table, 0, sizeof(ppu->name_table));
     memset(ppu->palette_table, 0, sizeof(ppu->palette_table));
     memset(ppu->pattern_table, 0, sizeof(ppu->pattern_table));
+    memset(ppu->own_tiles, 0, sizeof(ppu->own_tiles));
 
     ppu->scanline = 0;
     ppu->cycle = 0;
@@ -153,6 +309,7 @@ void ppu_reset(Ppu* ppu) {
     ppu->registers.ctrl = (PpuCtrl){0};
     ppu->registers.status = (PpuStatus){0};
     ppu->registers.mask = (PpuMask){0};
+    ppu_resolve_palette(ppu);
 
     ppu->vram_addr = (LoopyRegister){0};
     ppu->vram_addr.reg = 0x0000;
@@ -175,38 +332,51 @@ void ppu_reset(Ppu* ppu) {
     ppu->b_sprite_zero_hit_possible = false;
     ppu->b_sprite_zero_being_rendered = false;
     ppu->p_oam = (uint8_t*)ppu->oam;
+    ppu->oam_dirty = true;
     ppu->frame_done = false;
-    ppu->nmi_occurred = false;
+#ifdef PPU_SCANLINE_RENDER
+    ppu->line_pending = false;
+    ppu->line_hit_known = false;
+    ppu->line_dots_until = 0;
+#endif
 }
 
 
 // PPU Scrolling & Background Shifter Functions
-void ppu_increment_scroll_x(Ppu* ppu) {
-    if (ppu->registers.mask.render_background || ppu->registers.mask.render_sprites) {
-        if (ppu->vram_addr.coarse_x == 31) {
-            ppu->vram_addr.coarse_x = 0;
-            ppu->vram_addr.nametable_x = ~ppu->vram_addr.nametable_x;
+static inline void loopy_increment_x(LoopyRegister* v) {
+    if (v->coarse_x == 31) {
+        v->coarse_x = 0;
+        v->nametable_x = ~v->nametable_x;
+    } else {
+        v->coarse_x++;
+    }
+}
+
+static inline void loopy_increment_y(LoopyRegister* v) {
+    if (v->fine_y < 7) {
+        v->fine_y++;
+    } else {
+        v->fine_y = 0;
+        if (v->coarse_y == 29) {
+            v->coarse_y = 0;
+            v->nametable_y = ~v->nametable_y;
+        } else if (v->coarse_y == 31) {
+            v->coarse_y = 0;
         } else {
-            ppu->vram_addr.coarse_x++;
+            v->coarse_y++;
         }
     }
 }
 
+void ppu_increment_scroll_x(Ppu* ppu) {
+    if (ppu->registers.mask.render_background || ppu->registers.mask.render_sprites) {
+        loopy_increment_x(&ppu->vram_addr);
+    }
+}
+
 void ppu_increment_scroll_y(Ppu* ppu) {
     if (ppu->registers.mask.render_background || ppu->registers.mask.render_sprites) {
-        if (ppu->vram_addr.fine_y < 7) {
-            ppu->vram_addr.fine_y++;
-        } else {
-            ppu->vram_addr.fine_y = 0;
-            if (ppu->vram_addr.coarse_y == 29) {
-                ppu->vram_addr.coarse_y = 0;
-                ppu->vram_addr.nametable_y = ~ppu->vram_addr.nametable_y;
-            } else if (ppu->vram_addr.coarse_y == 31) {
-                ppu->vram_addr.coarse_y = 0;
-            } else {
-                ppu->vram_addr.coarse_y++;
-            }
-        }
+        loopy_increment_y(&ppu->vram_addr);
     }
 }
 
@@ -244,30 +414,38 @@ void ppu_update_shifters(Ppu* ppu) {
             if (ppu->sprite_scanline[i].x > 0) {
                 ppu->sprite_scanline[i].x--;
             } else {
-                ppu->sprite_shifter_pattern_lo[i] <<= 1;
-                ppu->sprite_shifter_pattern_hi[i] <<= 1;
+                ppu->sprite_shifter_pattern[i] >>= 8;
             }
         }
     }
 }
 
 
-// PPU Clock & Rendering Process
-void ppu_clock(Ppu* ppu) {
+// Sort the sprites into the scanlines they are on (see PPU_SPRITE_LINES), keeping the first 8 on each
+static void ppu_bucket_sprites(Ppu* ppu) {
+    int height = ppu->registers.ctrl.sprite_size ? 16 : 8;
+    memset(ppu->sprite_bucket_count, 0, sizeof(ppu->sprite_bucket_count));
+    for (uint8_t n = 0; n < 64; n++) {
+        for (int line = ppu->oam[n].y; line < ppu->oam[n].y + height && line < PPU_SPRITE_LINES; line++) {
+            if (ppu->sprite_bucket_count[line] < 8) {
+                ppu->sprite_bucket[line][ppu->sprite_bucket_count[line]++] = n;
+            }
+        }
+    }
+    ppu->oam_dirty = false;
+}
+
+
+// PPU Clock & Rendering Process (one dot)
+static void ppu_clock_dot(Ppu* ppu) {
     // Pre-render and visible scanlines
     if (ppu->scanline >= -1 && ppu->scanline < 240) {
-        if (ppu->scanline == 0 && ppu->cycle == 0 &&
-            (ppu->frames_completed % 2 != 0) &&
-            (ppu->registers.mask.render_background || ppu->registers.mask.render_sprites)) {
-            ppu->cycle = 1;
-        }
         if (ppu->scanline == -1 && ppu->cycle == 1) {
             ppu->registers.status.vertical_blank = 0;
             ppu->registers.status.sprite_overflow = 0;
             ppu->registers.status.sprite_zero_hit = 0;
             for (size_t i = 0; i < 8; i++) {
-                ppu->sprite_shifter_pattern_lo[i] = 0;
-                ppu->sprite_shifter_pattern_hi[i] = 0;
+                ppu->sprite_shifter_pattern[i] = 0;
             }
         }
         if ((ppu->cycle >= 2 && ppu->cycle < 258) ||
@@ -325,85 +503,38 @@ void ppu_clock(Ppu* ppu) {
 
     // Sprite evaluation (cycle 257)
     if (ppu->cycle == 257 && ppu->scanline >= 0) {
-        memset(ppu->sprite_scanline, 0xFF, 8 * sizeof(sObjectAttributeEntry));
-        ppu->sprite_count = 0;
         for (uint8_t i = 0; i < 8; i++) {
-            ppu->sprite_shifter_pattern_lo[i] = 0;
-            ppu->sprite_shifter_pattern_hi[i] = 0;
-        }
-        uint8_t n_oam_entry = 0;
-        ppu->b_sprite_zero_hit_possible = false;
-        while (n_oam_entry < 64 && ppu->sprite_count < 9) {
-            int16_t diff = ((int16_t)ppu->scanline - (int16_t)ppu->oam[n_oam_entry].y);
-            if (diff >= 0 && diff < (ppu->registers.ctrl.sprite_size ? 16 : 8) && ppu->sprite_count < 8) {
-                if (n_oam_entry == 0) {
-                    ppu->b_sprite_zero_hit_possible = true;
-                }
-                memcpy(&ppu->sprite_scanline[ppu->sprite_count],
-                       &ppu->oam[n_oam_entry],
-                       sizeof(sObjectAttributeEntry));
-                ppu->sprite_count++;
-            }
-            n_oam_entry++;
+            ppu->sprite_shifter_pattern[i] = 0;
+        }
+        if (ppu->oam_dirty) {
+            ppu_bucket_sprites(ppu);
         }
+        const uint8_t* bucket = ppu->sprite_bucket[ppu->scanline];
+        ppu->sprite_count = ppu->sprite_bucket_count[ppu->scanline];
+        for (uint8_t i = 0; i < ppu->sprite_count; i++) {
+            ppu->sprite_scanline[i] = ppu->oam[bucket[i]];
+        }
+        ppu->b_sprite_zero_hit_possible = (ppu->sprite_count > 0 && bucket[0] == 0);
         ppu->registers.status.sprite_overflow = (ppu->sprite_count >= 8);
     }
 
     // Sprite fetching (cycle 340)
     if (ppu->cycle == 340) {
         for (uint8_t i = 0; i < ppu->sprite_count; i++) {
-            uint8_t sprite_pattern_bits_lo, sprite_pattern_bits_hi;
-            uint16_t sprite_pattern_addr_lo, sprite_pattern_addr_hi;
+            // Row of the sprite on this scanline (counted from the bottom if it's flipped vertically), in 8x16
+            // mode the top or bottom tile of the pair its id picks
+            sObjectAttributeEntry* sprite = &ppu->sprite_scanline[i];
+            int row = ppu->scanline - sprite->y;
+            uint16_t sprite_pattern_addr_lo;
             if (!ppu->registers.ctrl.sprite_size) {
-                // 8x8 Sprite Mode
-                if (!(ppu->sprite_scanline[i].attribute & 0x80)) {
-                    sprite_pattern_addr_lo = 
-                        (ppu->registers.ctrl.pattern_sprite << 12) |
-                        (ppu->sprite_scanline[i].id << 4) |
-                        (ppu->scanline - ppu->sprite_scanline[i].y);
-                } else {
-                    sprite_pattern_addr_lo = 
-                        (ppu->registers.ctrl.pattern_sprite << 12) |
-                        (ppu->sprite_scanline[i].id << 4) |
-                        (7 - (ppu->scanline - ppu->sprite_scanline[i].y));
-                }
+                row = (sprite->attribute & 0x80) ? 7 - row : row;
+                sprite_pattern_addr_lo = (ppu->registers.ctrl.pattern_sprite << 12) | (sprite->id << 4) | row;
             } else {
-                // 8x16 Sprite Mode
-                if (!(ppu->sprite_scanline[i].attribute & 0x80)) {
-                    if (ppu->scanline - ppu->sprite_scanline[i].y < 8) {
-                        sprite_pattern_addr_lo = 
-                            ((ppu->sprite_scanline[i].id & 0x01) << 12) |
-                            ((ppu->sprite_scanline[i].id & 0xFE) << 4) |
-                            ((ppu->scanline - ppu->sprite_scanline[i].y) & 0x07);
-                    } else {
-                        sprite_pattern_addr_lo = 
-                            ((ppu->sprite_scanline[i].id & 0x01) << 12) |
-                            (((ppu->sprite_scanline[i].id & 0xFE) + 1) << 4) |
-                            ((ppu->scanline - ppu->sprite_scanline[i].y) & 0x07);
-                    }
-                } else {
-                    if (ppu->scanline - ppu->sprite_scanline[i].y < 8) {
-                        sprite_pattern_addr_lo = 
-                            ((ppu->sprite_scanline[i].id & 0x01) << 12) |
-                            (((ppu->sprite_scanline[i].id & 0xFE) + 1) << 4) |
-                            (7 - ((ppu->scanline - ppu->sprite_scanline[i].y) & 0x07));
-                    } else {
-                        sprite_pattern_addr_lo = 
-                            ((ppu->sprite_scanline[i].id & 0x01) << 12) |
-                            ((ppu->sprite_scanline[i].id & 0xFE) << 4) |
-                            (7 - ((ppu->scanline - ppu->sprite_scanline[i].y) & 0x07));
-                    }
-                }
-            }
-            sprite_pattern_addr_hi = sprite_pattern_addr_lo + 8;
-            sprite_pattern_bits_lo = ppu_read(ppu, sprite_pattern_addr_lo);
-            sprite_pattern_bits_hi = ppu_read(ppu, sprite_pattern_addr_hi);
-            if (ppu->sprite_scanline[i].attribute & 0x40) {
-                sprite_pattern_bits_lo = flipbyte(sprite_pattern_bits_lo);
-                sprite_pattern_bits_hi = flipbyte(sprite_pattern_bits_hi);
+                row = (sprite->attribute & 0x80) ? 15 - row : row;
+                sprite_pattern_addr_lo = ((sprite->id & 0x01) << 12) | (((sprite->id & 0xFE) + (row >= 8)) << 4) | (row & 0x07);
             }
-            ppu->sprite_shifter_pattern_lo[i] = sprite_pattern_bits_lo;
-            ppu->sprite_shifter_pattern_hi[i] = sprite_pattern_bits_hi;
+            // Both planes of the row, already decoded (and flipped if the sprite is)
+            ppu->sprite_shifter_pattern[i] = ppu_pattern_row(ppu, sprite_pattern_addr_lo, sprite->attribute & 0x40);
         }
     }
 
@@ -412,7 +543,7 @@ void ppu_clock(Ppu* ppu) {
         if (ppu->scanline == 241 && ppu->cycle == 1) {
             ppu->registers.status.vertical_blank = 1;
             if (ppu->registers.ctrl.enable_nmi) {
-                ppu->nmi_occurred = true;
+                interrupts_nmi(ppu->interrupts, ppu->dot_count);
             }
         }
     }
@@ -436,9 +567,7 @@ void ppu_clock(Ppu* ppu) {
             ppu->b_sprite_zero_being_rendered = false;
             for (uint8_t i = 0; i < ppu->sprite_count; i++) {
                 if (ppu->sprite_scanline[i].x == 0) {
-                    uint8_t fg_pixel_lo = (ppu->sprite_shifter_pattern_lo[i] & 0x80) > 0;
-                    uint8_t fg_pixel_hi = (ppu->sprite_shifter_pattern_hi[i] & 0x80) > 0;
-                    fg_pixel = (fg_pixel_hi << 1) | fg_pixel_lo;
+                    fg_pixel = ppu->sprite_shifter_pattern[i] & 0x03;
                     fg_palette = (ppu->sprite_scanline[i].attribute & 0x03) + 0x04;
                     fg_priority = (ppu->sprite_scanline[i].attribute & 0x20) == 0;
                     if (fg_pixel != 0) {
@@ -480,11 +609,12 @@ void ppu_clock(Ppu* ppu) {
     if ((ppu->cycle - 1) >= 0 && (ppu->cycle - 1) < PPU_SCREEN_WIDTH &&
         ppu->scanline >= 0 && ppu->scanline < PPU_SCREEN_HEIGHT) {
         ppu->framebuffer[ppu->scanline * PPU_SCREEN_WIDTH + (ppu->cycle - 1)] =
-            get_palette_colour(ppu_read(ppu, 0x3F00 + (palette << 2) + pixel));
+            ppu->palette_colours[(palette << 2) + pixel];
     }
 
     // Advance PPU cycle and update scanline/frame counters.
     ppu->cycle++;
+    ppu->dot_count++;
     if (ppu->registers.mask.render_background || ppu->registers.mask.render_sprites) {
         if (ppu->cycle == 260 && ppu->scanline < 240) {
             // Mapper-specific scanline interrupt handling (if applicable)
@@ -501,6 +631,219 @@ void ppu_clock(Ppu* ppu) {
     }
 }
 
+#ifdef PPU_SCANLINE_RENDER
+// Background fetches never reach the palette, so they are a memory map lookup
+static inline uint8_t ppu_fetch(Ppu* ppu, uint16_t address) {
+    const uint8_t* page = ppu->read_page[address >> 10];
+    return page ? page[address & 0x03FF] : ppu_read(ppu, address);
+}
+
+// Dots 1-256 of a visible scanline in one pass, from the state they start in, with the same results as
+// 'ppu_clock_dot' running them one after another (see PPU_SCANLINE_RENDER). Always draws the scanline, only
+// keeps the state they leave behind if 'commit' (otherwise it just finds out when sprite zero hits).
+// Returns the dot sprite zero hits on, 0 if it doesn't.
+static int ppu_render_line(Ppu* ppu, bool commit) {
+    PpuMask mask = ppu->registers.mask;
+    bool rendering = mask.render_background || mask.render_sprites;
+    uint16_t pattern_base = ppu->registers.ctrl.pattern_background << 12;
+
+    // Background: the shifters give out pixels in the order tiles went into them, starting 'fine_x' in (the two
+    // tiles already in them, then each tile fetched along the line), as palette indices (0 where transparent)
+    uint8_t bg_stream[16 + PPU_SCREEN_WIDTH];
+    LoopyRegister v = ppu->vram_addr;
+    uint16_t pattern_lo = ppu->bg_shifter_pattern_lo, pattern_hi = ppu->bg_shifter_pattern_hi;
+    uint16_t attrib_lo = ppu->bg_shifter_attrib_lo, attrib_hi = ppu->bg_shifter_attrib_hi;
+    uint8_t tile_id = ppu->bg_next_tile_id, tile_attr = ppu->bg_next_tile_attr;
+    uint8_t tile_lsb = ppu->bg_next_tile_lsb, tile_msb = ppu->bg_next_tile_msb;
+    for (int i = 0; i < 16; i++) {
+        uint8_t pixel = ((pattern_lo >> (15 - i)) & 0x01) | (((pattern_hi >> (15 - i)) & 0x01) << 1);
+        uint8_t palette = ((attrib_lo >> (15 - i)) & 0x01) | (((attrib_hi >> (15 - i)) & 0x01) << 1);
+        bg_stream[i] = pixel ? (palette << 2) | pixel : 0x00;
+    }
+    for (int tile = 0; tile < 32; tile++) {
+        // First dot of the tile: shift, load the tile fetched over the last 8 dots, fetch the next one's id
+        if (tile > 0) {
+            if (mask.render_background) {
+                pattern_lo <<= 1;
+                pattern_hi <<= 1;
+                attrib_lo <<= 1;
+                attrib_hi <<= 1;
+            }
+            pattern_lo = (pattern_lo & 0xFF00) | tile_lsb;
+            pattern_hi = (pattern_hi & 0xFF00) | tile_msb;
+            attrib_lo = (attrib_lo & 0xFF00) | ((tile_attr & 0b01) ? 0xFF : 0x00);
+            attrib_hi = (attrib_hi & 0xFF00) | ((tile_attr & 0b10) ? 0xFF : 0x00);
+            tile_id = ppu_fetch(ppu, 0x2000 | (v.reg & 0x0FFF));
+        }
+        if (mask.render_background) {
+            pattern_lo <<= 7;
+            pattern_hi <<= 7;
+            attrib_lo <<= 7;
+            attrib_hi <<= 7;
+        }
+
+        // The rest of the next tile's fetches, its pixels straight from the tile cache, then on to the tile after
+        tile_attr = ppu_fetch(ppu, 0x23C0 | (v.nametable_y << 11) | (v.nametable_x << 10) |
+                                   ((v.coarse_y >> 2) << 3) | (v.coarse_x >> 2));
+        if (v.coarse_y & 0x02) tile_attr >>= 4;
+        if (v.coarse_x & 0x02) tile_attr >>= 2;
+        tile_attr &= 0x03;
+        uint16_t address = pattern_base + ((uint16_t)tile_id << 4) + v.fine_y;
+        tile_lsb = ppu_fetch(ppu, address);
+        tile_msb = ppu_fetch(ppu, address + 8);
+        if (mask.render_background) {
+            uint64_t row = ppu_pattern_row(ppu, address, false);
+            uint8_t* out = &bg_stream[16 + tile * 8];
+            for (int x = 0; x < 8; x++) {
+                uint8_t pixel = (row >> (8 * x)) & 0x03;
+                out[x] = pixel ? (tile_attr << 2) | pixel : 0x00;
+            }
+        }
+        if (rendering) {
+            loopy_increment_x(&v);
+        }
+    }
+    if (rendering) {
+        loopy_increment_y(&v);
+    }
+    const uint8_t* bg_line = &bg_stream[ppu->fine_x];
+    if (!mask.render_background) {
+        memset(bg_stream, 0x00, sizeof(bg_stream));
+    }
+
+    // Sprites: palette index of the first opaque sprite at each pixel, plus its priority and whether it's sprite zero
+    uint8_t fg_line[PPU_SCREEN_WIDTH];
+    memset(fg_line, 0x00, sizeof(fg_line));
+    bool zero_being_rendered = ppu->b_sprite_zero_being_rendered;
+    if (mask.render_sprites) {
+        // Each sprite's counter reaches 0 on its X, after which its shifters move one pixel per dot
+        for (int i = ppu->sprite_count - 1; i >= 0; i--) {
+            int x0 = ppu->sprite_scanline[i].x;
+            uint8_t attribute = ppu->sprite_scanline[i].attribute;
+            uint8_t entry = 0x10 | ((attribute & 0x03) << 2) | ((attribute & 0x20) ? 0 : COMPOSE_SPRITE_FRONT) | (i == 0 ? COMPOSE_SPRITE_ZERO : 0);
+            for (int x = 0; x < 8 && x0 + x < PPU_SCREEN_WIDTH; x++) {
+                uint8_t pixel = (ppu->sprite_shifter_pattern[i] >> (8 * x)) & 0x03;
+                if (pixel) {
+                    fg_line[x0 + x] = entry | pixel;
+                }
+            }
+        }
+        zero_being_rendered = (fg_line[PPU_SCREEN_WIDTH - 1] & COMPOSE_SPRITE_ZERO) != 0;
+    }
+
+    // Merge the two into colours (see Compose.h)
+    uint32_t* row = &ppu->framebuffer[ppu->scanline * PPU_SCREEN_WIDTH];
+    int hit_dot = ppu->compose(row, bg_line, fg_line, ppu->palette_colours,
+                               mask.render_background_left, mask.render_sprites_left);
+    if (!ppu->b_sprite_zero_hit_possible) {
+        hit_dot = 0;
+    }
+
+    if (commit) {
+        ppu->vram_addr = v;
+        ppu->bg_shifter_pattern_lo = pattern_lo;
+        ppu->bg_shifter_pattern_hi = pattern_hi;
+        ppu->bg_shifter_attrib_lo = attrib_lo;
+        ppu->bg_shifter_attrib_hi = attrib_hi;
+        ppu->bg_next_tile_id = tile_id;
+        ppu->bg_next_tile_attr = tile_attr;
+        ppu->bg_next_tile_lsb = tile_lsb;
+        ppu->bg_next_tile_msb = tile_msb;
+        if (mask.render_sprites) {
+            // Counters count down over dots 2-256, shifters shift on the dots after
+            for (int i = 0; i < ppu->sprite_count; i++) {
+                int shifts = PPU_SCREEN_WIDTH - 1 - ppu->sprite_scanline[i].x;
+                ppu->sprite_scanline[i].x = 0;
+                ppu->sprite_shifter_pattern[i] = (shifts >= 8) ? 0 : ppu->sprite_shifter_pattern[i] >> (8 * shifts);
+            }
+        }
+        ppu->b_sprite_zero_being_rendered = zero_being_rendered;
+        if (hit_dot) {
+            ppu->registers.status.sprite_zero_hit = 1;
+        }
+    }
+    return hit_dot;
+}
+
+// Run the dots of this scanline that were clocked but not run yet one at a time, and leave the rest of it to the
+// dot renderer (something is about to change what they would draw, or look at what they did)
+static void ppu_catch_up(Ppu* ppu) {
+    if (!ppu->line_pending) {
+        return;
+    }
+    int dots = ppu->cycle - 1;
+    ppu->line_pending = false;
+    ppu->line_hit_known = false;
+    ppu->line_dots_until = ppu->dot_count + (257 - ppu->cycle);
+    ppu->lines_caught_up++;
+    ppu->cycle = 1;
+    ppu->dot_count -= dots;
+    for (int i = 0; i < dots; i++) {
+        ppu_clock_dot(ppu);
+    }
+}
+#endif
+
+// PPU clock: one dot, or on a visible scanline, counts it towards the next 'ppu_render_line'
+void ppu_clock(Ppu* ppu) {
+    // Odd frames skip the first dot of scanline 0 when rendering
+    if (ppu->scanline == 0 && ppu->cycle == 0 &&
+        (ppu->frames_completed % 2 != 0) &&
+        (ppu->registers.mask.render_background || ppu->registers.mask.render_sprites)) {
+        ppu->cycle = 1;
+    }
+
+#ifdef PPU_SCANLINE_RENDER
+    if (ppu->scanline >= 0 && ppu->scanline < PPU_SCREEN_HEIGHT && ppu->cycle >= 1 && ppu->cycle <= 256 &&
+        ppu->scanline_render && ppu->dot_count >= ppu->line_dots_until) {
+        ppu->line_pending = true;
+        ppu->cycle++;
+        ppu->dot_count++;
+        if (ppu->cycle == 257) {
+            ppu_render_line(ppu, true);
+            ppu->lines_rendered++;
+            ppu->line_pending = false;
+            ppu->line_hit_known = false;
+        }
+        return;
+    }
+#endif
+    ppu_clock_dot(ppu);
+}
+
+// Until then, nothing the PPU does can be seen by a CPU that isn't touching PPU registers,
+// so the CPU may run that far ahead of it (see 'cpu_run_block').
+int ppu_dots_until_event(Ppu* ppu) {
+    int position = (ppu->scanline + 1) * 341 + ppu->cycle;  // 0 at the start of the pre-render scanline
+    int vblank = (241 + 1) * 341 + 1;                       // Scanline 241, cycle 1
+    int frame_end = (260 + 1) * 341 + 340;                  // Last cycle of scanline 260
+    int next = (position <= vblank) ? vblank : frame_end;
+    return next - position + 1;
+}
+
+int ppu_dots_until_status_change(Ppu* ppu) {
+    // Sprite zero can hit on any visible dot
+    if (ppu->scanline >= 0 && ppu->scanline < 240) {
+        return 0;
+    }
+
+    int position = (ppu->scanline + 1) * 341 + ppu->cycle;  // 0 at the start of the pre-render scanline
+    int next;
+    if (ppu->scanline < 0) {
+        // Flags cleared at cycle 1, then the visible scanlines
+        next = (ppu->cycle <= 1) ? 1 : 341;
+    } else {
+        // Sprite overflow is re-evaluated at cycle 257 of every line (vblank itself is one of the events)
+        next = (ppu->scanline + 1) * 341 + 257;
+        if (position > next) {
+            next += 341;
+        }
+    }
+    int dots = next - position + 1;
+    int event = ppu_dots_until_event(ppu);
+    return (dots < event) ? dots : event;
+}
+
 
 // CPU 'Interface' for PPU Registers
 uint8_t cpu_ppu_read(Ppu* ppu, uint16_t address) {
@@ -508,6 +851,18 @@ uint8_t cpu_ppu_read(Ppu* ppu, uint16_t address) {
     switch (address) {
         case 0x0002: // Status
             data = (ppu->registers.status.reg & 0xE0) | (ppu->ppu_data_buffer & 0x1F);
+#ifdef PPU_SCANLINE_RENDER
+            // Part way through a scanline that hasn't been run yet, all that can have changed is sprite zero hit
+            if (ppu->line_pending) {
+                if (!ppu->line_hit_known) {
+                    ppu->line_hit_dot = ppu_render_line(ppu, false);
+                    ppu->line_hit_known = true;
+                }
+                if (ppu->line_hit_dot && ppu->line_hit_dot < ppu->cycle) {
+                    data |= 0x40;
+                }
+            }
+#endif
             ppu->registers.status.vertical_blank = 0;
             ppu->address_latch = 0;
             break;
@@ -518,6 +873,9 @@ uint8_t cpu_ppu_read(Ppu* ppu, uint16_t address) {
             data = ppu->p_oam[ppu->oam_addr];
             break;
         case 0x0007: // PPU Data
+#ifdef PPU_SCANLINE_RENDER
+            ppu_catch_up(ppu);
+#endif
             data = ppu->ppu_data_buffer;
             ppu->ppu_data_buffer = ppu_read(ppu, ppu->vram_addr.reg);
             if (ppu->vram_addr.reg >= 0x3F00) {
@@ -533,20 +891,40 @@ uint8_t cpu_ppu_read(Ppu* ppu, uint16_t address) {
 }
 
 void cpu_ppu_write(Ppu* ppu, uint16_t address, uint8_t data) {
+#ifdef PPU_SCANLINE_RENDER
+    // Everything but OAM (only looked at after the last pixel) changes what the rest of the scanline draws
+    if (address != 0x0003 && address != 0x0004) {
+        ppu_catch_up(ppu);
+    }
+#endif
     switch (address) {
         case 0x0000: // Control
+            // Enabling the NMI while the vblank flag is still set is another edge on the NMI line
+            if (!ppu->registers.ctrl.enable_nmi && (data & 0x80) && ppu->registers.status.vertical_blank) {
+                interrupts_nmi(ppu->interrupts, ppu->dot_count);
+            }
+            if (ppu->registers.ctrl.sprite_size != ((data >> 5) & 0x01)) {
+                ppu->oam_dirty = true;
+            }
             ppu->registers.ctrl.reg = data;
             ppu->tram_addr.nametable_x = ppu->registers.ctrl.nametable_x;
             ppu->tram_addr.nametable_y = ppu->registers.ctrl.nametable_y;
             break;
         case 0x0001: // Mask
-            ppu->registers.mask.reg = data;
+            if (ppu->registers.mask.grayscale != (data & 0x01)) {
+                // Grayscale changes every colour (the emphasis bits aren't emulated, so they change none)
+                ppu->registers.mask.reg = data;
+                ppu_resolve_palette(ppu);
+            } else {
+                ppu->registers.mask.reg = data;
+            }
             break;
         case 0x0003: // OAM Address
             ppu->oam_addr = data;
             break;
         case 0x0004: // OAM Data
             ppu->p_oam[ppu->oam_addr] = data;
+            ppu->oam_dirty = true;
             break;
         case 0x0005: // Scroll
             if (ppu->address_latch == 0) {
@@ -581,69 +959,52 @@ void cpu_ppu_write(Ppu* ppu, uint16_t address, uint8_t data) {
 
 // Internal PPU Memory Access Functions
 uint8_t ppu_read(Ppu* ppu, uint16_t address) {
-    uint8_t data = 0x00;
     address &= 0x3FFF;
-    if (cartridge_ppu_read(ppu->cart, address, &data)) {
-        // Read handled by cartridge, perfect!
-    }
-    else if (address <= 0x1FFF) { // Pattern table region
-        data = ppu->pattern_table[(address & 0x1000) >> 12][address & 0x0FFF];
-    }
-    else if (address >= 0x2000 && address <= 0x3EFF) { // Name table region
-        address &= 0x0FFF;
-        if (ppu->cart->mirror == VERTICAL) {
-            if (address <= 0x03FF) data = ppu->name_table[0][address & 0x03FF];
-            else if (address <= 0x07FF) data = ppu->name_table[1][address & 0x03FF];
-            else if (address <= 0x0BFF) data = ppu->name_table[0][address & 0x03FF];
-            else if (address <= 0x0FFF) data = ppu->name_table[1][address & 0x03FF];
-        }
-        else if (ppu->cart->mirror == HORIZONTAL) {
-            if (address <= 0x03FF) data = ppu->name_table[0][address & 0x03FF];
-            else if (address <= 0x07FF) data = ppu->name_table[0][address & 0x03FF];
-            else if (address <= 0x0BFF) data = ppu->name_table[1][address & 0x03FF];
-            else if (address <= 0x0FFF) data = ppu->name_table[1][address & 0x03FF];
-        }
-    }
-    else if (address >= 0x3F00 && address <= 0x3FFF) { // Palette region
+    if (address >= 0x3F00) { // Palette region
         address &= 0x001F;
         if (address == 0x0010) address = 0x0000;
         if (address == 0x0014) address = 0x0004;
         if (address == 0x0018) address = 0x0008;
         if (address == 0x001C) address = 0x000C;
-        data = ppu->palette_table[address] & (ppu->registers.mask.grayscale ? 0x30 : 0x3F);
+        return ppu->palette_table[address] & (ppu->registers.mask.grayscale ? 0x30 : 0x3F);
     }
+
+    // Pattern and name tables, straight from the memory map
+    const uint8_t* page = ppu->read_page[address >> 10];
+    if (page) {
+        return page[address & 0x03FF];
+    }
+    uint8_t data = 0x00;
+    cartridge_ppu_read(ppu->cart, address, &data);
     return data;
 }
 
 void ppu_write(Ppu* ppu, uint16_t address, uint8_t data) {
     address &= 0x3FFF;
-    if (cartridge_ppu_write(ppu->cart, address, data)) {
-        // Write handled by cartridge, perfect!
-    }
-    else if (address <= 0x1FFF) { // Pattern table region
-        ppu->pattern_table[(address & 0x1000) >> 12][address & 0x0FFF] = data;
-    }
-    else if (address >= 0x2000 && address <= 0x3EFF) { // Name table region
-        address &= 0x0FFF;
-        if (ppu->cart->mirror == VERTICAL) {
-            if (address <= 0x03FF) ppu->name_table[0][address & 0x03FF] = data;
-            else if (address <= 0x07FF) ppu->name_table[1][address & 0x03FF] = data;
-            else if (address <= 0x0BFF) ppu->name_table[0][address & 0x03FF] = data;
-            else if (address <= 0x0FFF) ppu->name_table[1][address & 0x03FF] = data;
-        }
-        else if (ppu->cart->mirror == HORIZONTAL) {
-            if (address <= 0x03FF) ppu->name_table[0][address & 0x03FF] = data;
-            else if (address <= 0x07FF) ppu->name_table[0][address & 0x03FF] = data;
-            else if (address <= 0x0BFF) ppu->name_table[1][address & 0x03FF] = data;
-            else if (address <= 0x0FFF) ppu->name_table[1][address & 0x03FF] = data;
-        }
-    }
-    else if (address >= 0x3F00 && address <= 0x3FFF) { // Palette region
+    if (address >= 0x3F00) { // Palette region
         address &= 0x001F;
         if (address == 0x0010) address = 0x0000;
         if (address == 0x0014) address = 0x0004;
         if (address == 0x0018) address = 0x0008;
         if (address == 0x001C) address = 0x000C;
         ppu->palette_table[address] = data;
+        ppu_resolve_colour(ppu, address);
+        return;
+    }
+
+    uint8_t* page = ppu->write_page[address >> 10];
+    if (page) {
+        page[address & 0x03FF] = data;
+    } else {
+        cartridge_ppu_write(ppu->cart, address, data);
+    }
+
+    // Decode the row written again (where the cartridge took it some other way, the row read back there)
+    if (address <= 0x1FFF) {
+        const uint8_t* memory = page ? page : ppu->read_page[address >> 10];
+        PpuTile* tile = memory ? tile_at(ppu, &memory[address & 0x03F0]) : NULL;
+        if (tile) {
+            decode_tile_row(tile, &memory[address & 0x03F0], address & 0x07);
+        }
     }
 }
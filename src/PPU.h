@@ -1,6 +1,8 @@
 #pragma once
 
 #include "Cartridge.h"
+#include "Interrupts.h"
+#include "Compose.h"
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -10,6 +12,37 @@
 #define PPU_SCREEN_WIDTH 256
 #define PPU_SCREEN_HEIGHT 240
 
+// PPU memory map: one entry per 1KB of $0000-$3FFF
+//   $0000-$1FFF - Pattern tables (CHR from the cartridge, else the PPU's own 'pattern_table')
+//   $2000-$2FFF - Nametables, each entry pointing at the 1KB of VRAM the mirroring puts there
+//   $3000-$3FFF - Mirror of $2000-$2FFF, except the palette ($3F00-$3FFF) which is handled before the table
+// Rebuilt by 'ppu_map_memory' whenever the cartridge changes, switches banks or changes the mirroring,
+// so a fetch is a single lookup rather than a call into the mapper and a walk through the mirroring modes
+#define PPU_PAGES 16
+
+// Pattern tile cache: every tile of CHR memory (and of the PPU's own 'pattern_table') decoded ahead of time into
+// rows of pixel indices (0-3), one byte per pixel, with a horizontally flipped copy for sprites. The pattern pages
+// ($0000-$1FFF) point into it next to 'read_page', so a fetch gets a whole row of pixels in one lookup instead of
+// two plane bytes to pull apart a bit at a time. Remapped with 'read_page' on bank switches, and the row written
+// decoded again on every write to pattern memory (CHR RAM)
+#define PPU_PATTERN_PAGES 8
+
+// Scanline renderer: the dots of a visible scanline up to the last pixel (1-256) are only counted as they are
+// clocked, and run all at once when the last of them is ('ppu_render_line'): 32 tile fetches, the sprites merged
+// into a line buffer and the palette resolved once, with the same results as running them one at a time.
+// Anything that could change what they draw or see what they did part way through (writing $2000/$2001/$2005/
+// $2006/$2007, reading $2007, a CHR bank or mirroring change) first catches the line up dot by dot and leaves the
+// rest of it to the dot renderer. Reading $2002 doesn't, the line works out when sprite zero hits without drawing.
+// Build with -DPPU_NO_SCANLINE_RENDER (or clear 'scanline_render' at runtime) to run every dot on its own
+#ifndef PPU_NO_SCANLINE_RENDER
+#define PPU_SCANLINE_RENDER
+#endif
+
+// Sprite buckets: sprite evaluation (dot 257 of scanlines 0-260) only looks up the scanline's list of sprites, the
+// first 8 OAM entries on it in OAM order. The lists are built in one pass over OAM the first time a scanline is
+// evaluated after OAM (DMA, $2004) or the sprite size changed, normally once a frame
+#define PPU_SPRITE_LINES 261
+
 // NTSC Timing: 262 scanlines per frame
 //   - Visible: 0-239
 //   - Post-render: 240
@@ -97,6 +130,13 @@ typedef struct sObjectAttributeEntry {
 
 
 
+// One decoded pattern tile (see PPU_PATTERN_PAGES)
+typedef struct PpuTile {
+    uint64_t rows[8];       // Pixel index of each row, pixel x (left to right) in bits 8x-8x+7
+    uint64_t flipped[8];    // The same rows mirrored horizontally
+} PpuTile;
+
+
 // PPU Main Structure
 
 typedef struct Ppu {
@@ -106,9 +146,21 @@ typedef struct Ppu {
     uint32_t framebuffer[PPU_SCREEN_WIDTH * PPU_SCREEN_HEIGHT];
 
     // PPU Memory: Nametables, Pattern Tables, and Palette.
-    uint8_t name_table[2][1024];
+    uint8_t name_table[4][1024];    // [0], [1]: the PPU's 2KB of VRAM, [2], [3]: only used by FOUR_SCREEN
     uint8_t pattern_table[2][4096]; // Not used in real emulation; kept for design.
     uint8_t palette_table[32];
+    uint32_t palette_colours[32];   // Framebuffer colour of each palette entry ($3F00-$3F1F, mirrors resolved),
+                                    // kept up to date by palette writes and grayscale changes
+
+    // Memory map (see PPU_PAGES), NULL entries are mapped by the cartridge but not contiguously (ask it each time)
+    const uint8_t* read_page[PPU_PAGES];
+    uint8_t* write_page[PPU_PAGES];
+
+    // Pattern tile cache (see PPU_PATTERN_PAGES), NULL pages aren't plain memory (decoded on each fetch)
+    const PpuTile* tile_page[PPU_PATTERN_PAGES];
+    PpuTile* chr_tiles;                 // The cartridge's CHR memory, decoded
+    size_t chr_tile_count;
+    PpuTile own_tiles[512];             // 'pattern_table', decoded
 
     // Sprite pointers for screen and internal representations.
     Sprite* spr_screen;
@@ -119,6 +171,7 @@ typedef struct Ppu {
     int scanline;
     int cycle;
     int frames_completed;
+    long long dot_count;        // Dots since power on (timestamps on the interrupt lines)
 
     // PPU Registers & VRAM Addressing
     PpuRegisters registers;
@@ -142,11 +195,15 @@ typedef struct Ppu {
     sObjectAttributeEntry oam[64];
     uint8_t oam_addr;
 
+    // Sprite buckets (see PPU_SPRITE_LINES), set 'oam_dirty' after writing OAM other than through $2004
+    uint8_t sprite_bucket[PPU_SPRITE_LINES][8];     // OAM entries on each scanline
+    uint8_t sprite_bucket_count[PPU_SPRITE_LINES];
+    bool oam_dirty;                                 // OAM or the sprite size changed since they were built
+
     // Sprite evaluation for current scanline.
     sObjectAttributeEntry sprite_scanline[8];
     uint8_t sprite_count;
-    uint8_t sprite_shifter_pattern_lo[8];
-    uint8_t sprite_shifter_pattern_hi[8];
+    uint64_t sprite_shifter_pattern[8];     // Decoded row of each sprite (see PpuTile), next pixel in the low byte
 
     // Sprite Zero hit flags.
     bool b_sprite_zero_hit_possible;
@@ -155,9 +212,23 @@ typedef struct Ppu {
     // Secondary OAM pointer for CPU sprite memory (if needed).
     uint8_t* p_oam;
 
-    // Flags indicating frame completion and NMI occurrence.
+    // Flag indicating frame completion.
     bool frame_done;
-    bool nmi_occurred;
+
+    // NMI output (the CPU's NMI line, shared through the bus).
+    Interrupts* interrupts;
+
+#ifdef PPU_SCANLINE_RENDER
+    // Scanline renderer (see PPU_SCANLINE_RENDER)
+    bool scanline_render;           // Off switch (accuracy testing)
+    ComposeLine compose;            // Compositing kernel ('compose_select' picks one, 'compose_line_scalar' is the reference)
+    bool line_pending;              // Dots of this scanline from 1 on have been clocked but not run yet
+    bool line_hit_known;            // 'line_hit_dot' has been worked out for them
+    int line_hit_dot;               // Dot sprite zero hits on in this scanline (0: it doesn't)
+    long long line_dots_until;      // Dot count up to which this scanline is left to the dot renderer
+    long long lines_rendered;       // Scanlines run in one pass
+    long long lines_caught_up;      // Scanlines handed back to the dot renderer part way through
+#endif
 } Ppu;
 
 
@@ -168,9 +239,24 @@ typedef struct Ppu {
 Ppu* init_ppu();
 void ppu_reset(Ppu* ppu);
 
+// Free the PPU (and its decoded CHR tiles).
+void free_ppu(Ppu* ppu);
+
+// Plug a cartridge into the PPU (NULL to take it out), decode its CHR memory and build its memory map.
+void ppu_attach_cartridge(Ppu* ppu, Cartridge* cart);
+
+// Rebuild the memory map (CHR banks and nametable mirroring), after a bank switch or mirroring change.
+void ppu_map_memory(Ppu* ppu);
+
 // PPU clock: advances the PPU by one cycle.
 void ppu_clock(Ppu* ppu);
 
+// Number of ppu_clock calls until (and including) the next one that can raise the NMI or finish the frame.
+int ppu_dots_until_event(Ppu* ppu);
+
+// Number of ppu_clock calls until (and including) the next one that can change what PPUSTATUS reads, 0 if any can.
+int ppu_dots_until_status_change(Ppu* ppu);
+
 // CPU interface for reading and writing PPU registers.
 uint8_t cpu_ppu_read(Ppu* ppu, uint16_t address);
 void cpu_ppu_write(Ppu* ppu, uint16_t address, uint8_t data);
@@ -0,0 +1,173 @@
+// System.c
+// Nintendo Entertainment System Implementation (the components wired together and clocked)
+#include "System.h"
+#include "Interrupts.h"
+#include "Mapper.h"
+
+System* init_system(const char* path) {
+    // Initialise .nes game ('Cartridge')
+    Cartridge* cart = init_cart(path);
+    if (!cart->mapper->mapper_cpu_read) {
+        fprintf(stderr, "[SYSTEM] Error, Mapper ID %d is not implemented.\n", cart->mapper_id);
+        free_cart(cart);
+        return NULL;
+    }
+
+    System* system = (System*)malloc(sizeof(System));
+    if (!system) {
+        fprintf(stderr, "[SYSTEM] Error, Failed to allocate memory for the system.\n");
+        exit(1);
+    }
+    system->cart = cart;
+
+    // Initialise Bus
+    printf("[SYSTEM] Initialising BUS...\n");
+    system->bus = init_bus();
+    printf("[SYSTEM] Assigning Game Cartridge reference to the BUS...\n");
+    bus_attach_cartridge(system->bus, cart);
+    printf("[SYSTEM] Initialising BUS finished!\n");
+
+    // Initialise PPU
+    printf("[SYSTEM] Initialising PPU...\n");
+    system->ppu = init_ppu();
+    printf("[SYSTEM] Assigning PPU reference to the BUS...\n");
+    system->bus->ppu = system->ppu;
+    printf("[SYSTEM] Assigning Game Cartridge reference to the PPU...\n");
+    ppu_attach_cartridge(system->ppu, cart);
+    printf("[SYSTEM] Connecting the PPU to the CPU's NMI line...\n");
+    system->ppu->interrupts = system->bus->interrupts;
+    printf("[SYSTEM] Initialising PPU finished!\n");
+
+    // Initialise CPU, from the reset vector (0xFFFC-0xFFFD)
+    printf("[SYSTEM] Initialising CPU...\n");
+    system->cpu = init_cpu(system->bus);
+    cpu_reset(system->cpu, system->bus);
+    system->cpu->cycles_left = 0;   // Power on runs from the vector straight away, only a reset waits out the sequence
+    printf("[SYSTEM] CPU PC set to reset vector 0x%04X\n", system->cpu->PC);
+    printf("[SYSTEM] Initialising CPU finished!\n");
+
+#ifdef CPU_HOTSPOT
+    system->hotspot = init_hotspot();
+#else
+    system->hotspot = NULL;
+#endif
+
+    system->nes_cycles_passed = 0;
+    printf("[SYSTEM] System initialised!\n\n");
+    return system;
+}
+
+void free_system(System* system) {
+    if (!system) {
+        return;
+    }
+    free(system->hotspot);
+    free_cpu(system->cpu);
+    free_ppu(system->ppu);
+    free_bus(system->bus);
+    free_cart(system->cart);
+    free(system);
+}
+
+// The PPU is clocked 3 times for every CPU cycle, in the same order the per-cycle loop used:
+//   PPU dot, CPU cycle, then the other two PPU dots
+// Interrupts are only looked at between instructions (see Interrupts.h), never per dot
+void system_clock(System* system, bool fast) {
+    Bus* bus = system->bus;
+    Ppu* ppu = system->ppu;
+    Cpu* cpu = system->cpu;
+    Interrupts* lines = bus->interrupts;
+    // CPU cycles left before the next instruction may start, beginning with any the CPU still owes from a reset
+    // ('cpu_reset' sets the 8 cycles of the reset sequence, which are counted down before the first instruction)
+    int cycles_left = cpu->cycles_left;
+
+    do {
+        // Do one PPU 'clock'
+        ppu_clock(ppu);
+
+        if (bus->dma_transfer) {
+            // The CPU is suspended during DMA, any cycles it still owes are paid once the transfer ends
+            // A transfer from RAM/ROM can be done in one go, only one from registers is always stepped a byte at a time
+            int dma_cycles = (fast && bus->dma_dummy && bus->dma_addr == 0x00) ?
+                             bus_oam_dma(bus, system->nes_cycles_passed % 2 != 0) : 0;
+            if (dma_cycles > 0) {
+                // Up to the first dot of its last cycle, the rest of that cycle is finished below
+                system->nes_cycles_passed += 3 * (dma_cycles - 1);
+            } else if (bus->dma_dummy) {
+                if (system->nes_cycles_passed % 2 == 0) {
+                    bus->dma_dummy = false;
+                }
+            } else {
+                // DMA can take place!
+                if (system->nes_cycles_passed % 2 != 0) {
+                    // On odd clock cycles (starting with the one after the dummy cycle), read from CPU bus
+                    bus->dma_data = bus_read(bus, bus->dma_page << 8 | bus->dma_addr);
+                } else {
+                    // On even clock cycles, write to PPU OAM
+                    ppu->p_oam[bus->dma_addr] = bus->dma_data;
+                    ppu->oam_dirty = true;
+                    // Increment the low byte of the address
+                    bus->dma_addr++;
+                    // If this wraps around, we know that 256
+                    // bytes have been written, so end the DMA
+                    // transfer, and proceed as normal
+                    if (bus->dma_addr == 0x00) {
+                        bus->dma_transfer = false;
+                        bus->dma_dummy = true;
+                    }
+                }
+            }
+        } else if (cycles_left == 0) {
+            // Between instructions, an interrupt the CPU polled during the last one goes first
+            if (lines->nmi || lines->irq) {
+                cycles_left = cpu_interrupt(cpu);
+            }
+            if (cycles_left == 0) {
+                // Run the whole instruction on its first cycle
+#if defined(CPU_IDLE_SKIP) || defined(CPU_HOTSPOT)
+                uint16_t pc = cpu->PC;                  // Where it started, for the idle loop check and the sampler
+#endif
+                long long dot = ppu->dot_count - 1;     // This cycle's first dot
+#ifdef CPU_JIT
+                // (or a whole compiled block, if it is sure to finish before the PPU can raise an NMI or end the frame)
+                if (fast) {
+                    int max_cycles = (lines->nmi || lines->irq) ? 0 : (ppu_dots_until_event(ppu) / 3) - 1;
+                    cycles_left = cpu_run_block(cpu, max_cycles);
+                } else {
+                    cycles_left = cpu_step(cpu);
+                }
+#else
+                cycles_left = cpu_step(cpu);
+#endif
+#ifdef CPU_IDLE_SKIP
+                // Jumped back, if it's round an idle loop the CPU can sit out the trips before the next PPU event
+                if (fast && cpu->PC <= pc) {
+                    cycles_left += idle_loop_skip(cpu->idle_loop, cpu, ppu, pc, cycles_left);
+                }
+#endif
+#ifdef CPU_HOTSPOT
+                // Every so many CPU cycles, sample the instruction they were spent in
+                Hotspot* hotspot = system->hotspot;
+                hotspot->countdown -= cycles_left;
+                if (hotspot->countdown <= 0) {
+                    hotspot_sample(hotspot, bus, pc);
+                }
+#endif
+                // The interrupt lines are polled as the last cycle starts
+                cpu->poll_dot = dot + 3 * (cycles_left - 1);
+            }
+            cycles_left--;
+        } else {
+            cycles_left--;
+        }
+
+        // The rest of this CPU cycle's PPU dots
+        ppu_clock(ppu);
+        ppu_clock(ppu);
+
+        system->nes_cycles_passed += 3;
+    } while (cycles_left > 0 || bus->dma_transfer);
+
+    // All paid ('cpu_step'/'cpu_interrupt' leave the cycles they took behind)
+    cpu->cycles_left = 0;
+}
@@ -0,0 +1,45 @@
+// System.h
+// Nintendo Entertainment System (Header File)
+#pragma once
+
+#include "Bus.h"
+#include "CPU.h"
+#include "PPU.h"
+#include "Cartridge.h"
+#include "Hotspot.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*///////SYSTEM////////////////////////////////////////////////////////////////////////////////////////
+
+The NES as a whole: a cartridge, the bus, PPU and CPU wired together, and how many PPU dots have passed.
+The emulator (Main.c) runs one, and the check tools in bench/ run two side by side.
+
+'system_clock' runs one whole CPU instruction (plus any OAM DMA it triggers), or an interrupt, in one go,
+then clocks the PPU 3 times for every CPU cycle it took. With 'fast' it also takes the shortcuts:
+    Bulk OAM DMA    - A transfer from RAM/ROM is done in one go, rather than a byte every other cycle
+    Idle loops      - The trips round an idle loop before the next PPU event are sat out (CPU_IDLE_SKIP)
+    JIT             - Whole compiled blocks are run natively (CPU_JIT)
+Without it every instruction and DMA cycle is stepped, the reference the shortcuts are checked against.
+
+///////////////////////////////////////////////////////////////////////////////////////////////////*/
+
+typedef struct System {
+    Cartridge* cart;
+    Bus* bus;
+    Ppu* ppu;
+    Cpu* cpu;
+    Hotspot* hotspot;               // Sampled every instruction when built with -DCPU_HOTSPOT, otherwise NULL
+    long long nes_cycles_passed;    // PPU dots since power on/reset
+} System;
+
+// Function to initialise a NES around the game at 'path', with the CPU at its reset vector
+// NULL if the emulator can't run the game (its mapper isn't implemented)
+System* init_system(const char* path);
+
+// Function to free a NES and everything in it (NULL is fine)
+void free_system(System* system);
+
+// Function to run one NES 'clock' (see above)
+void system_clock(System* system, bool fast);
@@ -0,0 +1,161 @@
+// Trace.c
+// Nintendo Entertainment System CPU Instruction Trace Implementation
+#include "Trace.h"
+#include "Bus.h"
+#include "CPU.h"
+#include "PPU.h"
+#include "Cartridge.h"
+
+#define TRACE_DRAIN_CHUNK 4096  // Records copied out of the ring at a time
+
+
+Trace* init_trace() {
+    Trace* trace = (Trace*)malloc(sizeof(Trace));
+    if (!trace) {
+        fprintf(stderr, "[TRACE] Error, Failed to allocate memory for the instruction trace.\n");
+        exit(1);
+    }
+    memset(trace, 0, sizeof(Trace));
+    atomic_init(&trace->head, 0);
+    atomic_init(&trace->tail, 0);
+    trace->code_page_number = CODE_PAGE_NONE;
+
+    printf("[TRACE] Instruction trace initialised!\n");
+    return trace;
+}
+
+// Instruction bytes, read from a code page (reading through the bus could touch I/O, and the block cache
+// leaves the CPU's own code page behind), or from PRG where the mapper doesn't map the whole page
+// False if the byte can't be read without side effects
+static bool peek(Trace* trace, Bus* bus, uint16_t address, uint8_t* value) {
+    if ((address >> 8) != trace->code_page_number || trace->code_page_cart_writes != bus->cart_writes) {
+        trace->code_page = bus_code_page(bus, address);
+        trace->code_page_number = address >> 8;
+        trace->code_page_cart_writes = bus->cart_writes;
+    }
+    if (trace->code_page) {
+        *value = trace->code_page[address & 0x00FF];
+        return true;
+    }
+    uint32_t offset;
+    if (bus->cart && cartridge_cpu_map(bus->cart, address, &offset)) {
+        *value = bus->cart->prg_memory->items[offset];
+        return true;
+    }
+    *value = 0x00;
+    return false;
+}
+
+void trace_instruction(Trace* trace, Cpu* cpu) {
+    uint64_t head = atomic_load_explicit(&trace->head, memory_order_relaxed);
+    TraceRecord* record = &trace->ring[head & (TRACE_RING_SIZE - 1)];
+
+    Ppu* ppu = cpu->bus->ppu;
+    record->dot = ppu->dot_count;
+    record->scanline = ppu->scanline;
+    record->cycle = ppu->cycle;
+    record->PC = cpu->PC;
+    record->operand[0] = 0x00;
+    record->operand[1] = 0x00;
+    record->bytes_known = peek(trace, cpu->bus, cpu->PC, &record->opcode);
+    uint8_t bytes = opcode_table[record->opcode].bytes;
+    for (int i = 1; i < bytes && record->bytes_known; i++) {
+        record->bytes_known = peek(trace, cpu->bus, cpu->PC + i, &record->operand[i - 1]);
+    }
+    record->A = cpu->A;
+    record->X = cpu->X;
+    record->Y = cpu->Y;
+    record->P = cpu_get_status(cpu);
+    record->SP = cpu->SP;
+
+    // Publish the record (the reader only looks at records below 'head')
+    atomic_store_explicit(&trace->head, head + 1, memory_order_release);
+}
+
+int trace_drain(Trace* trace, FILE* out) {
+    static TraceRecord chunk[TRACE_DRAIN_CHUNK];
+    uint64_t tail = atomic_load_explicit(&trace->tail, memory_order_relaxed);
+    int written = 0;
+
+    for (;;) {
+        uint64_t head = atomic_load_explicit(&trace->head, memory_order_acquire);
+        if (head - tail > TRACE_RING_SIZE) {
+            // The writer lapped the reader, the oldest records are gone
+            trace->dropped += head - tail - TRACE_RING_SIZE;
+            tail = head - TRACE_RING_SIZE;
+        }
+        if (tail == head) {
+            break;
+        }
+
+        int count = (head - tail < TRACE_DRAIN_CHUNK) ? (int)(head - tail) : TRACE_DRAIN_CHUNK;
+        for (int i = 0; i < count; i++) {
+            chunk[i] = trace->ring[(tail + i) & (TRACE_RING_SIZE - 1)];
+        }
+
+        // Anything the writer has overwritten while it was being copied is unusable, and so is the record it may be
+        // part way through ('now' shares a slot with 'now - TRACE_RING_SIZE')
+        atomic_thread_fence(memory_order_acquire);
+        uint64_t now = atomic_load_explicit(&trace->head, memory_order_relaxed);
+        int torn = 0;
+        if (now - tail >= TRACE_RING_SIZE) {
+            uint64_t lost = now - tail - TRACE_RING_SIZE + 1;
+            torn = (lost < (uint64_t)count) ? (int)lost : count;
+            trace->dropped += torn;
+        }
+
+        fwrite(&chunk[torn], sizeof(TraceRecord), count - torn, out);
+        written += count - torn;
+        tail += count;
+    }
+
+    atomic_store_explicit(&trace->tail, tail, memory_order_release);
+    return written;
+}
+
+void trace_write_header(FILE* out) {
+    uint32_t record_size = sizeof(TraceRecord);
+    fwrite(TRACE_FILE_MAGIC, 1, 8, out);
+    fwrite(&record_size, sizeof(record_size), 1, out);
+}
+
+int trace_format(const TraceRecord* record, char* line, size_t size) {
+    Opcode c = opcode_table[record->opcode];
+    uint8_t lo = record->operand[0];
+    uint16_t word = record->operand[0] | (record->operand[1] << 8);
+
+    // Bytes, then the instruction as it would be written in assembly
+    char bytes[9];
+    char operand[16] = "";
+    switch (c.bytes) {
+        case 2: snprintf(bytes, sizeof(bytes), "%02X %02X", record->opcode, lo); break;
+        case 3: snprintf(bytes, sizeof(bytes), "%02X %02X %02X", record->opcode, lo, record->operand[1]); break;
+        default: snprintf(bytes, sizeof(bytes), "%02X", record->opcode); break;
+    }
+    switch (c.addressing_mode) {
+        case IMM: snprintf(operand, sizeof(operand), "#$%02X", lo); break;
+        case ZP0: snprintf(operand, sizeof(operand), "$%02X", lo); break;
+        case ZPX: snprintf(operand, sizeof(operand), "$%02X,X", lo); break;
+        case ZPY: snprintf(operand, sizeof(operand), "$%02X,Y", lo); break;
+        case ABS: snprintf(operand, sizeof(operand), "$%04X", word); break;
+        case ABX: snprintf(operand, sizeof(operand), "$%04X,X", word); break;
+        case ABY: snprintf(operand, sizeof(operand), "$%04X,Y", word); break;
+        case IND: snprintf(operand, sizeof(operand), "($%04X)", word); break;
+        case IZX: snprintf(operand, sizeof(operand), "($%02X,X)", lo); break;
+        case IZY: snprintf(operand, sizeof(operand), "($%02X),Y", lo); break;
+        case REL: snprintf(operand, sizeof(operand), "$%04X", (uint16_t)(record->PC + 2 + (int8_t)lo)); break;
+        case ACC: snprintf(operand, sizeof(operand), "A"); break;
+        default: break;
+    }
+    char disassembly[24];
+    snprintf(disassembly, sizeof(disassembly), "%s %s", InstructionStrings[c.instruction], operand);
+    if (!record->bytes_known) {
+        // Code running from I/O space, its bytes weren't read (that would have had side effects)
+        snprintf(bytes, sizeof(bytes), "??");
+        snprintf(disassembly, sizeof(disassembly), "???");
+    }
+
+    return snprintf(line, size, "%04X  %-8s  %-32sA:%02X X:%02X Y:%02X P:%02X SP:%02X PPU:%3d,%3d CYC:%llu",
+                    record->PC, bytes, disassembly, record->A, record->X, record->Y, record->P, record->SP,
+                    record->scanline, record->cycle, (unsigned long long)(record->dot / 3));
+}
@@ -0,0 +1,72 @@
+// Trace.h
+// Nintendo Entertainment System CPU Instruction Trace (Header File)
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdatomic.h>
+
+// Forward declarations to avoid circular dependencies
+typedef struct Cpu Cpu;
+
+/*///////INSTRUCTION TRACE/////////////////////////////////////////////////////////////////////////////
+
+Built in with -DCPU_TRACE, every instruction 'cpu_step' runs is recorded (registers and PPU position
+before it runs) as a fixed size binary record in a ring buffer, without formatting anything:
+    'trace_instruction'  - Writer (the emulation thread), never blocks, the oldest records are
+                           overwritten once the ring is full
+    'trace_drain'        - Reader, writes out the records it hasn't seen yet (safe to run on another
+                           thread, records overwritten while it copies them are counted as dropped)
+The ring only has the one writer and one reader, so 'head'/'tail' are plain atomics, no locks.
+
+'trace_format' turns a record into a nestest.log style line, used offline by bench/trace_format.c on a
+file of drained records ('TRACE_FILE_MAGIC' header then records), e.g. the 'trace.bin' the emulator
+streams while tracing is toggled on (F11).
+
+Without -DCPU_TRACE the hook in 'cpu_step' is an empty macro. Instructions the JIT runs natively
+(-DCPU_JIT) don't go through 'cpu_step', so build without it for a complete trace.
+
+///////////////////////////////////////////////////////////////////////////////////////////////////*/
+
+#define TRACE_RING_SIZE     (1 << 16)       // Records in the ring (power of 2, a frame is ~10000)
+#define TRACE_FILE_MAGIC    "NESTRACE"      // Start of a trace file, followed by the record size (uint32_t)
+
+typedef struct TraceRecord {
+    uint64_t dot;           // PPU dot the instruction started on ('ppu->dot_count'), its CPU cycle is this / 3
+    uint16_t PC;
+    uint8_t opcode;
+    uint8_t operand[2];     // The bytes after the opcode (as many as it uses)
+    uint8_t A, X, Y, P, SP;
+    bool bytes_known;       // False if the opcode/operand couldn't be read without side effects (code in I/O space)
+    int16_t scanline;       // PPU position
+    uint16_t cycle;
+} TraceRecord;
+
+typedef struct Trace {
+    _Atomic uint64_t head;  // Records written (the next goes in 'ring[head % TRACE_RING_SIZE]')
+    _Atomic uint64_t tail;  // Records drained
+    uint64_t dropped;       // Records overwritten before they were drained
+
+    // Page the instruction bytes were last read from (the writer's own, as 'code_page' in Cpu)
+    const uint8_t* code_page;
+    uint16_t code_page_number;
+    uint32_t code_page_cart_writes;
+
+    TraceRecord ring[TRACE_RING_SIZE];
+} Trace;
+
+// Function to initialise the trace ring (empty)
+Trace* init_trace();
+
+// Function to record the instruction about to run at 'cpu->PC'
+void trace_instruction(Trace* trace, Cpu* cpu);
+
+// Function to write the records not drained yet to 'out', returns how many were written
+int trace_drain(Trace* trace, FILE* out);
+
+// Function to start a trace file (before draining into it)
+void trace_write_header(FILE* out);
+
+// Function to format a record as a nestest.log line (no trailing newline, '??' for bytes that weren't read), returns its length
+int trace_format(const TraceRecord* record, char* line, size_t size);